@@ -0,0 +1,296 @@
+#include "batchevaluator.h"
+#include "geometricobject.h"
+#include "saveloadhelper.h"
+#include "measurement.h"
+#include "exporter.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QCoreApplication>
+#include <QFile>
+#include <QDataStream>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+QString csvField(const QString& s) {
+    if (!s.contains(',') && !s.contains('"') && !s.contains('\n')) {
+        return s;
+    }
+    QString quoted = s;
+    quoted.replace("\"", "\"\"");
+    return "\"" + quoted + "\"";
+}
+
+QString jsonString(const QString& s) {
+    QString ret = "\"";
+    for (QChar c : s) {
+        switch (c.unicode()) {
+        case '"': ret += "\\\""; break;
+        case '\\': ret += "\\\\"; break;
+        case '\n': ret += "\\n"; break;
+        case '\t': ret += "\\t"; break;
+        default:
+            if (c.unicode() < 0x20) {
+                ret += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+            } else {
+                ret += c;
+            }
+        }
+    }
+    return ret + "\"";
+}
+
+QString number(double x) {
+    return std::isfinite(x) ? QString::number(x, 'g', 17) : QString();
+}
+
+QString jsonNumber(double x) {
+    return std::isfinite(x) ? QString::number(x, 'g', 17) : QString("null");
+}
+
+QString jsonBool(bool b) {
+    return b ? "true" : "false";
+}
+
+// 导出文件在导出目录下的路径 (不含扩展名): 照搬输入文件相对当前目录的路径, 所以不同目录下的同名文件
+// (a/hw.thu 和 b/hw.thu) 不会互相覆盖, 并行时各个子进程也不会写同一个文件; 当前目录之外的文件用去掉根的绝对路径
+QString exportName(const QString& path) {
+    QFileInfo info(path);
+    QString dir = QDir::current().relativeFilePath(info.absolutePath());
+    if (dir == ".." || dir.startsWith("../") || QDir::isAbsolutePath(dir)) {
+        dir = info.absolutePath();
+        dir.remove(':');    // Windows 的盘符
+        while (dir.startsWith('/')) {
+            dir.remove(0, 1);
+        }
+    }
+    if (dir.isEmpty() || dir == ".") {
+        return info.completeBaseName();
+    }
+    return dir + "/" + info.completeBaseName();
+}
+
+// dir 下的 name + suffix, 需要时建好中间的目录
+QString exportTarget(const QString& dir, const QString& name, const char* suffix) {
+    QString target = QDir(dir).filePath(name + suffix);
+    QDir().mkpath(QFileInfo(target).absolutePath());
+    return target;
+}
+
+} // namespace
+
+BatchEvaluator::BatchEvaluator(const Options& options) : options_(options) {}
+
+void BatchEvaluator::exportFile(const QString& path, const std::vector<GeometricObject*>& objects) {
+    Exporter exporter(options_.exportSize);
+    QString name = exportName(path);
+    if (!options_.svgDir.isEmpty() && !exporter.writeSvg(objects, exportTarget(options_.svgDir, name, ".svg"))) {
+        qWarning() << "Could not export" << path << "to SVG";
+    }
+    if (!options_.pdfDir.isEmpty() && !exporter.writePdf(objects, exportTarget(options_.pdfDir, name, ".pdf"))) {
+        qWarning() << "Could not export" << path << "to PDF";
+    }
+}
+
+bool BatchEvaluator::evaluate(const QString& path, QTextStream& out, bool& first) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open" << path;
+        return false;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    // 每个文件用一张新的对象表, 编号从 0 开始
+    ObjectTable table;
+    Saveloadhelper helper;
+    std::vector<GeometricObject*> objects = helper.loadObjects(table, in);
+    bool ok = in.status() == QDataStream::Ok;
+    for (CustomizedOperation* oper : helper.loadTools(in)) {
+        delete oper;
+    }
+    // 隐藏图层里的对象不导出, 和画布上看到的一致
+    helper.loadLayers(table.layers(), objects, in);
+    ok = ok && in.status() == QDataStream::Ok;
+    file.close();
+
+    // 按 index 顺序重新计算一遍, 和 Canvas::flushObjects 一致
+    std::sort(objects.begin(), objects.end(),
+              [](GeometricObject* a, GeometricObject* b) { return a->getIndex() < b->getIndex(); });
+    for (auto obj : objects) {
+        obj->flush();
+    }
+    // 父对象不对的对象等计算错误和读文件的错误一样报告, 这个文件算作失败
+    for (const QString& error : table.takeErrors()) {
+        qWarning().noquote() << path + ": " + error;
+        ok = false;
+    }
+    if (!options_.svgDir.isEmpty() || !options_.pdfDir.isEmpty()) {
+        exportFile(path, objects);
+    }
+
+    for (auto obj : objects) {
+        ObjectType type = obj->getObjectType();
+        double x1 = NAN, y1 = NAN, x2 = NAN, y2 = NAN, value = NAN;
+        if (type == ObjectType::Point) {
+            QPointF p = obj->position();
+            x1 = p.x(), y1 = p.y();
+        } else if (type == ObjectType::Measurement) {
+            value = static_cast<Measurement*>(obj)->getValue();
+        } else if (obj->isLegal()) {
+            // 直线类为两个定义点, 圆为圆心和圆上一点, 弧为圆心和起点
+            auto p = obj->getTwoPoints();
+            x1 = p.first.x(), y1 = p.first.y(), x2 = p.second.x(), y2 = p.second.y();
+        }
+        QString typeName = QString::fromStdString(GetObjectNameString(type));
+        if (options_.format == Csv) {
+            out << csvField(path) << ',' << obj->getIndex() << ',' << csvField(obj->getLabel()) << ','
+                << typeName << ',' << obj->getGeneration() << ',' << int(obj->isLegal()) << ','
+                << int(obj->isHidden()) << ',' << int(obj->isAux()) << ',' << number(x1) << ','
+                << number(y1) << ',' << number(x2) << ',' << number(y2) << ',' << number(value) << '\n';
+        } else {
+            out << (first ? "\n" : ",\n")
+                << "{\"file\":" << jsonString(path) << ",\"index\":" << obj->getIndex()
+                << ",\"label\":" << jsonString(obj->getLabel()) << ",\"type\":" << jsonString(typeName)
+                << ",\"generation\":" << obj->getGeneration() << ",\"legal\":" << jsonBool(obj->isLegal())
+                << ",\"hidden\":" << jsonBool(obj->isHidden()) << ",\"aux\":" << jsonBool(obj->isAux())
+                << ",\"x1\":" << jsonNumber(x1) << ",\"y1\":" << jsonNumber(y1)
+                << ",\"x2\":" << jsonNumber(x2) << ",\"y2\":" << jsonNumber(y2)
+                << ",\"value\":" << jsonNumber(value) << "}";
+        }
+        first = false;
+    }
+
+    for (auto obj : objects) {
+        delete obj;
+    }
+    if (!ok) {
+        qWarning() << "Truncated or corrupt file" << path;
+    }
+    return ok;
+}
+
+void BatchEvaluator::writeHeader(Format format, QTextStream& out) {
+    if (format == Csv) {
+        out << "file,index,label,type,generation,legal,hidden,aux,x1,y1,x2,y2,value\n";
+    } else {
+        out << "[";
+    }
+}
+
+void BatchEvaluator::writeFooter(Format format, QTextStream& out) {
+    if (format == Json) {
+        out << "\n]\n";
+    }
+}
+
+int BatchEvaluator::run(const QStringList& files, const Options& options) {
+    if (options.jobs > 1 && files.size() > 1) {
+        return runParallel(files, options);
+    }
+
+    QFile file;
+    if (options.output.isEmpty()) {
+        file.open(stdout, QIODevice::WriteOnly);
+    } else {
+        file.setFileName(options.output);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            qWarning() << "Could not open" << options.output;
+            return 2;
+        }
+    }
+    QTextStream out(&file);
+
+    if (!options.fragment) {
+        writeHeader(options.format, out);
+    }
+    BatchEvaluator evaluator(options);
+    bool first = true;
+    int failed = 0;
+    for (const QString& path : files) {
+        if (!evaluator.evaluate(path, out, first)) {
+            ++failed;
+        }
+    }
+    if (!options.fragment) {
+        writeFooter(options.format, out);
+    }
+    out.flush();
+    return failed == 0 ? 0 : 1;
+}
+
+int BatchEvaluator::runParallel(const QStringList& files, const Options& options) {
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        qWarning() << "Could not create a temporary directory";
+        return 2;
+    }
+    // 连续分块, 拼接时保持输入文件的顺序
+    int jobs = std::min<int>(options.jobs, files.size());
+    std::vector<QProcess*> workers;
+    std::vector<QString> parts;
+    for (int i = 0; i < jobs; ++i) {
+        int begin = files.size() * i / jobs, end = files.size() * (i + 1) / jobs;
+        QString part = dir.filePath(QString("part%1").arg(i));
+        QStringList args = {"--batch", "--fragment", "--jobs", "1", "--output", part,
+                            "--format", options.format == Json ? "json" : "csv",
+                            "--size", QString("%1x%2").arg(options.exportSize.width()).arg(options.exportSize.height())};
+        if (!options.svgDir.isEmpty()) {
+            args << "--export-svg" << options.svgDir;
+        }
+        if (!options.pdfDir.isEmpty()) {
+            args << "--export-pdf" << options.pdfDir;
+        }
+        args += files.mid(begin, end - begin);
+        QProcess* worker = new QProcess;
+        worker->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        worker->start(QCoreApplication::applicationFilePath(), args);
+        workers.push_back(worker);
+        parts.push_back(part);
+    }
+
+    int status = 0;
+    for (QProcess* worker : workers) {
+        worker->waitForFinished(-1);
+        if (worker->exitStatus() != QProcess::NormalExit) {
+            status = 2;
+        } else {
+            status = std::max(status, worker->exitCode());
+        }
+        delete worker;
+    }
+
+    QFile file;
+    if (options.output.isEmpty()) {
+        file.open(stdout, QIODevice::WriteOnly);
+    } else {
+        file.setFileName(options.output);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            qWarning() << "Could not open" << options.output;
+            return 2;
+        }
+    }
+    QTextStream out(&file);
+    writeHeader(options.format, out);
+    bool first = true;
+    for (const QString& part : parts) {
+        QFile in(part);
+        if (!in.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            continue;
+        }
+        QString text = QString::fromUtf8(in.readAll());
+        if (options.format == Json && !text.isEmpty()) {
+            // 每个分片都以 "\n{" 开头, 分片之间补上逗号
+            out << (first ? "" : ",");
+            first = false;
+        }
+        out << text;
+    }
+    writeFooter(options.format, out);
+    out.flush();
+    return status;
+}
@@ -0,0 +1,45 @@
+#ifndef BATCHEVALUATOR_H
+#define BATCHEVALUATOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QSize>
+#include <vector>
+
+class GeometricObject;
+
+// 无窗口地批量计算 .thu 文件, 输出每个对象的位置, 合法性和度量值
+// 几何对象依赖全局状态 (NumOfMeasurements), 所以并行是多进程而不是多线程
+class BatchEvaluator {
+public:
+    enum Format { Csv, Json };
+
+    struct Options {
+        Format format = Csv;
+        QString output;      // 为空时写到 stdout
+        int jobs = 1;
+        bool fragment = false; // 子进程只写记录本身, 由父进程拼接表头/括号
+        QString svgDir;      // 非空时把每个文件导出为 <svgDir>/<相对路径>.svg, 见 exportName
+        QString pdfDir;
+        QSize exportSize = QSize(1200, 800);
+    };
+
+    explicit BatchEvaluator(const Options& options);
+
+    // 计算一个文件并把记录追加到 out, first 表示是否是整个输出中的第一条记录
+    bool evaluate(const QString& path, QTextStream& out, bool& first);
+
+    static int run(const QStringList& files, const Options& options);
+
+private:
+    Options options_;
+
+    void exportFile(const QString& path, const std::vector<GeometricObject*>& objects);
+
+    static int runParallel(const QStringList& files, const Options& options);
+    static void writeHeader(Format format, QTextStream& out);
+    static void writeFooter(Format format, QTextStream& out);
+};
+
+#endif // BATCHEVALUATOR_H
@@ -3,87 +3,128 @@
 #define CALCULATOR_H
 
 #include "point.h"
+#include "predicates.h"
+#include "scalar.h"
+#include <cmath>
+#include <limits>
+#include <type_traits>
 #include "math.h"
 
-inline long double len(const QPointF& p){
-    return sqrt(p.x()*p.x()+p.y()*p.y());
+// 以下计算核心都以标量类型 T 为模板参数, 默认是 scalar.h 中的 Real;
+// 输入仍是 QPointF (qreal), 中间量全部用 T 计算, PrecisionBenchmark 用 float/double/long double 分别实例化比较
+
+// 以 T 的精度保存的点, 只给 PrecisionBenchmark 用: 结果先变成 QPointF 会把 long double 舍入成 double
+template <typename T>
+struct PointT {
+    T px = 0, py = 0;
+    PointT() = default;
+    PointT(T x, T y) : px(x), py(y) {}
+    PointT(const QPointF& p) : px(p.x()), py(p.y()) {}
+    T x() const { return px; }
+    T y() const { return py; }
+    operator QPointF() const { return QPointF(qreal(px), qreal(py)); }
+};
+// 计算核心返回的点: 程序里用的 Real (以及 qreal) 仍是 QPointF, 调用方不变; 其它精度保留完整的 T
+template <typename T>
+using PointOf = typename std::conditional<std::is_same<T, Real>::value || std::is_same<T, qreal>::value,
+                                          QPointF, PointT<T>>::type;
+
+template <typename T = Real>
+inline T len(const QPointF& p){
+    T x = p.x(), y = p.y();
+    return std::sqrt(x*x+y*y);
 }
-inline long double len(const std::pair<QPointF, QPointF> p){
-    return len(p.first-p.second);
+template <typename T = Real>
+inline T len(const std::pair<QPointF, QPointF> p){
+    return len<T>(p.first-p.second);
 }
-inline long double len2(const QPointF& p){
-    return p.x()*p.x()+p.y()*p.y();
+template <typename T = Real>
+inline T len2(const QPointF& p){
+    T x = p.x(), y = p.y();
+    return x*x+y*y;
 }
-inline long double len2(const std::pair<QPointF, QPointF> p){
-    return len2(p.first-p.second);
+template <typename T = Real>
+inline T len2(const std::pair<QPointF, QPointF> p){
+    return len2<T>(p.first-p.second);
 }
 
-constexpr long double Epsilon=1e-10L;
+template <typename T>
+constexpr T Pi = T(3.1415926535897932384626433832795028841971693993751058209749445923078164062862089986280348253421170680L);
+
+// 判零的容差随 T 的机器精度缩放: double 是 1e-10, float 相应放宽, long double 相应收紧
+template <typename T>
+constexpr T Epsilon = T(1e-10L * (std::numeric_limits<T>::epsilon() / std::numeric_limits<double>::epsilon()));
 
-constexpr long double PI = 3.1415926535897932384626433832795028841971693993751058209749445923078164062862089986280348253421170680L;
-constexpr long double PI_2 = 1.5707963267948966192313216916397514420985846996875529104874722961539082031431044993140174126710585340L;
+constexpr Real PI = Pi<Real>;
+constexpr Real PI_2 = Pi<Real> / 2;
 
-inline bool thetainst (const long double theta, const long double s, const long double t){
+inline bool thetainst (const Real theta, const Real s, const Real t){
     return (s <= t) ? (theta >= s && theta <= t) : (theta >= s || theta <= t);
 }
-inline bool thetainst (const long double theta, std::pair<long double,long double> range){
+inline bool thetainst (const Real theta, std::pair<Real,Real> range){
     return thetainst(theta, range.first,range.second);
 }
-inline long double normalizeAngle(long double angle) {
+inline Real normalizeAngle(Real angle) {
     return (angle < 0) ? angle + 2*PI : (angle>=2*PI? angle-2*PI : angle);
 }
-inline long double AngleSubstract(long double s, long double t){
+inline Real AngleSubstract(Real s, Real t){
     return normalizeAngle(s-t);
 }
-inline long double Theta(const long double& x, const long double& y){
-    long double tmp = - PI_2 + atan2(x,y);
-    return ((tmp < 0) ? tmp+2.0*PI : tmp);
+template <typename T = Real>
+inline T Theta(const T& x, const T& y){
+    T tmp = - Pi<T> / 2 + std::atan2(x,y);
+    return ((tmp < 0) ? tmp+2*Pi<T> : tmp);
 }
-inline long double Theta(const std::pair<long double, long double>& p){
-    return Theta(p.first,p.second);
+inline Real Theta(const std::pair<Real, Real>& p){
+    return Theta<Real>(p.first,p.second);
 }
-inline long double Theta(const QPointF& p){
-    return Theta(p.x(),p.y());
+template <typename T = Real>
+inline T Theta(const QPointF& p){
+    return Theta<T>(p.x(),p.y());
 }
-inline long double Theta(const std::pair<QPointF,QPointF> p){
-    return Theta(p.first.x()-p.second.x(),p.first.y()-p.second.y());
+inline Real Theta(const std::pair<QPointF,QPointF> p){
+    return Theta<Real>(p.first.x()-p.second.x(),p.first.y()-p.second.y());
 }
-inline QPointF UnitVector(long double theta){
-    return QPointF(cos(theta),-sin(theta));
+template <typename T = Real>
+inline PointOf<T> UnitVector(T theta){
+    return PointOf<T>(std::cos(theta),-std::sin(theta));
 }
 
-inline bool is0(long double p){
-    return -Epsilon<p && p<Epsilon;
+template <typename T>
+inline bool is0(T p){
+    return -Epsilon<T><p && p<Epsilon<T>;
 }
-inline bool isp0(long double p){
-    return 0L<=p && p<Epsilon;
+template <typename T>
+inline bool isp0(T p){
+    return 0<=p && p<Epsilon<T>;
 }
 
-inline const QPointF calculateCircleCenter(const QPointF& p1, const QPointF& p2, const QPointF& p3) {
+template <typename T = Real>
+inline const PointOf<T> calculateCircleCenter(const QPointF& p1, const QPointF& p2, const QPointF& p3) {
     // 计算向量 v1 = (p2 - p1) 和 v2 = (p3 - p1)
-    long double x1 = p2.x() - p1.x();
-    long double y1 = p2.y() - p1.y();
-    long double x2 = p3.x() - p1.x();
-    long double y2 = p3.y() - p1.y();
+    T x1 = T(p2.x()) - p1.x();
+    T y1 = T(p2.y()) - p1.y();
+    T x2 = T(p3.x()) - p1.x();
+    T y2 = T(p3.y()) - p1.y();
 
     // 计算三点共线检测的叉积
-    long double cross = x1 * y2 - x2 * y1;
+    T cross = x1 * y2 - x2 * y1;
 
     // 处理共线或接近共线的情况
 #warning 这里需要修改
-    if (std::abs(cross) < 1e-8) {
-        cross = 1e-8;
+    if (std::abs(cross) < T(1e-8)) {
+        cross = T(1e-8);
     }
 
     // 计算垂直平分线交点（圆心）
-    long double f = (x1*x1 + y1*y1) / 2.0;
-    long double g = (x2*x2 + y2*y2) / 2.0;
+    T f = (x1*x1 + y1*y1) / 2;
+    T g = (x2*x2 + y2*y2) / 2;
 
-    long double denominator = cross;
-    long double cx = p1.x() + (f*y2 - g*y1) / denominator;
-    long double cy = p1.y() + (g*x1 - f*x2) / denominator;
+    T denominator = cross;
+    T cx = T(p1.x()) + (f*y2 - g*y1) / denominator;
+    T cy = T(p1.y()) + (g*x1 - f*x2) / denominator;
 
-    return QPointF(cx, cy);
+    return PointOf<T>(cx, cy);
 }
 
 
@@ -133,64 +174,71 @@ inline const QPointF NearestPointOnCircle(QPointF P, std::pair<QPointF, QPointF>
 }
 
 
-struct linelineIntersectionResult{
-    QPointF p;
-    long double t[2];//占两个线段的比例
+template <typename T = Real>
+struct linelineIntersection{
+    PointOf<T> p;
+    T t[2];//占两个线段的比例
     bool exist;
 };
 
-struct linecircleIntersectionResult{
-    QPointF p[2];//前面那个是generation_小的
-    long double t[2];//两个点在线端上的比例
+template <typename T = Real>
+struct linecircleIntersection{
+    PointOf<T> p[2];//前面那个是generation_小的
+    T t[2];//两个点在线端上的比例
     bool exist;
 };
 
-struct circlecircleIntersectionResult{
-    QPointF p[2];//前面那个是generation_小的
+template <typename T = Real>
+struct circlecircleIntersection{
+    PointOf<T> p[2];//前面那个是generation_小的
     bool exist;
 };
 
-inline linelineIntersectionResult linelineintersection(
+typedef linelineIntersection<> linelineIntersectionResult;
+typedef linecircleIntersection<> linecircleIntersectionResult;
+typedef circlecircleIntersection<> circlecircleIntersectionResult;
+
+template <typename T = Real>
+inline linelineIntersection<T> linelineintersection(
     const std::pair<QPointF, QPointF>& AB,
     const std::pair<QPointF, QPointF>& CD)
 {
-    linelineIntersectionResult ret{QPointF(), {0.0, 0.0}, false};
+    linelineIntersection<T> ret{PointOf<T>(), {0, 0}, false};
 
     const QPointF A = AB.first;
     const QPointF B = AB.second;
     const QPointF C = CD.first;
     const QPointF D = CD.second;
 
-    // 计算向量
-    QPointF r = B - A;
-    QPointF s = D - C;
-
-    // 计算分母
-    long double denominator = r.x() * s.y() - r.y() * s.x();
-
-    // 如果分母为0，表示线段平行或共线
-    if (is0(denominator)) {
+    // 如果分母为0，表示线段平行或共线; 用精确谓词判定, 不依赖固定的 Epsilon
+    if (sumOfProductsSign(B.x(), A.x(), D.y(), C.y(), A.y(), B.y(), D.x(), C.x()) == 0) {
         return ret;
     }
 
-    // 计算分子
-    QPointF AC = C - A;
-    long double t_numerator = AC.x() * s.y() - AC.y() * s.x();
-    long double u_numerator = AC.x() * r.y() - AC.y() * r.x();
+    // 计算向量
+    T rx = T(B.x()) - A.x(), ry = T(B.y()) - A.y();
+    T sx = T(D.x()) - C.x(), sy = T(D.y()) - C.y();
+    T acx = T(C.x()) - A.x(), acy = T(C.y()) - A.y();
+
+    // 计算分母和分子
+    T denominator = rx * sy - ry * sx;
+    T t_numerator = acx * sy - acy * sx;
+    T u_numerator = acx * ry - acy * rx;
 
     // 计算比例参数
     ret.t[0] = t_numerator / denominator;
     ret.t[1] = u_numerator / denominator;
-    ret.p = A + r * ret.t[0];
+    ret.p = PointOf<T>(T(A.x()) + rx * ret.t[0], T(A.y()) + ry * ret.t[0]);
     ret.exist=true;
     return ret;
 }
 
-inline linecircleIntersectionResult linecircleintersection(
+template <typename T = Real>
+inline linecircleIntersection<T> linecircleintersection(
     const std::pair<QPointF, QPointF>& AB,
     const std::pair<QPointF, QPointF>& OR)
 {
-    linecircleIntersectionResult result = {{QPointF(), QPointF()}, {0.0, 0.0}, false};
+    linecircleIntersection<T> result = {{PointOf<T>(), PointOf<T>()}, {0, 0}, false};
 
     // 直线上两点
     QPointF A = AB.first;
@@ -198,91 +246,87 @@ inline linecircleIntersectionResult linecircleintersection(
     // 圆心和圆上某点：用来确定半径
     QPointF O = OR.first;
     QPointF R = OR.second;
-    long double radius = len(R - O);
+    T radius2 = len2<T>(R - O);
 
     // 使用 A - O 形成正确的一元二次方程：|A + t(B-A) - O|^2 = r^2
-    QPointF dir = B - A;
-    QPointF AO = A - O;
-    long double a = QPointF::dotProduct(dir, dir);
-    long double b = 2.0 * QPointF::dotProduct(dir, AO);
-    long double c = QPointF::dotProduct(AO, AO) - radius * radius;
+    T dx = T(B.x()) - A.x(), dy = T(B.y()) - A.y();
+    T aox = T(A.x()) - O.x(), aoy = T(A.y()) - O.y();
+    T a = dx * dx + dy * dy;
+    T b = 2 * (dx * aox + dy * aoy);
+    T c = aox * aox + aoy * aoy - radius2;
 
-    long double discriminant = b * b - 4 * a * c;
+    T discriminant = b * b - 4 * a * c;
     if (discriminant < 0) {
-        long double t=footRatio(O,AB);
-        QPointF foot=A+t*(B-A);
-        if(is0(len(foot-O)-len(R-O))){
-            result.p[0]=result.p[1]=foot;
+        T t=footRatio(O,AB);
+        T fx = T(A.x()) + t * dx, fy = T(A.y()) + t * dy;
+        T fox = fx - O.x(), foy = fy - O.y();
+        if(is0<T>(std::sqrt(fox * fox + foy * foy) - std::sqrt(radius2))){
+            result.p[0]=result.p[1]=PointOf<T>(fx, fy);
             result.t[0]=result.t[1]=t;
             result.exist=true;
         }
         return result;
     }
 
-    long double sqrtDiscriminant = std::sqrt(discriminant);
-    long double t1 = (-b + sqrtDiscriminant) / (2.0 * a);
-    long double t2 = (-b - sqrtDiscriminant) / (2.0 * a);
+    T sqrtDiscriminant = std::sqrt(discriminant);
+    T t1 = (-b + sqrtDiscriminant) / (2 * a);
+    T t2 = (-b - sqrtDiscriminant) / (2 * a);
 
     // 按 t 值排序，确保 p[0] 对应较小的 t
-    if (t1 <= t2) {
-        result.t[0] = t1;
-        result.t[1] = t2;
-        result.p[0] = A + t1 * dir;
-        result.p[1] = A + t2 * dir;
-    } else {
-        result.t[0] = t2;
-        result.t[1] = t1;
-        result.p[0] = A + t2 * dir;
-        result.p[1] = A + t1 * dir;
+    if (t1 > t2) {
+        std::swap(t1, t2);
     }
+    result.t[0] = t1;
+    result.t[1] = t2;
+    result.p[0] = PointOf<T>(T(A.x()) + t1 * dx, T(A.y()) + t1 * dy);
+    result.p[1] = PointOf<T>(T(A.x()) + t2 * dx, T(A.y()) + t2 * dy);
     result.exist = true;
     return result;
 }
 
-inline circlecircleIntersectionResult circlecircleintersection(
+template <typename T = Real>
+inline circlecircleIntersection<T> circlecircleintersection(
     const std::pair<QPointF, QPointF>& AB,
     const std::pair<QPointF, QPointF>& OR)
 {
-    circlecircleIntersectionResult result = {{QPointF(), QPointF()}, false};
+    circlecircleIntersection<T> result = {{PointOf<T>(), PointOf<T>()}, false};
 
     // 提取圆心和半径
     QPointF A = AB.first;
     QPointF B = AB.second;
-    long double r1 = QLineF(A, B).length();
+    T r1 = len<T>(B - A);
 
     QPointF O = OR.first;
     QPointF R = OR.second;
-    long double r2 = QLineF(O, R).length();
+    T r2 = len<T>(R - O);
 
     // 计算圆心距
-    QPointF AO = O - A;
-    long double d = len(AO);
+    T aox = T(O.x()) - A.x(), aoy = T(O.y()) - A.y();
+    T d = std::sqrt(aox * aox + aoy * aoy);
 
     // 处理两圆位置关系
-    if (d > r1 + r2 || d < qAbs(r1 - r2)) {
-        if(isp0(d-r1-r2) || isp0(qAbs(r1-r2)-d)){
-            result.p[0]=result.p[1]= (len(A-B)>len(O-R)? A + (len(B-A)/len(O-A))*(O-A):O + (len(R-O)/len(O-A))*(A-O));
+    if (d > r1 + r2 || d < std::abs(r1 - r2)) {
+        if(isp0<T>(d-r1-r2) || isp0<T>(std::abs(r1-r2)-d)){
+            // 相切: 切点在两圆心连线上, 到较大的圆的圆心距离为它的半径
+            result.p[0]=result.p[1]= (r1>r2? PointOf<T>(T(A.x()) + r1/d*aox, T(A.y()) + r1/d*aoy)
+                                             : PointOf<T>(T(O.x()) - r2/d*aox, T(O.y()) - r2/d*aoy));
             result.exist=true;
         }
         return result;
     }
 
     // 计算辅助变量
-    long double a = (r1*r1 - r2*r2 + d*d) / (2.0 * d);
-    long double h_squared = r1*r1 - a*a;
+    T a = (r1*r1 - r2*r2 + d*d) / (2 * d);
+    T h_squared = r1*r1 - a*a;
 
     // 计算交点
-    long double h = std::sqrt(h_squared);
-    QPointF N = AO / d; // 归一化向量
-    QPointF T(-N.y(), N.x()); // 垂直向量，顺时针旋转90度
+    T h = std::sqrt(h_squared);
+    T nx = aox / d, ny = aoy / d; // 归一化向量; 垂直向量 (-ny, nx), 顺时针旋转90度
 
     // 计算两个交点
-    QPointF p = A + a * N;
-    result.p[0] = p + h * T;
-    result.p[1] = p - h * T;
-
-    // 确保向量p1p2和向量AO的叉乘垂直于屏幕朝内
-    QPointF p1p2 = result.p[1] - result.p[0];
+    T px = T(A.x()) + a * nx, py = T(A.y()) + a * ny;
+    result.p[0] = PointOf<T>(px - h * ny, py + h * nx);
+    result.p[1] = PointOf<T>(px + h * ny, py - h * nx);
 
     result.exist=true;
     return result;
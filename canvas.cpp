@@ -3,6 +3,12 @@
 #include <QInputDialog> // 确保包含 QInputDialog
 #include <QColorDialog> // 确保包含 QColorDialog
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QPicture>
+#include <QScreen>
+#include <QDebug>
+#include <chrono>
+#include <unordered_set>
 #include <cmath>        // For std::sqrt, std::pow, std::abs (QLineF::length() 也可以)
 #include <algorithm>    // For std::remove if deleting objects
 #include "geometricobject.h"
@@ -15,15 +21,73 @@
 #include "saveloadhelper.h"
 #include "measurement.h"
 #include "customizedoperation.h"
+#include "exporter.h"
+#include "interactionrecorder.h"
+#include "tilerenderer.h"
 #include <stack>
 
 // 假设你的 ObjectType 和 ObjectName 在 "objecttype.h" (或其他地方) 定义，并且 GetDefault... 映射存在
 // extern std::map<ObjectType, QColor> GetDefaultColor;
 // extern std::map<ObjectType, double> GetDefaultSize;
-// extern std::map<ObjectType, QString> GetDefaultLable;
 
 const int maxCacheSize = 200;
 
+// 细节程度 (LOD) 的阈值, 长度以像素为单位
+const double LodPixel = 1.5;          // 小于这个尺寸的圆和线段画成一个像素点
+const int LodCellSize = 8;            // 统计密度用的格子, 大约是一个点的直径
+const int LodMinPoints = 500;         // 点少的时候总是完整绘制
+const double LodEnterCrowding = 2.0;  // 每个有点的格子平均超过这么多个点时切换到概览
+const double LodLeaveCrowding = 1.5;
+const int LodSpriteSize = 2;
+const int RefineDelayMs = 50;         // 拖动/缩放停下这么久之后用完整质量重画
+
+namespace {
+
+qint64 cellKey(const QPointF& p, double cellSize) {
+    return (qint64(std::floor(p.y() / cellSize)) << 32) ^ quint32(qint32(std::floor(p.x() / cellSize)));
+}
+
+// 概览模式下的点: 同一个像素格里只保留第一个, 同色的点用一次 drawPoints 画完
+class SpriteBatch {
+public:
+    void add(const QPointF& p, const QColor& color) {
+        if (cells_.insert(cellKey(p, LodSpriteSize)).second) {
+            points_[color.rgba()].append(p);
+        }
+    }
+    void draw(QPainter* painter) const {
+        if (points_.empty()) {
+            return;
+        }
+        painter->save();
+        painter->setRenderHint(QPainter::Antialiasing, false);
+        for (const auto& [rgba, polygon] : points_) {
+            painter->setPen(QPen(QColor::fromRgba(rgba), LodSpriteSize));
+            painter->drawPoints(polygon);
+        }
+        painter->restore();
+    }
+
+private:
+    std::unordered_set<qint64> cells_;
+    std::map<QRgb, QPolygonF> points_;
+};
+
+// tiles 为空时在当前线程直接画; dirty 为空表示画整个 viewport
+void drawItems(QPainter* painter, TileRenderer* tiles, const std::vector<TileRenderer::Item>& items,
+               const SpriteBatch& sprites, const QRect& viewport, const QRect& dirty) {
+    if (tiles) {
+        tiles->render(painter, items, viewport, dirty);
+    } else {
+        for (const auto& item : items) {
+            item.object->draw(painter);
+        }
+    }
+    sprites.draw(painter);
+}
+
+} // namespace
+
 std::set<GeometricObject*> showObjectsCache;
 
 Canvas::Canvas(QWidget* parent) : QWidget(parent) {
@@ -54,13 +118,15 @@ Canvas::Canvas(QWidget* parent) : QWidget(parent) {
     operations.push_back(new AngleMeasurementCreator());   // 索引18
     // TODO: add other operations here.
 
-    cacheObj_ = std::vector<std::vector<GeometricObject*>>(maxCacheSize, std::vector<GeometricObject*>());
-    cacheDel_ = std::vector<std::vector<GeometricObject*>>(maxCacheSize, std::vector<GeometricObject*>());
-    cacheAux_ = std::vector<std::vector<GeometricObject*>>(maxCacheSize, std::vector<GeometricObject*>());
+    cacheObj_ = std::vector<std::vector<ObjectHandle>>(maxCacheSize, std::vector<ObjectHandle>());
+    cacheAux_ = std::vector<std::vector<ObjectHandle>>(maxCacheSize, std::vector<ObjectHandle>());
     cacheHidden_ = std::vector<std::vector<bool>>(maxCacheSize, std::vector<bool>());
     cachePos_ = std::vector<std::vector<QPointF>>(maxCacheSize, std::vector<QPointF>());
 
-    operationCreator_ = new CustomizedOperationCreator;
+    frameTimer_.setTimerType(Qt::PreciseTimer);
+    connect(&frameTimer_, &QTimer::timeout, this, &Canvas::onFrame);
+    idleTimer_.setSingleShot(true);
+    connect(&idleTimer_, &QTimer::timeout, this, &Canvas::onIdle);
 }
 
 void Canvas::setOperationNames(std::set<QString> names){
@@ -68,7 +134,11 @@ void Canvas::setOperationNames(std::set<QString> names){
 }
 
 Canvas::~Canvas(){
-    for (auto obj : objects_){
+    if (frameJob_.valid()) {
+        frameJob_.wait(); // 后台线程完成时会给 this 发消息
+    }
+    clearTempObjects();
+    for (auto obj : ownedObjects()){
         delete obj;
     }
     for (auto operation : operations){
@@ -77,10 +147,12 @@ Canvas::~Canvas(){
 }
 
 bool Canvas::canCreateTool(){
-    return operationCreator_->canApply(selectedObjs_);
+    invalidateFrame();
+    return operationCreator_.canApply(selection());
 }
 
 std::pair<QString, int> Canvas::createTool(){
+    invalidateFrame();
     QString name;
     while (true) {
         bool ok = false;
@@ -99,60 +171,278 @@ std::pair<QString, int> Canvas::createTool(){
         }
         break;
     }
-    CustomizedOperation* oper = operationCreator_->apply(selectedObjs_, name);
+    CustomizedOperation* oper = operationCreator_.apply(selection(), name);
+    QString error;
+    if (!oper->isUsable(&error)) {
+        QMessageBox::warning(this, "警告", "The tool could not be created: " + error);
+        delete oper;
+        return std::make_pair("", 0);
+    }
     operationNames_.insert(name);
     operations.push_back(oper);
+    if (!toolLibrary_.append(oper)) {
+        QMessageBox::warning(this, "Tool Library", "The tool could not be saved to the tool library.");
+    }
     clearSelections();
     return std::make_pair(name, operations.size() - 1);
 }
 
+std::vector<RegisteredTool> Canvas::loadToolLibrary(){
+    std::vector<RegisteredTool> registered;
+    if (!toolLibrary_.open()) {
+        return registered;
+    }
+    // 只注册名字和图标, 执行计划在第一次使用时才从文件中读取
+    for (int i = 0; i < toolLibrary_.size(); ++i) {
+        QString name = toolLibrary_.name(i);
+        if (operationNames_.find(name) != operationNames_.end()) {
+            qDebug() << "Tool library: skipping duplicated tool" << name;
+            continue;
+        }
+        operationNames_.insert(name);
+        operations.push_back(toolLibrary_.createLazy(i));
+        registered.push_back({name, int(operations.size()) - 1, toolLibrary_.icon(i)});
+    }
+    return registered;
+}
+
+void Canvas::markToolUsed(Operation* operation){
+    CustomizedOperation* oper = dynamic_cast<CustomizedOperation*>(operation);
+    if (oper && std::find(usedTools_.begin(), usedTools_.end(), oper) == usedTools_.end()) {
+        usedTools_.push_back(oper);
+    }
+}
+
+bool Canvas::checkTool(Operation* operation){
+    CustomizedOperation* oper = dynamic_cast<CustomizedOperation*>(operation);
+    QString error;
+    if (!oper || oper->isUsable(&error)) {
+        return true;
+    }
+    warn("警告", "Tool \"" + QString::fromStdString(oper->getName()) + "\" cannot be applied: " + error);
+    return false;
+}
+
+std::vector<GeometricObject*> Canvas::mergeDuplicates(const std::vector<GeometricObject*>& created){
+    // 留下的对象由调用方加入画布, 这里先登记到 structures_
+    return structures_.intern(created);
+}
+
+bool Canvas::applyToolBatch(int index, const std::vector<std::vector<GeometricObject*>>& inputs){
+    invalidateFrame();
+    if (index < 0 || index >= int(operations.size())) {
+        return false;
+    }
+    CustomizedOperation* oper = dynamic_cast<CustomizedOperation*>(operations[index]);
+    if (!oper) {
+        return false;
+    }
+    for (const auto& objs : inputs) {
+        if (oper->isValidInput(objs) != 0) {
+            return false;
+        }
+    }
+    if (!checkTool(oper)) {
+        return false;
+    }
+    markToolUsed(oper);
+    clearSelections();
+    // 同一批里的重复 (例如共用同一个输入的两次应用构造出的相同辅助对象) 也一起合并
+    std::vector<GeometricObject*> created;
+    for (const auto& newObjects : oper->applyBatch(inputs)) {
+        created.insert(created.end(), newObjects.begin(), newObjects.end());
+    }
+    for (auto obj : mergeDuplicates(created)) {
+        if (obj->isAux()) {
+            obj->setSelected(false);
+            auxObjs_.push_back(obj);
+        } else {
+            obj->setSelected(true);
+            objects_.push_back(obj);
+            selectedObjs_.insert(obj->getHandle());
+        }
+    }
+    loadInCache();
+    update();
+    return true;
+}
+
+bool Canvas::applyToolToSelection(){
+    invalidateFrame();
+    auto it = std::find(operations.begin(), operations.end(), currentOperation_);
+    CustomizedOperation* oper = dynamic_cast<CustomizedOperation*>(currentOperation_);
+    if (!oper || it == operations.end()) {
+        warn("警告", "请先在工具栏中选择一个自定义工具");
+        return false;
+    }
+    const std::vector<ObjectType>& signature = oper->getSignature();
+    std::map<ObjectType, size_t> perInput;
+    for (ObjectType type : signature) {
+        ++perInput[type];
+    }
+    std::map<ObjectType, std::vector<GeometricObject*>> byType;
+    for (auto obj : objects_) {
+        if (obj->isSelected()) {
+            byType[obj->getObjectType()].push_back(obj);
+        }
+    }
+    // 每种类型的个数都要是这个工具一组输入里的个数的同一个倍数
+    size_t n = 0;
+    bool ok = !signature.empty() && byType.size() == perInput.size();
+    for (const auto& [type, count] : perInput) {
+        auto found = byType.find(type);
+        size_t have = found == byType.end() ? 0 : found->second.size();
+        if (have == 0 || have % count != 0 || (n != 0 && have / count != n)) {
+            ok = false;
+            break;
+        }
+        n = have / count;
+    }
+    if (!ok) {
+        warn("警告", "选中的对象不能分成工具 \"" + QString::fromStdString(oper->getName()) + "\" 的若干组输入");
+        return false;
+    }
+    std::vector<std::vector<GeometricObject*>> inputs(n);
+    std::map<ObjectType, size_t> next;
+    for (auto& objs : inputs) {
+        for (ObjectType type : signature) {
+            objs.push_back(byType[type][next[type]++]);
+        }
+    }
+    return applyToolBatch(int(it - operations.begin()), inputs);
+}
+
 void Canvas::setMode(Mode newMode) {
+    invalidateFrame();
+    if (recorder_) {
+        recorder_->record(InteractionRecorder::SetMode, newMode);
+    }
     currentMode = newMode;
+    for (auto obj : selection()) {
+        damage(obj);
+    }
+    for (auto obj : tempObjects_) {
+        damage(obj);
+    }
     clearSelections(); // 切换模式时是否清除选择，根据需求决定
-    update(); // 更新画布显示，例如模式切换可能有视觉提示
+    repaintDamage();
 }
 
 void Canvas::setOperation(const int index) {
+    if (recorder_) {
+        recorder_->record(InteractionRecorder::SetOperation, index);
+    }
     this->currentOperation_ = operations[index];
 }
 
+void Canvas::runCommand(Command command) {
+    if (recorder_) {
+        recorder_->record(InteractionRecorder::Command, command);
+    }
+    switch (command) {
+    case DeleteCommand: deleteObjects(); break;
+    case HideCommand: hideObjects(); break;
+    case ShowCommand: showObjects(); break;
+    case ClearCommand: clearObjects(); break;
+    }
+}
+
+void Canvas::resizeEvent(QResizeEvent* event) {
+    if (recorder_) {
+        recorder_->recordResize(event->size());
+    }
+    QWidget::resizeEvent(event);
+}
+
 void Canvas::updateHoverState(const QPointF& pos) {
     std::vector<GeometricObject*> newHover;
     Point* p = findPointNear(pos);
     if (p) {
-        p->setHovered(true);
         newHover.push_back(p);
     } else {
         newHover = findObjectsNear(pos);
-        for (auto obj : newHover) {
+    }
+    // 只有悬停状态真正改变的对象需要重绘
+    for (auto obj : newHover) {
+        if (!obj->isHovered()) {
             obj->setHovered(true);
+            damage(obj);
         }
     }
-    for (auto obj : hoveredObjs_) {
-        if (std::find(newHover.begin(), newHover.end(), obj) == newHover.end()){
+    for (auto handle : hoveredObjs_) {
+        GeometricObject* obj = table_.get(handle);
+        if (obj && std::find(newHover.begin(), newHover.end(), obj) == newHover.end()){
             obj->setHovered(false);
+            damage(obj);
         }
     }
-    hoveredObjs_ = newHover;
-    if (hoveredObjs_.size() == 1 and !tempObjects_.empty()){
-        if (hoveredObjs_[0]->getObjectType() == ObjectType::Point) {
-            tempObjects_[0]->setHidden(true);
+    hoveredObjs_.clear();
+    for (auto obj : newHover) {
+        hoveredObjs_.push_back(obj->getHandle());
+    }
+    if (!tempObjects_.empty()) {
+        bool hidden = tempObjects_[0]->isHidden();
+        if (newHover.size() == 1) {
+            hidden = hidden || newHover[0]->getObjectType() == ObjectType::Point;
+        } else {
+            hidden = false;
+        }
+        if (hidden != tempObjects_[0]->isHidden()) {
+            damage(tempObjects_[0]);
+            tempObjects_[0]->setHidden(hidden);
+            damage(tempObjects_[0]);
+        }
+    }
+    repaintDamage();
+}
+
+void Canvas::damage(GeometricObject* obj) {
+    if (!obj->isHidden()) {
+        obj->evaluate(); // 父对象刚被移动时位置还没有更新
+    }
+    if (obj->isShown()) {
+        damage_ += obj->boundingRect(rect()).toAlignedRect() & rect();
+    }
+}
+
+void Canvas::damageWithDependents(const std::vector<GeometricObject*>& roots) {
+    std::set<GeometricObject*> visited;
+    std::vector<GeometricObject*> stack(roots);
+    while (!stack.empty()) {
+        GeometricObject* obj = stack.back();
+        stack.pop_back();
+        if (!visited.insert(obj).second) {
+            continue;
+        }
+        damage(obj);
+        for (auto child : obj->getChildren()) {
+            stack.push_back(child);
         }
-    } else if (!tempObjects_.empty()) {
-        tempObjects_[0]->setHidden(false);
     }
-    update();
+}
+
+void Canvas::updateObject(GeometricObject* obj) {
+    damage(obj);
+    repaintDamage();
+}
+
+void Canvas::repaintDamage() {
+    if (!damage_.isEmpty()) {
+        update(damage_);
+        damage_ = QRegion();
+    }
 }
 
 GeometricObject* Canvas::automaticIntersection(const QPointF& pos) {
-    QString neededlabel=GetDefaultLable[ObjectType::Point];
+    // 候选交点各自占用了一个标签, 留下的那个从生成之前的位置重新取
+    quint32 labelMark = table_.labels().mark(ObjectType::Point);
     std::vector<GeometricObject*> objsNear = findObjectsNear(pos);
     if (objsNear.size() >= 2){
         std::vector<GeometricObject*> v = {objsNear[0], objsNear[1]};
         auto newObjects = operations[10]->apply(v);
         qDebug()<<"newObject.size() = "<<newObjects.size();
         GeometricObject* targetObj = nullptr;
-        long double mindist=1e100;
+        Real mindist=1e100;
         for(auto iter:newObjects){
             if(!iter->isLegal()){
                 delete iter;
@@ -172,13 +462,14 @@ GeometricObject* Canvas::automaticIntersection(const QPointF& pos) {
                 delete iter;
             }
         }
+        table_.labels().restore(ObjectType::Point, labelMark);
         if(targetObj){
-                targetObj->setLabel(neededlabel);
-                GetDefaultLable[ObjectType::Point]=nextPointLable(neededlabel);
+                structures_.insert(targetObj);
+                targetObj->takeDefaultLabel();
                 objects_.push_back(targetObj);
                 loadInCache();
                 targetObj->setSelected(true);
-                selectedObjs_.insert(targetObj);
+                selectedObjs_.insert(targetObj->getHandle());
             }
         return targetObj;
     }
@@ -186,6 +477,11 @@ GeometricObject* Canvas::automaticIntersection(const QPointF& pos) {
 }
 
 void Canvas::mousePressEvent(QMouseEvent* event) {
+    if (recorder_) {
+        recorder_->record(InteractionRecorder::MousePress, event);
+    }
+    invalidateFrame();
+    flushPendingInput(); // 先处理之前合并的移动, 保证事件顺序
     mousePos_ = event->position(); // 记录鼠标按下位置，主要用于拖拽计算
 
     if (event->button() == Qt::LeftButton) {
@@ -203,11 +499,11 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
                         clearSelections();
                     }
                     clickedObj->setSelected(true);
-                    selectedObjs_.insert(clickedObj);
+                    selectedObjs_.insert(clickedObj->getHandle());
                 } else {
                     if (event->modifiers() & Qt::ControlModifier) {
                         clickedObj->setSelected(false);
-                        selectedObjs_.erase(clickedObj);
+                        selectedObjs_.erase(clickedObj->getHandle());
                     }
                 }
             } else { // 点击到空白区域
@@ -217,7 +513,7 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
                 }
             }
             // 为所有选中的对象记录初始位置，用于拖动
-            for (auto obj : selectedObjs_) {
+            for (auto obj : selection()) {
                 initialPositions_[obj] = obj->position();
             }
         } else if (currentMode == CreatePointMode) {
@@ -245,15 +541,15 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
                         newPoint->flush();
                     }
                 } else {
-                    newPoint = (new Point(mousePos_))->flush();
+                    newPoint = (new Point(&table_, mousePos_))->flush();
                 }
                 objects_.push_back(newPoint);
                 loadInCache();
                 newPoint->setSelected(true); // 新创建的点默认为选中状态
-                selectedObjs_.insert(newPoint);
+                selectedObjs_.insert(newPoint->getHandle());
             } else { // 如果点击在现有点附近，则选中该点
                 existingPoint->setSelected(true);
-                selectedObjs_.insert(existingPoint);
+                selectedObjs_.insert(existingPoint->getHandle());
             }
         }
 
@@ -292,14 +588,14 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
                 } else {
                     targetPoint = findPointNear(mousePos_);
                     if (!targetPoint) { // 如果附近没有点，则创建新点
-                        GeometricObject* newPoint = (new Point(mousePos_))->flush();
+                        GeometricObject* newPoint = (new Point(&table_, mousePos_))->flush();
                         objects_.push_back(newPoint);
                         loadInCache();
                         targetPoint = newPoint;
                     }
                 }
                 targetPoint->setSelected(true);
-                selectedObjs_.insert(targetPoint);
+                selectedObjs_.insert(targetPoint->getHandle());
                 if (std::find(operationSelections_.begin(), operationSelections_.end(), targetPoint) != operationSelections_.end()){
                     clearSelections();
                     operationSelections_.clear();
@@ -316,7 +612,7 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
                 }
                 else{
                     targetObj->setSelected(true);
-                    selectedObjs_.insert(targetObj);
+                    selectedObjs_.insert(targetObj->getHandle());
                     if (std::find(operationSelections_.begin(), operationSelections_.end(), targetObj) != operationSelections_.end()){
                         clearSelections();
                         operationSelections_.clear();
@@ -334,7 +630,7 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
                 Point* targetPoint = findPointNear(mousePos_);
                 if (targetPoint){
                     targetPoint->setSelected(true);
-                    selectedObjs_.insert(targetPoint);
+                    selectedObjs_.insert(targetPoint->getHandle());
                     if (std::find(operationSelections_.begin(), operationSelections_.end(), targetPoint) != operationSelections_.end()){
                         clearSelections();
                         operationSelections_.clear();
@@ -347,7 +643,7 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
                     GeometricObject* targetObj = findObjNear(mousePos_);
                     if (targetObj){
                         targetObj->setSelected(true);
-                        selectedObjs_.insert(targetObj);
+                        selectedObjs_.insert(targetObj->getHandle());
                         if (std::find(operationSelections_.begin(), operationSelections_.end(), targetObj) != operationSelections_.end()){
                             clearSelections();
                             operationSelections_.clear();
@@ -357,10 +653,10 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
                         }
                     }
                     else{
-                        GeometricObject* newPoint = (new Point(mousePos_))->flush();
+                        GeometricObject* newPoint = (new Point(&table_, mousePos_))->flush();
                         objects_.push_back(newPoint);
                         loadInCache();
-                        selectedObjs_.insert(newPoint);
+                        selectedObjs_.insert(newPoint->getHandle());
                         if (std::find(operationSelections_.begin(), operationSelections_.end(), newPoint) != operationSelections_.end()){
                             clearSelections();
                             operationSelections_.clear();
@@ -371,24 +667,29 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
                     }
                 }
             }
-            if (currentOperation_->isValidInput(operationSelections_) == 0){ //已经符合
+            if (currentOperation_->isValidInput(operationSelections_) == 0 && !checkTool(currentOperation_)){
+                clearSelections();
+                operationSelections_.clear();
+                clearTempObjects();
+            } else if (currentOperation_->isValidInput(operationSelections_) == 0){ //已经符合
+                markToolUsed(currentOperation_);
                 std::set<GeometricObject*> newObject = currentOperation_->apply(operationSelections_);
                 clearSelections();
                 clearTempObjects();
-                for (auto obj : newObject){
+                for (auto obj : mergeDuplicates({newObject.begin(), newObject.end()})){
                     if (obj->isAux()){
                         obj->setSelected(false);
                         auxObjs_.push_back(obj);
                     } else {
                         obj->setSelected(true);
                         objects_.push_back(obj);
-                        selectedObjs_.insert(obj);
+                        selectedObjs_.insert(obj->getHandle());
                     }
                 }
                 loadInCache();
             } else if (currentOperation_->isWaiting(operationSelections_) and currentOperation_->waitImplemented){
                 if (tempObjects_.empty()) {
-                    Point* p = new Point(mousePos_, true);
+                    Point* p = new Point(&table_, mousePos_, true);
                     p->setSelected(false);
                     p->setHidden(false);
                     operationSelections_.push_back(p);
@@ -412,7 +713,7 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
             if (!clickedObj->isSelected()) { // 如果右键点击的对象未被选中
                 clearSelections(); // 清除其他选择
                 clickedObj->setSelected(true); // 选中该对象
-                selectedObjs_.insert(clickedObj);
+                selectedObjs_.insert(clickedObj->getHandle());
             }
             // 如果对象已被选中，并且有多个对象被选中，则保持当前选择状态，
             // 以便上下文菜单可以作用于所有选中的对象。
@@ -426,13 +727,55 @@ void Canvas::mousePressEvent(QMouseEvent* event) {
 }
 
 void Canvas::mouseMoveEvent(QMouseEvent* event) {
-    QPointF currentPos = event->position();
+    if (recorder_) {
+        recorder_->record(InteractionRecorder::MouseMove, event);
+    }
+    // 只记下最新的位置, 由帧定时器每帧处理一次
+    pendingMove_ = true;
+    pendingMovePos_ = event->position();
+    pendingMoveButtons_ = event->buttons();
+    if (!frameTimer_.isActive()) {
+        QScreen* s = screen();
+        frameTimer_.start(s && s->refreshRate() > 0 ? qMax(1, qRound(1000.0 / s->refreshRate())) : 16);
+    }
+}
+
+void Canvas::flushPendingInput() {
+    if (!pendingMove_) {
+        return;
+    }
+    pendingMove_ = false;
+    invalidateFrame();
+    QElapsedTimer timer;
+    timer.start();
+    processMouseMove(pendingMovePos_, pendingMoveButtons_);
+    frameStats_.input += timer.nsecsElapsed();
+}
+
+void Canvas::onFrame() {
+    if (!pendingMove_) {
+        frameTimer_.stop(); // 没有输入时不空转
+        return;
+    }
+    if (frameJob_.valid()) {
+        return; // 后台线程还在光栅化上一帧, 继续合并移动, 免得录下的帧一个个过期
+    }
+    flushPendingInput();
+}
+
+void Canvas::processMouseMove(const QPointF& pos, Qt::MouseButtons buttons) {
+    QPointF currentPos = pos;
     updateHoverState(currentPos); // 实时更新悬停对象
 
     if (currentMode == SelectionMode) {
-        if (!selectedObjs_.empty() && (event->buttons() & Qt::LeftButton) && !isDuringMultipleSelection_) { // 如果有选中的对象并且按住左键拖动
+        if (!selectedObjs_.empty() && (buttons & Qt::LeftButton) && !isDuringMultipleSelection_) { // 如果有选中的对象并且按住左键拖动
             QPointF delta = currentPos - mousePos_; // 计算拖动向量
-            for (auto obj : selectedObjs_) {
+            // 被拖动的点和依赖它们的对象在移动前后的范围都需要重绘
+            std::set<GeometricObject*> selected = selection();
+            std::vector<GeometricObject*> moved(selected.begin(), selected.end());
+            beginInteraction();
+            damageWithDependents(moved);
+            for (auto obj : selected) {
                 QPointF newPos = initialPositions_[obj] + delta; // 计算新位置
                 if (obj->getObjectType() == ObjectType::Point) {
                     Point* point = dynamic_cast<Point*>(obj);
@@ -442,26 +785,26 @@ void Canvas::mouseMoveEvent(QMouseEvent* event) {
             if (len(delta) > 0) {
                 hasMoved_ = true;
             }
-            update();
-        } else if ((event->buttons() & Qt::LeftButton) && isDuringMultipleSelection_) {
+            damageWithDependents(moved);
+            repaintDamage();
+        } else if ((buttons & Qt::LeftButton) && isDuringMultipleSelection_) {
             multipleSelectionEndPos_ = currentPos;
             for (auto obj : objects_){
                 if (obj->isShown()){
                     if (obj->isTouchedByRectangle(multipleSelectionStartPos_, multipleSelectionEndPos_)){
                         obj->setSelected(true);
-                        selectedObjs_.insert(obj);
+                        selectedObjs_.insert(obj->getHandle());
                     } else {
                         obj->setSelected(false);
-                        auto iter = selectedObjs_.find(obj);
-                        if (iter != selectedObjs_.end()) {
-                            selectedObjs_.erase(iter);
-                        }
+                        selectedObjs_.erase(obj->getHandle());
                     }
                 }
             }
-        } else if (event->buttons() & Qt::LeftButton) {
+            update(); // 框选可能改变任意对象的选中状态
+        } else if (buttons & Qt::LeftButton) {
             multipleSelectionEndPos_ = currentPos;
             isDuringMultipleSelection_ = true;
+            update();
         }
     } else if (currentMode == OperationMode) {
         if (!tempObjects_.empty() and currentOperation_->waitImplemented) {
@@ -470,12 +813,24 @@ void Canvas::mouseMoveEvent(QMouseEvent* event) {
             if (nearP) {
                 currentPos = nearP->position();
             }
+            for (auto obj : tempObjects_) {
+                damage(obj);
+            }
             p->setPosition(currentPos);
+            for (auto obj : tempObjects_) {
+                damage(obj);
+            }
+            repaintDamage();
         }
     }
 }
 
 void Canvas::mouseReleaseEvent(QMouseEvent* event) {
+    if (recorder_) {
+        recorder_->record(InteractionRecorder::MouseRelease, event);
+    }
+    invalidateFrame();
+    flushPendingInput(); // 先处理之前合并的移动, 保证事件顺序
     QPointF releasePos = event->position();
     if (event->button() == Qt::LeftButton) {
         if (currentMode == SelectionMode) {
@@ -514,7 +869,7 @@ void Canvas::mouseReleaseEvent(QMouseEvent* event) {
                 } else {
                     targetPoint = findPointNear(releasePos);
                     if (!targetPoint) { // 如果附近没有点，则创建新点
-                        GeometricObject* newPoint = (new Point(releasePos))->flush();
+                        GeometricObject* newPoint = (new Point(&table_, releasePos))->flush();
                         objects_.push_back(newPoint);
                         loadInCache();
                         targetPoint = newPoint;
@@ -525,14 +880,19 @@ void Canvas::mouseReleaseEvent(QMouseEvent* event) {
                     clearSelections();
                     operationSelections_.clear();
                     tempObjects_.clear();
+                } else if (!checkTool(currentOperation_)) {
+                    clearSelections();
+                    operationSelections_.clear();
+                    clearTempObjects();
                 } else {
                     operationSelections_.push_back(targetPoint);
+                    markToolUsed(currentOperation_);
                     std::set<GeometricObject*> newObject = currentOperation_->apply(operationSelections_);
                     clearSelections();
-                    for (auto obj : newObject){
+                    for (auto obj : mergeDuplicates({newObject.begin(), newObject.end()})){
                         obj->setSelected(true);
                         objects_.push_back(obj);
-                        selectedObjs_.insert(obj);
+                        selectedObjs_.insert(obj->getHandle());
                     }
                     loadInCache();
                 }
@@ -543,7 +903,6 @@ void Canvas::mouseReleaseEvent(QMouseEvent* event) {
 }
 
 void Canvas::paintEvent(QPaintEvent* event) {
-    Q_UNUSED(event);
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing); // 抗锯齿，使图形更平滑
 
@@ -556,9 +915,9 @@ void Canvas::paintEvent(QPaintEvent* event) {
         QBrush brush(Qt::lightGray);     // light gray fill
         painter.setBrush(brush);
 
-        long double x = multipleSelectionStartPos_.x(), y = multipleSelectionStartPos_.y();
-        long double dx = multipleSelectionEndPos_.x() - x;
-        long double dy = multipleSelectionEndPos_.y() - y;
+        Real x = multipleSelectionStartPos_.x(), y = multipleSelectionStartPos_.y();
+        Real dx = multipleSelectionEndPos_.x() - x;
+        Real dy = multipleSelectionEndPos_.y() - y;
         QRect rect(x, y, dx, dy);    // x, y, width, height
         painter.drawRect(rect);
 
@@ -566,38 +925,291 @@ void Canvas::paintEvent(QPaintEvent* event) {
     }
 
     if (!showObjectsCache.empty()){
+        invalidateFrame();
         for (auto obj : showObjectsCache){
             obj->setSelected(true);
-            selectedObjs_.insert(obj);
+            selectedObjs_.insert(obj->getHandle());
         }
         showObjectsCache.clear();
     }
 
+    QElapsedTimer timer;
+    timer.start();
+    if (pipelined_) {
+        // 只显示最近一次光栅化完的画面; 模型改变过就录下新的一帧交给后台线程
+        takeFrame();
+        if (frame_.size() != size() * devicePixelRatioF()) {
+            frameStale_ = true;
+        }
+        qint64 flushNs = 0;
+        if (frameStale_ && !frameJob_.valid()) {
+            flushNs = startFrame();
+        }
+        painter.drawImage(QPointF(0, 0), frame_);
+        frameStats_.flush += flushNs;
+        frameStats_.draw += timer.nsecsElapsed() - flushNs;
+    } else {
+        qint64 flushNs = drawScene(&painter, rect(), event->rect());
+        frameStats_.flush += flushNs;
+        frameStats_.draw += timer.nsecsElapsed() - flushNs;
+    }
+    reportFrameStats(timer.nsecsElapsed());
+}
+
+qint64 Canvas::drawScene(QPainter* painter, const QRect& viewport, const QRect& dirty) {
     // 绘制所有正式的几何对象
+    QElapsedTimer timer;
+    timer.start();
     flushObjects();
-    for (const auto* obj : objects_) {
-        if (obj->isShown() and obj->getObjectType() != ObjectType::Point){
-            obj->draw(&painter);
+    qint64 flushNs = timer.nsecsElapsed();
+    // 局部重绘时只画和重绘区域相交的对象 (painter 本身已经裁剪到这个区域);
+    // 细节程度只在整体重绘时调整, 否则重绘区域内外会不一致
+    const bool partial = !dirty.isNull() && !dirty.contains(viewport);
+    const QRectF area = partial ? QRectF(dirty) : QRectF(viewport);
+    if (!partial) {
+        updateLevelOfDetail(viewport);
+    }
+    renderOptions.labels = !overview_ and !interacting_;
+    renderOptions.draft = interacting_;
+    painter->setRenderHint(QPainter::Antialiasing, !interacting_);
+
+    // 每个图层画在自己的缓存上, 再按图层顺序贴到 painter 上: 隐藏的图层整个跳过,
+    // 没有变化的图层直接贴缓存, 所以切换图层的显示不需要重画任何对象
+    // 录制 QPicture (流水线模式) 时不用缓存, 对象直接录进去, 光栅化留给后台线程; 分块绘制也一样
+    const bool recording = painter->device()->devType() == QInternal::Picture;
+    TileRenderer* tiles = recording ? nullptr : tileRenderer_.get();
+    const LayerSet& layers = table_.layers();
+    const qreal ratio = painter->device()->devicePixelRatio();
+    const QSize pixels = viewport.size() * ratio;
+    const int options = int(overview_) | int(interacting_) << 1;
+    layerCaches_.resize(layers.size());
+    std::vector<int> stale;
+    for (int i = 0; i < layers.size(); ++i) {
+        LayerCache& cache = layerCaches_[i];
+        if (recording) {
+            cache.region = layers.isVisible(i) ? viewport : QRect();
+            if (layers.isVisible(i)) {
+                stale.push_back(i);
+            }
+            continue;
         }
+        if (!layers.isVisible(i)) {
+            cache.shown = false;
+            cache.region = QRect();
+            continue;
+        }
+        const bool reusable = cache.image.size() == pixels && cache.options == options;
+        if (reusable && cache.revision == layers.revision(i)) {
+            cache.region = QRect();
+        } else {
+            // 上一帧贴过这个图层时, 它的变化都在 dirty 里 (局部重绘的前提), 只重画这一部分
+            cache.region = reusable && cache.shown && partial ? dirty : viewport;
+            stale.push_back(i);
+        }
+        cache.shown = true;
     }
-    for (const auto* obj : tempObjects_) {
-        if (obj->isShown() and obj->getObjectType() != ObjectType::Point){
-            obj->draw(&painter);
+
+    // 先画非点对象, 再画点; 概览模式下普通的点, 以及屏幕上不到一个像素的圆和线段合并成像素点
+    std::vector<std::vector<TileRenderer::Item>> layerItems(layers.size());
+    std::vector<SpriteBatch> layerSprites(layers.size());
+    auto collect = [&](const GeometricObject* obj, int pass, const QRectF& region,
+                       std::vector<TileRenderer::Item>& items, SpriteBatch& sprites) {
+        if (!obj->isShown() or (obj->getObjectType() == ObjectType::Point) != (pass == 1)) {
+            return;
+        }
+        if (overview_ and pass == 1 and !obj->isHovered() and !obj->isSelected()) {
+            if (region.contains(obj->position())) {
+                sprites.add(obj->position(), obj->getColor());
+            }
+            return;
+        }
+        QRectF bounds = obj->boundingRect(viewport);
+        if (!bounds.intersects(region)) {
+            return;
+        }
+        if (isSubPixel(obj)) {
+            sprites.add(bounds.center(), obj->getColor());
+        } else {
+            items.push_back({obj, bounds});
+        }
+    };
+    if (!stale.empty()) {
+        for (int pass = 0; pass < 2; ++pass) {
+            for (const auto* obj : objects_) {
+                LayerCache& cache = layerCaches_[obj->getLayer()];
+                if (!cache.region.isNull()) {
+                    collect(obj, pass, cache.region, layerItems[obj->getLayer()], layerSprites[obj->getLayer()]);
+                }
+            }
         }
     }
-    for (const auto* obj : objects_) {
-        if (obj->isShown() and obj->getObjectType() == ObjectType::Point){
-            obj->draw(&painter);
+    for (int i : stale) {
+        LayerCache& cache = layerCaches_[i];
+        if (recording) {
+            drawItems(painter, nullptr, layerItems[i], layerSprites[i], viewport, QRect());
+            continue;
+        }
+        if (cache.image.size() != pixels) {
+            cache.image = QImage(pixels, QImage::Format_ARGB32_Premultiplied);
+            cache.image.setDevicePixelRatio(ratio);
         }
+        QPainter layerPainter(&cache.image);
+        layerPainter.translate(-viewport.topLeft());
+        layerPainter.setClipRect(cache.region);
+        layerPainter.setCompositionMode(QPainter::CompositionMode_Source);
+        layerPainter.fillRect(cache.region, Qt::transparent);
+        layerPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        layerPainter.setRenderHint(QPainter::Antialiasing, !interacting_);
+        drawItems(&layerPainter, tiles, layerItems[i], layerSprites[i], viewport,
+                  cache.region == viewport ? QRect() : cache.region);
+        cache.revision = layers.revision(i);
+        cache.options = options;
+    }
+    for (int i = 0; i < layers.size() && !recording; ++i) {
+        if (layers.isVisible(i)) {
+            painter->drawImage(viewport.topLeft(), layerCaches_[i].image);
+        }
+    }
+
+    // 预览对象每次移动鼠标都会变, 不进缓存, 画在所有图层上面
+    std::vector<TileRenderer::Item> previewItems;
+    SpriteBatch previewSprites;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const auto* obj : tempObjects_) {
+            collect(obj, pass, area, previewItems, previewSprites);
+        }
+    }
+    drawItems(painter, tiles, previewItems, previewSprites, viewport, partial ? dirty : QRect());
+    return flushNs;
+}
+
+bool Canvas::isSubPixel(const GeometricObject* obj) {
+    switch (obj->getObjectType()) {
+    case ObjectType::Circle:
+    case ObjectType::Arc:
+    case ObjectType::Lineoo: {
+        auto [p1, p2] = obj->getTwoPoints();
+        return len(p1 - p2) < LodPixel;
+    }
+    default:
+        return false;
     }
-    for (const auto* obj : tempObjects_) {
-        if (obj->isShown() and obj->getObjectType() == ObjectType::Point){
-            obj->draw(&painter);
+}
+
+void Canvas::updateLevelOfDetail(const QRect& viewport) {
+    // 用屏幕上点的密度判断: 平均每个格子里挤了不止一个点时切换到概览, 稀疏下来再切回去
+    int points = 0;
+    std::unordered_set<qint64> cells;
+    for (const auto* obj : objects_) {
+        if (obj->isShown() and obj->getObjectType() == ObjectType::Point and viewport.contains(obj->position().toPoint())) {
+            ++points;
+            cells.insert(cellKey(obj->position(), LodCellSize));
         }
     }
+    double crowding = cells.empty() ? 0 : double(points) / cells.size();
+    if (points < LodMinPoints) {
+        overview_ = false;
+    } else if (!overview_ and crowding > LodEnterCrowding) {
+        overview_ = true;
+    } else if (overview_ and crowding < LodLeaveCrowding) {
+        overview_ = false;
+    }
+}
+
+void Canvas::beginInteraction() {
+    interacting_ = true;
+    idleTimer_.start(RefineDelayMs); // 每次输入都推迟精细重绘
+}
+
+void Canvas::onIdle() {
+    invalidateFrame();
+    interacting_ = false;
+    update();
+}
+
+void Canvas::setPipelined(bool pipelined) {
+    invalidateFrame();
+    pipelined_ = pipelined;
+    frame_ = QImage();
+    layerCaches_.clear(); // 流水线模式不维护图层缓存
+    update();
+}
+
+void Canvas::setTiledRendering(bool tiled) {
+    invalidateFrame();
+    tileRenderer_.reset(tiled ? new TileRenderer : nullptr);
+    update();
+}
+
+qint64 Canvas::startFrame() {
+    frameStale_ = false;
+    const QRect viewport = rect();
+    const qreal ratio = devicePixelRatioF();
+    // 计算, 细节程度和绘制选项都在 GUI 线程里完成, 录下的绘制命令之后不再依赖对象
+    QPicture scene;
+    QPainter recorder(&scene);
+    recorder.setClipRect(viewport);
+    qint64 flushNs = drawScene(&recorder, viewport, QRect());
+    recorder.end();
+    frameJob_ = std::async(std::launch::async, [this, scene, viewport, ratio]() {
+        QImage image(viewport.size() * ratio, QImage::Format_ARGB32_Premultiplied);
+        image.setDevicePixelRatio(ratio);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        painter.drawPicture(QPointF(0, 0), scene);
+        painter.end();
+        QMetaObject::invokeMethod(this, &Canvas::onFrameReady, Qt::QueuedConnection);
+        return image;
+    });
+    return flushNs;
+}
+
+void Canvas::takeFrame() {
+    if (!frameJob_.valid() || frameJob_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+    QImage image = frameJob_.get();
+    // 录制之后对象又变了的画面不显示, 由 paintEvent 马上开始下一帧; 还没有任何画面时先凑合用它
+    if (!frameStale_ || frame_.isNull()) {
+        frame_ = image;
+    }
+}
+
+void Canvas::onFrameReady() {
+    takeFrame(); // 可能已经被 paintEvent 取走了
+    update();
+}
+
+void Canvas::invalidateFrame() {
+    frameStale_ = true;
+}
+
+void Canvas::reportFrameStats(qint64 frameNs) {
+    static const bool enabled = qEnvironmentVariableIsSet("GEOTHU_FRAME_STATS");
+    if (!enabled) {
+        return;
+    }
+    if (!frameStats_.window.isValid()) {
+        frameStats_.window.start();
+    }
+    ++frameStats_.frames;
+    int budget = frameTimer_.interval() > 0 ? frameTimer_.interval() : 16;
+    if (frameNs + frameStats_.input / frameStats_.frames > qint64(budget) * 1000000) {
+        ++frameStats_.overBudget;
+    }
+    if (frameStats_.window.elapsed() < 1000) {
+        return;
+    }
+    auto ms = [this](qint64 ns) { return ns / 1e6 / frameStats_.frames; };
+    qDebug().nospace() << "frames " << frameStats_.frames << ", input " << ms(frameStats_.input)
+                       << " ms, flush " << ms(frameStats_.flush) << " ms, draw " << ms(frameStats_.draw)
+                       << " ms, over budget " << frameStats_.overBudget;
+    frameStats_ = FrameStats();
+    frameStats_.window.start();
 }
 
 void Canvas::contextMenuEvent(QContextMenuEvent* event) {
+    invalidateFrame();
     QPointF pos = event->pos(); // 获取鼠标右键点击的画布坐标
     GeometricObject* contextMenuObj = findObjNear(pos); // 查找点击位置的对象
 
@@ -607,10 +1219,11 @@ void Canvas::contextMenuEvent(QContextMenuEvent* event) {
     if (!contextMenuObj->isSelected()) {
         clearSelections();
         contextMenuObj->setSelected(true);
-        selectedObjs_.insert(contextMenuObj);
+        selectedObjs_.insert(contextMenuObj->getHandle());
         update(); // 更新显示以反映选择变化
     }
 
+    damage(contextMenuObj); // 修改样式前的范围, 菜单项修改后再加上新的范围
     QMenu menu(this); // 创建上下文菜单
 
     // --- 针对不同对象类型的菜单项 ---
@@ -619,29 +1232,28 @@ void Canvas::contextMenuEvent(QContextMenuEvent* event) {
         if (!point) return;
 
         QMenu* colorMenu = menu.addMenu(tr("color")); // tr() 用于国际化
-        colorMenu->addAction(tr("red"), [this, point]() { point->setColor(Qt::red); update(); });
-        colorMenu->addAction(tr("blue"), [this, point]() { point->setColor(Qt::darkBlue); update(); });
-        colorMenu->addAction(tr("green"), [this, point]() { point->setColor(Qt::darkGreen); update(); });
-        colorMenu->addAction(tr("black"), [this, point]() { point->setColor(Qt::black); update(); });
+        colorMenu->addAction(tr("red"), [this, point]() { point->setColor(Qt::red); updateObject(point); });
+        colorMenu->addAction(tr("blue"), [this, point]() { point->setColor(Qt::darkBlue); updateObject(point); });
+        colorMenu->addAction(tr("green"), [this, point]() { point->setColor(Qt::darkGreen); updateObject(point); });
+        colorMenu->addAction(tr("black"), [this, point]() { point->setColor(Qt::black); updateObject(point); });
         colorMenu->addAction(tr("customize..."), [this, point]() {
             QColor color = QColorDialog::getColor(point->getColor(), this, tr("select color"));
             if (color.isValid()) {
                 point->setColor(color);
-                update();
+                updateObject(point);
             }
         });
 
         QMenu* sizeMenu = menu.addMenu(tr("size"));
-        sizeMenu->addAction(tr("tiny"), [this, point]() { point->setSize(2); update(); });
-        sizeMenu->addAction(tr("small"),   [this, point]() { point->setSize(3); update(); });
-        sizeMenu->addAction(tr("medium"),   [this, point]() { point->setSize(4); update(); });
-        sizeMenu->addAction(tr("large"),   [this, point]() { point->setSize(5); update(); });
+        sizeMenu->addAction(tr("tiny"), [this, point]() { point->setSize(2); updateObject(point); });
+        sizeMenu->addAction(tr("small"),   [this, point]() { point->setSize(3); updateObject(point); });
+        sizeMenu->addAction(tr("medium"),   [this, point]() { point->setSize(4); updateObject(point); });
+        sizeMenu->addAction(tr("large"),   [this, point]() { point->setSize(5); updateObject(point); });
 
         menu.addAction(tr("label..."), [this, point]() {
             bool ok;
             QString text = QInputDialog::getText(this, tr("set label"), tr("label:"), QLineEdit::Normal, point->getLabel(), &ok);
-            if (ok) {
-                point->setLabel(text);
+            if (ok && renameObject(point, text)) {
                 update();
             }
         });
@@ -651,34 +1263,33 @@ void Canvas::contextMenuEvent(QContextMenuEvent* event) {
                contextMenuObj->getObjectType() == ObjectType::Lineoo){
 
         QMenu* colorMenu = menu.addMenu(tr("color")); // tr() 用于国际化
-        colorMenu->addAction(tr("red"), [this, contextMenuObj]() { contextMenuObj->setColor(Qt::red); update(); });
-        colorMenu->addAction(tr("blue"), [this, contextMenuObj]() { contextMenuObj->setColor(Qt::darkBlue); update(); });
-        colorMenu->addAction(tr("green"), [this, contextMenuObj]() { contextMenuObj->setColor(Qt::darkGreen); update(); });
-        colorMenu->addAction(tr("black"), [this, contextMenuObj]() { contextMenuObj->setColor(Qt::black); update(); });
+        colorMenu->addAction(tr("red"), [this, contextMenuObj]() { contextMenuObj->setColor(Qt::red); updateObject(contextMenuObj); });
+        colorMenu->addAction(tr("blue"), [this, contextMenuObj]() { contextMenuObj->setColor(Qt::darkBlue); updateObject(contextMenuObj); });
+        colorMenu->addAction(tr("green"), [this, contextMenuObj]() { contextMenuObj->setColor(Qt::darkGreen); updateObject(contextMenuObj); });
+        colorMenu->addAction(tr("black"), [this, contextMenuObj]() { contextMenuObj->setColor(Qt::black); updateObject(contextMenuObj); });
         colorMenu->addAction(tr("customize..."), [this, contextMenuObj]() {
             QColor color = QColorDialog::getColor(contextMenuObj->getColor(), this, tr("select color"));
             if (color.isValid()) {
                 contextMenuObj->setColor(color);
-                update();
+                updateObject(contextMenuObj);
             }
         });
 
         QMenu* sizeMenu = menu.addMenu(tr("thickness"));
-        sizeMenu->addAction(tr("thin"), [this, contextMenuObj]() { contextMenuObj->setSize(1); update(); });
-        sizeMenu->addAction(tr("medium"),   [this, contextMenuObj]() { contextMenuObj->setSize(2); update(); });
-        sizeMenu->addAction(tr("thick"),   [this, contextMenuObj]() { contextMenuObj->setSize(3); update(); });
-        sizeMenu->addAction(tr("ultra-thick"),   [this, contextMenuObj]() { contextMenuObj->setSize(4); update(); });
+        sizeMenu->addAction(tr("thin"), [this, contextMenuObj]() { contextMenuObj->setSize(1); updateObject(contextMenuObj); });
+        sizeMenu->addAction(tr("medium"),   [this, contextMenuObj]() { contextMenuObj->setSize(2); updateObject(contextMenuObj); });
+        sizeMenu->addAction(tr("thick"),   [this, contextMenuObj]() { contextMenuObj->setSize(3); updateObject(contextMenuObj); });
+        sizeMenu->addAction(tr("ultra-thick"),   [this, contextMenuObj]() { contextMenuObj->setSize(4); updateObject(contextMenuObj); });
 
         QMenu* shapeMenu = menu.addMenu(tr("linestyle"));
-        shapeMenu->addAction(tr("solid"), [this, contextMenuObj]() { contextMenuObj->setShape(0); update(); });
-        shapeMenu->addAction(tr("dashed"),   [this, contextMenuObj]() { contextMenuObj->setShape(1); update(); });
-        shapeMenu->addAction(tr("dotted"),   [this, contextMenuObj]() { contextMenuObj->setShape(2); update(); });
+        shapeMenu->addAction(tr("solid"), [this, contextMenuObj]() { contextMenuObj->setShape(0); updateObject(contextMenuObj); });
+        shapeMenu->addAction(tr("dashed"),   [this, contextMenuObj]() { contextMenuObj->setShape(1); updateObject(contextMenuObj); });
+        shapeMenu->addAction(tr("dotted"),   [this, contextMenuObj]() { contextMenuObj->setShape(2); updateObject(contextMenuObj); });
 
         menu.addAction(tr("label..."), [this, contextMenuObj]() {
             bool ok;
             QString text = QInputDialog::getText(this, tr("set label"), tr("label:"), QLineEdit::Normal, contextMenuObj->getLabel(), &ok);
-            if (ok) {
-                contextMenuObj->setLabel(text);
+            if (ok && renameObject(contextMenuObj, text)) {
                 update();
             }
         });
@@ -689,34 +1300,33 @@ void Canvas::contextMenuEvent(QContextMenuEvent* event) {
         if (!circle and !arc) return;
 
         QMenu* colorMenu = menu.addMenu(tr("color"));
-        colorMenu->addAction(tr("red"), [this, circle]() { circle->setColor(Qt::red); update(); });
-        colorMenu->addAction(tr("blue"), [this, circle]() { circle->setColor(Qt::darkBlue); update(); });
-        colorMenu->addAction(tr("green"), [this, circle]() { circle->setColor(Qt::darkGreen); update(); });
-        colorMenu->addAction(tr("black"), [this, circle]() { circle->setColor(Qt::black); update(); });
+        colorMenu->addAction(tr("red"), [this, circle]() { circle->setColor(Qt::red); updateObject(circle); });
+        colorMenu->addAction(tr("blue"), [this, circle]() { circle->setColor(Qt::darkBlue); updateObject(circle); });
+        colorMenu->addAction(tr("green"), [this, circle]() { circle->setColor(Qt::darkGreen); updateObject(circle); });
+        colorMenu->addAction(tr("black"), [this, circle]() { circle->setColor(Qt::black); updateObject(circle); });
         colorMenu->addAction(tr("customize..."), [this, circle]() {
             QColor color = QColorDialog::getColor(circle->getColor(), this, tr("select color"));
             if (color.isValid()) {
                 circle->setColor(color);
-                update();
+                updateObject(circle);
             }
         });
 
         QMenu* lineWidthMenu = menu.addMenu(tr("thickness"));
-        lineWidthMenu->addAction("thin", [this, circle]() { circle->setSize(1.0); update(); });
-        lineWidthMenu->addAction("medium", [this, circle]() { circle->setSize(2.0); update(); });
-        lineWidthMenu->addAction("thick", [this, circle]() { circle->setSize(3.0); update(); });
-        lineWidthMenu->addAction("ultra-thick", [this, circle]() { circle->setSize(4.0); update(); });
+        lineWidthMenu->addAction("thin", [this, circle]() { circle->setSize(1.0); updateObject(circle); });
+        lineWidthMenu->addAction("medium", [this, circle]() { circle->setSize(2.0); updateObject(circle); });
+        lineWidthMenu->addAction("thick", [this, circle]() { circle->setSize(3.0); updateObject(circle); });
+        lineWidthMenu->addAction("ultra-thick", [this, circle]() { circle->setSize(4.0); updateObject(circle); });
 
         QMenu* shapeMenu = menu.addMenu(tr("linestyle"));
-        shapeMenu->addAction(tr("solid"), [this, contextMenuObj]() { contextMenuObj->setShape(0); update(); });
-        shapeMenu->addAction(tr("dashed"),   [this, contextMenuObj]() { contextMenuObj->setShape(1); update(); });
-        shapeMenu->addAction(tr("dotted"),   [this, contextMenuObj]() { contextMenuObj->setShape(2); update(); });
+        shapeMenu->addAction(tr("solid"), [this, contextMenuObj]() { contextMenuObj->setShape(0); updateObject(contextMenuObj); });
+        shapeMenu->addAction(tr("dashed"),   [this, contextMenuObj]() { contextMenuObj->setShape(1); updateObject(contextMenuObj); });
+        shapeMenu->addAction(tr("dotted"),   [this, contextMenuObj]() { contextMenuObj->setShape(2); updateObject(contextMenuObj); });
 
         menu.addAction(tr("label..."), [this, circle]() {
             bool ok;
             QString text = QInputDialog::getText(this, tr("set label"), tr("label:"), QLineEdit::Normal, circle->getLabel(), &ok);
-            if (ok) {
-                circle->setLabel(text);
+            if (ok && renameObject(circle, text)) {
                 update();
             }
         });
@@ -729,7 +1339,7 @@ void Canvas::contextMenuEvent(QContextMenuEvent* event) {
         contextMenuObj->setHidden(true);
         contextMenuObj->setSelected(false);
         loadInCache();
-        selectedObjs_.erase(contextMenuObj);
+        selectedObjs_.erase(contextMenuObj->getHandle());
         update();
     });
 
@@ -737,7 +1347,7 @@ void Canvas::contextMenuEvent(QContextMenuEvent* event) {
         menu.addAction(tr(contextMenuObj->islablehidden()?"show label":"hide label"), [this, contextMenuObj]() {
             contextMenuObj->setlabelhidden(1-contextMenuObj->islablehidden());
             contextMenuObj->setSelected(false);
-            selectedObjs_.erase(contextMenuObj);
+            selectedObjs_.erase(contextMenuObj->getHandle());
             update();
         });
     }
@@ -756,6 +1366,11 @@ void Canvas::contextMenuEvent(QContextMenuEvent* event) {
 }
 
 void Canvas::keyPressEvent(QKeyEvent *event) {
+    if (recorder_) {
+        recorder_->record(InteractionRecorder::KeyPress, event);
+    }
+    invalidateFrame();
+    flushPendingInput(); // 先处理之前合并的移动, 保证事件顺序
     if (event->key() == Qt::Key_Up or event->key() == Qt::Key_Down or
         event->key() == Qt::Key_Right or event->key() == Qt::Key_Left) {
         QPointF delta;
@@ -805,6 +1420,9 @@ void Canvas::keyPressEvent(QKeyEvent *event) {
         loadFile();
         update();
     }
+    if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_E) {
+        exportFile();
+    }
     if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_Z) {
         undo();
         update();
@@ -813,12 +1431,54 @@ void Canvas::keyPressEvent(QKeyEvent *event) {
         redo();
         update();
     }
+    if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_I) {
+        intersectSelection();
+    }
+    if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_B) {
+        applyToolToSelection();
+    }
+    if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_M) {
+        emit statusMessage(memoryReport().replace('\n', "; "));
+    }
+    if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_F) {
+        bool ok;
+        QString label = QInputDialog::getText(this, tr("find"), tr("label:"), QLineEdit::Normal, QString(), &ok);
+        if (ok) {
+            findByLabel(label);
+        }
+    }
+    if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_R && !selectedObjs_.empty()) {
+        bool ok;
+        QString base = QInputDialog::getText(this, tr("rename selection"), tr("base label:"), QLineEdit::Normal, QString(), &ok);
+        if (ok && !base.isEmpty()) {
+            renameSelection(base);
+        }
+    }
+    if (event->modifiers() == Qt::ControlModifier && event->key() >= Qt::Key_1 && event->key() <= Qt::Key_9) {
+        int layer = event->key() - Qt::Key_1;
+        if (layer < table_.layers().size()) {
+            setLayerVisible(layer, !table_.layers().isVisible(layer));
+        }
+    }
+    if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_G) {
+        const LayerSet& layers = table_.layers();
+        QString prompt = tr("layer:");
+        for (int i = 0; i < layers.size() && i < 9; ++i) {
+            prompt += QString("\n  Ctrl+%1: %2%3").arg(i + 1).arg(layers.name(i)).arg(layers.isVisible(i) ? "" : " (hidden)");
+        }
+        bool ok;
+        QString name = QInputDialog::getText(this, tr("layer"), prompt, QLineEdit::Normal,
+                                             layers.name(layers.current()), &ok);
+        if (ok && !name.isEmpty()) {
+            useLayer(name);
+        }
+    }
     if (event->modifiers() == Qt::ControlModifier && event->key() == Qt::Key_A) {
         selectedObjs_.clear();
         for (auto obj : objects_) {
             if (obj->isShown()) {
                 obj->setSelected(true);
-                selectedObjs_.insert(obj);
+                selectedObjs_.insert(obj->getHandle());
             }
         }
         update();
@@ -831,10 +1491,16 @@ void Canvas::keyPressEvent(QKeyEvent *event) {
 }
 
 void Canvas::wheelEvent(QWheelEvent *event) {
+    if (recorder_) {
+        recorder_->record(InteractionRecorder::Wheel, event);
+    }
+    invalidateFrame();
+    flushPendingInput(); // 先处理之前合并的移动, 保证事件顺序
+    beginInteraction();
     mousePos_ = event->position();
     if (!(event->modifiers() & Qt::ControlModifier)){
-        long double deltay = event->angleDelta().y();
-        long double deltax = event->angleDelta().x();
+        Real deltay = event->angleDelta().y();
+        Real deltax = event->angleDelta().x();
         for (auto obj : objects_) {
             if (obj->getObjectType() == ObjectType::Point and obj->getParents().empty()) {
                 auto curPosition = obj->position();
@@ -865,7 +1531,7 @@ void Canvas::wheelEvent(QWheelEvent *event) {
             }
         }
     } else {
-        long double deltay = event->angleDelta().y();
+        Real deltay = event->angleDelta().y();
         for (auto obj : objects_) {
             if (obj->getObjectType() == ObjectType::Point and obj->getParents().empty()) {
                 auto curPosition = obj->position();
@@ -906,6 +1572,7 @@ void Canvas::setFilePath(QString path) {
 }
 
 bool Canvas::saveFile() {
+    invalidateFrame();
     if (filePath_.isEmpty()) {
         QString path = QFileDialog::getSaveFileName(this, "save", "", "My Files (*.thu)");
         if (path.isEmpty()){
@@ -933,12 +1600,31 @@ bool Canvas::saveFile() {
     for (auto obj : allObjs) {
         helper.save(obj, out);
     }
+    helper.saveTools(usedTools_, out);
+    helper.saveLayers(table_.layers(), allObjs, out);
     file.close();
     saved_ = true;
     return true;
 }
 
+bool Canvas::exportFile() {
+    invalidateFrame();
+    QString path = QFileDialog::getSaveFileName(this, "Export", "", "SVG (*.svg);;PDF (*.pdf)");
+    if (path.isEmpty()) {
+        return false;
+    }
+    flushObjects();
+    Exporter exporter(size());
+    bool ok = path.endsWith(".pdf", Qt::CaseInsensitive) ? exporter.writePdf(objects_, path)
+                                                           : exporter.writeSvg(objects_, path);
+    if (!ok) {
+        QMessageBox::warning(this, "Error", "Could not export to:\n" + path);
+    }
+    return ok;
+}
+
 void Canvas::loadFile(bool onStartup) {
+    invalidateFrame();
     clearObjects();
     clearTempObjects();
     if (!onStartup) {
@@ -951,47 +1637,167 @@ void Canvas::loadFile(bool onStartup) {
 
     QFile file(filePath_);
     if (!file.open(QIODevice::ReadOnly)) {
-        QMessageBox::warning(this, "Error", "Could not open the file.");
+        warn("Error", "Could not open the file.");
         return;
     }
 
     QDataStream in(&file);
     in.setVersion(QDataStream::Qt_6_0);
-    int n, m;
-    in >> n >> m;
     Saveloadhelper helper;
-    for (int i = 0; i < n; ++i){
-        GeometricObject* obj = helper.load(in);
+    // 文件里的对象原样读入, 不合并: 合并会丢掉被删除那个对象的标签和样式
+    for (auto obj : helper.loadObjects(table_, in)){
+        structures_.insert(obj);
         if (obj->isAux()){
             auxObjs_.push_back(obj);
         } else {
             objects_.push_back(obj);
         }
     }
-    NumOfMeasurements = m;
+
+    // 文件中嵌入的自定义工具: 已有同名且计划相同的工具时沿用本地的版本,
+    // 计划不同时把嵌入的工具改名后注册, 两个都保留
+    usedTools_.clear();
+    std::vector<RegisteredTool> registered;
+    for (CustomizedOperation* oper : helper.loadTools(in)) {
+        QString name = QString::fromStdString(oper->getName());
+        CustomizedOperation* local = nullptr;
+        for (auto op : operations) {
+            CustomizedOperation* custom = dynamic_cast<CustomizedOperation*>(op);
+            if (custom && QString::fromStdString(custom->getName()) == name) {
+                local = custom;
+            }
+        }
+        if (local && local->samePlan(*oper)) {
+            markToolUsed(local);
+            delete oper;
+            continue;
+        }
+        if (operationNames_.find(name) != operationNames_.end()) {
+            QString base = name + " (" + QFileInfo(filePath_).completeBaseName() + ")";
+            name = base;
+            for (int n = 2; operationNames_.find(name) != operationNames_.end(); ++n) {
+                name = base + " " + QString::number(n);
+            }
+            oper->setName(name);
+        }
+        operationNames_.insert(name);
+        operations.push_back(oper);
+        usedTools_.push_back(oper);
+        registered.push_back({name, int(operations.size()) - 1, ":/raw_icons/new_tool.png"});
+    }
+    std::vector<GeometricObject*> allObjs = objects_;
+    allObjs.insert(allObjs.end(), auxObjs_.begin(), auxObjs_.end());
+    helper.loadLayers(table_.layers(), allObjs, in);
     file.close();
     loadInCache();
     saved_ = true;
+    if (!registered.empty()) {
+        emit toolsRegistered(registered);
+    }
 }
 
 void Canvas::loadInCache() {
-    maxUndoCount_ = std::min(maxCacheSize, maxUndoCount_ + 1);
+    invalidateFrame();
+    table_.layers().touchAll(); // 对象增删不改变对象本身的状态, 图层缓存在这里失效
+    hitTester_.invalidate();    // 命中测试的索引也一样
+    // 新的一步之后, 之前撤销掉的步骤不能再重做; 记录已满时最旧的一步被覆盖, 不能再撤销到那里
+    std::vector<ObjectHandle> unreferenced;
+    for (int k = 1; k <= maxRedoCount_; ++k) {
+        releaseSnapshot((currentCacheIndex_ + k) % maxCacheSize, unreferenced);
+    }
+    // 当前状态也占一条记录, 所以最多撤销 maxCacheSize - 1 步
+    maxUndoCount_ = std::min(maxCacheSize - 1, maxUndoCount_ + 1);
     maxRedoCount_ = 0;
     currentCacheIndex_ = (currentCacheIndex_ + 1) % maxCacheSize;
-    cacheObj_[currentCacheIndex_] = objects_;
-    cacheDel_[currentCacheIndex_] = deletedObjs_;
-    cacheAux_[currentCacheIndex_] = auxObjs_;
+    releaseSnapshot(currentCacheIndex_, unreferenced);
+    for (auto obj : objects_) {
+        cacheObj_[currentCacheIndex_].push_back(obj->getHandle());
+    }
+    for (auto obj : auxObjs_) {
+        cacheAux_[currentCacheIndex_].push_back(obj->getHandle());
+    }
+    retainSnapshot(currentCacheIndex_);
     std::vector<bool> hiddenStates = {};
     std::vector<QPointF> pos = {};
     for (auto obj : objects_) {
+        if (obj->getObjectType() == ObjectType::Point) {
+            obj->evaluate(); // 撤销时会用这些位置反算约束点的参数, 隐藏的点也要是最新的
+        }
         hiddenStates.push_back(obj->isHidden());
         pos.push_back(obj->position());
     }
     cacheHidden_[currentCacheIndex_] = hiddenStates;
     cachePos_[currentCacheIndex_] = pos;
+    reclaim(unreferenced);
     saved_ = false;
 }
 
+void Canvas::retainSnapshot(int slot) {
+    for (auto handle : cacheObj_[slot]) {
+        ++snapshotRefs_[handle];
+    }
+    for (auto handle : cacheAux_[slot]) {
+        ++snapshotRefs_[handle];
+    }
+}
+
+void Canvas::releaseSnapshot(int slot, std::vector<ObjectHandle>& unreferenced) {
+    for (auto list : {&cacheObj_[slot], &cacheAux_[slot]}) {
+        for (auto handle : *list) {
+            auto it = snapshotRefs_.find(handle);
+            if (it != snapshotRefs_.end() && --it->second == 0) {
+                unreferenced.push_back(handle);
+            }
+        }
+    }
+    std::vector<ObjectHandle>().swap(cacheObj_[slot]);
+    std::vector<ObjectHandle>().swap(cacheAux_[slot]);
+    std::vector<bool>().swap(cacheHidden_[slot]);
+    std::vector<QPointF>().swap(cachePos_[slot]);
+}
+
+void Canvas::reclaim(const std::vector<ObjectHandle>& unreferenced) {
+    // 计数可能在同一次 loadInCache 中先归零又被新记录加回来, 以最终的计数为准
+    std::unordered_set<GeometricObject*> dead;
+    for (auto handle : unreferenced) {
+        auto it = snapshotRefs_.find(handle);
+        if (it != snapshotRefs_.end() && it->second == 0) {
+            snapshotRefs_.erase(it);
+            if (GeometricObject* obj = table_.get(handle)) {
+                dead.insert(obj);
+            }
+        }
+    }
+    if (dead.empty()) {
+        return;
+    }
+    // 拖动的状态可能还指向撤销掉的对象; 悬停列表存的是句柄, 删除后自然失效
+    for (auto obj : dead) {
+        initialPositions_.erase(obj);
+        structures_.remove(obj);
+    }
+    if (dead.count(draggedObj_)) {
+        draggedObj_ = nullptr;
+    }
+    // 析构函数会断开父子关系, 所以这些对象之间按什么顺序删除都可以
+    for (auto obj : dead) {
+        delete obj;
+    }
+    reclaimedObjects_ += dead.size();
+    hitTester_.invalidate();
+}
+
+std::vector<GeometricObject*> Canvas::ownedObjects() const {
+    std::unordered_set<GeometricObject*> owned(objects_.begin(), objects_.end());
+    owned.insert(auxObjs_.begin(), auxObjs_.end());
+    for (const auto& entry : snapshotRefs_) {
+        if (GeometricObject* obj = table_.get(entry.first)) {
+            owned.insert(obj);
+        }
+    }
+    return std::vector<GeometricObject*>(owned.begin(), owned.end());
+}
+
 void Canvas::undo() {
     clearSelections();
     clearTempObjects();
@@ -1002,17 +1808,47 @@ void Canvas::undo() {
     --maxUndoCount_;
     ++maxRedoCount_;
     currentCacheIndex_ = (currentCacheIndex_ + maxCacheSize - 1) % maxCacheSize;
-    objects_ = cacheObj_[currentCacheIndex_];
-    deletedObjs_ = cacheDel_[currentCacheIndex_];
-    auxObjs_ = cacheAux_[currentCacheIndex_];
-    for (int i = 0; i < objects_.size(); ++i) {
-        objects_[i]->setHidden(cacheHidden_[currentCacheIndex_][i]);
-        objects_[i]->setSelected(false);
-        if (objects_[i]->getObjectType() == ObjectType::Point) {
-            Point* p = dynamic_cast<Point*>(objects_[i]);
+    restoreCache();
+}
+
+void Canvas::restoreCache() {
+    // 记录里的对象由 snapshotRefs_ 保证没有被释放, get 返回空只可能是记录本身出了问题
+    const auto& handles = cacheObj_[currentCacheIndex_];
+    table_.layers().touchAll();
+    hitTester_.invalidate();
+    structures_.clear();        // 撤销和重做本来就要遍历整条记录, 顺便重建
+    // 离开文档的对象不再占用标签; 先全部注销, 再按记录的顺序登记回来
+    for (auto obj : objects_) {
+        obj->unbindLabel();
+    }
+    for (auto obj : auxObjs_) {
+        obj->unbindLabel();
+    }
+    objects_.clear();
+    for (size_t i = 0; i < handles.size(); ++i) {
+        GeometricObject* obj = table_.get(handles[i]);
+        if (!obj) {
+            qWarning() << "Undo record refers to a deleted object";
+            continue;
+        }
+        objects_.push_back(obj);
+        structures_.insert(obj);
+        obj->rebindLabel();
+        obj->setHidden(cacheHidden_[currentCacheIndex_][i]);
+        obj->setSelected(false);
+        if (obj->getObjectType() == ObjectType::Point) {
+            Point* p = dynamic_cast<Point*>(obj);
             p->setPosition(cachePos_[currentCacheIndex_][i]);
         }
     }
+    auxObjs_.clear();
+    for (auto handle : cacheAux_[currentCacheIndex_]) {
+        if (GeometricObject* obj = table_.get(handle)) {
+            auxObjs_.push_back(obj);
+            structures_.insert(obj);
+            obj->rebindLabel();
+        }
+    }
     selectedObjs_.clear();
 }
 
@@ -1026,23 +1862,14 @@ void Canvas::redo() {
     --maxRedoCount_;
     ++maxUndoCount_;
     currentCacheIndex_ = (currentCacheIndex_ + 1) % maxCacheSize;
-    objects_ = cacheObj_[currentCacheIndex_];
-    deletedObjs_ = cacheDel_[currentCacheIndex_];
-    auxObjs_ = cacheAux_[currentCacheIndex_];
-    for (int i = 0; i < objects_.size(); ++i) {
-        objects_[i]->setHidden(cacheHidden_[currentCacheIndex_][i]);
-        objects_[i]->setSelected(false);
-        if (objects_[i]->getObjectType() == ObjectType::Point) {
-            Point* p = dynamic_cast<Point*>(objects_[i]);
-            p->setPosition(cachePos_[currentCacheIndex_][i]);
-        }
-    }
-    selectedObjs_.clear();
+    restoreCache();
 }
 
 void Canvas::deleteObjects(){
-    std::vector<GeometricObject*> toDelete(selectedObjs_.begin(), selectedObjs_.end());
-    for (auto obj : selectedObjs_) {
+    invalidateFrame();
+    std::set<GeometricObject*> selected = selection();
+    std::vector<GeometricObject*> toDelete(selected.begin(), selected.end());
+    for (auto obj : selected) {
         obj->setSelected(false);
     }
     selectedObjs_.clear(); // 清空选中集合
@@ -1057,31 +1884,140 @@ void Canvas::deleteObjects(){
                 auto iter = std::find(objects_.begin(), objects_.end(), curObj);
                 if (iter != objects_.end()){
                     objects_.erase(iter);
+                    structures_.remove(curObj);
+                    curObj->unbindLabel();
                     auto children = curObj->getChildren();
                     for (auto child : children){
                         s.push(child);
                     }
-                    deletedObjs_.push_back(curObj);
                 }
                 iter = std::find(auxObjs_.begin(), auxObjs_.end(), curObj);
                 if (iter != auxObjs_.end()){
                     auxObjs_.erase(iter);
+                    structures_.remove(curObj);
+                    curObj->unbindLabel();
                     auto children = curObj->getChildren();
                     for (auto child : children){
                         s.push(child);
                     }
-                    deletedObjs_.push_back(curObj);
                 }
             }
         }
+        // 删除的对象仍然留在撤销记录里, 记录不再能恢复它们时由 loadInCache 释放
+        dropStaleAux();
         loadInCache();
     }
     update();
 }
 
+namespace {
+
+size_t objectBytes(const GeometricObject* obj) {
+    size_t size = sizeof(GeometricObject);
+    switch (obj->getObjectType()) {
+    case ObjectType::Point: size = sizeof(Point); break;
+    case ObjectType::Line: size = sizeof(Line); break;
+    case ObjectType::Lineo: size = sizeof(Lineo); break;
+    case ObjectType::Lineoo: size = sizeof(Lineoo); break;
+    case ObjectType::Circle: size = sizeof(Circle); break;
+    case ObjectType::Arc: size = sizeof(Arc); break;
+    case ObjectType::Measurement: size = sizeof(Measurement); break;
+    default: break;
+    }
+    return size + obj->heapUsage();
+}
+
+} // namespace
+
+QString Canvas::memoryReport() const {
+    struct Category {
+        QString name;
+        size_t count = 0;
+        size_t bytes = 0;
+        void add(const GeometricObject* obj) {
+            ++count;
+            bytes += objectBytes(obj);
+        }
+    } shown{"objects"}, aux{"aux objects"}, history{"undo-only objects"}, temp{"preview objects"};
+
+    std::unordered_set<const GeometricObject*> current;
+    for (auto obj : objects_) {
+        shown.add(obj);
+        current.insert(obj);
+    }
+    for (auto obj : auxObjs_) {
+        aux.add(obj);
+        current.insert(obj);
+    }
+    // 已删除或已撤销, 只能通过撤销/重做恢复的对象
+    for (const auto& entry : snapshotRefs_) {
+        const GeometricObject* obj = table_.get(entry.first);
+        if (obj && !current.count(obj)) {
+            history.add(obj);
+        }
+    }
+    for (auto obj : tempObjects_) {
+        temp.add(obj);
+    }
+
+    size_t snapshotBytes = 0;
+    for (int i = 0; i < maxCacheSize; ++i) {
+        snapshotBytes += (cacheObj_[i].capacity() + cacheAux_[i].capacity()) * sizeof(ObjectHandle) +
+                         cacheHidden_[i].capacity() / 8 + cachePos_[i].capacity() * sizeof(QPointF);
+    }
+    snapshotBytes += snapshotRefs_.size() * (sizeof(ObjectHandle) + sizeof(int) + 2 * sizeof(void*));
+
+    auto kib = [](size_t bytes) { return QString::number(bytes / 1024.0, 'f', 1) + " KiB"; };
+    QString report;
+    for (const Category& c : {shown, aux, history, temp}) {
+        report += QString("%1: %2 (%3)\n").arg(c.name).arg(c.count).arg(kib(c.bytes));
+    }
+    report += QString("undo history: %1 undo / %2 redo steps (%3)\n")
+                  .arg(maxUndoCount_).arg(maxRedoCount_).arg(kib(snapshotBytes));
+    report += QString("object table: %1 styles, %2 label strings (%3)\n")
+                  .arg(table_.styles().size()).arg(table_.labels().size())
+                  .arg(kib(table_.bytes() + table_.styles().size() * sizeof(Style) + table_.labels().bytes()));
+    size_t layerBytes = 0;
+    for (const LayerCache& cache : layerCaches_) {
+        layerBytes += cache.image.sizeInBytes();
+    }
+    report += QString("layers: %1, cached rasters (%2)\n").arg(table_.layers().size()).arg(kib(layerBytes));
+    report += QString("reclaimed so far: %1 objects").arg(reclaimedObjects_);
+    return report;
+}
+
+void Canvas::dropStaleAux(){
+    // 只为已删除对象服务的辅助对象 (例如删掉自定义工具的结果后剩下的中间对象) 也从画布上去掉;
+    // 从后往前看, 子对象总是比父对象后创建
+    std::unordered_set<GeometricObject*> live(objects_.begin(), objects_.end());
+    std::vector<GeometricObject*> aux = auxObjs_;
+    std::sort(aux.begin(), aux.end(), [](GeometricObject* a, GeometricObject* b) {
+        return a->getIndex() > b->getIndex();
+    });
+    for (auto obj : aux) {
+        for (auto child : obj->getChildren()) {
+            if (live.count(child)) {
+                live.insert(obj);
+                break;
+            }
+        }
+    }
+    auxObjs_.erase(std::remove_if(auxObjs_.begin(), auxObjs_.end(),
+                                  [&](GeometricObject* obj) {
+                                      if (live.count(obj)) {
+                                          return false;
+                                      }
+                                      structures_.remove(obj);
+                                      obj->unbindLabel();
+                                      return true;
+                                  }),
+                   auxObjs_.end());
+}
+
 void Canvas::hideObjects(){
+    invalidateFrame();
     if (!selectedObjs_.empty()){
-        for (auto obj : selectedObjs_){
+        for (auto obj : selection()){
             obj->setHidden(true);
         }
         loadInCache();
@@ -1090,11 +2026,12 @@ void Canvas::hideObjects(){
 }
 
 void Canvas::showObjects(){
+    invalidateFrame();
     clearSelections();
     showObjectsCache.clear();
     bool flag = false;
     for (auto obj : objects_){
-        if (obj->isHidden()) {
+        if (obj->isHidden() && table_.layers().isVisible(obj->getLayer())) { // 隐藏图层里的对象仍然看不见
             flag = true;
             obj->setHidden(false);
             showObjectsCache.insert(obj);
@@ -1105,40 +2042,187 @@ void Canvas::showObjects(){
     }
 }
 
-void Canvas::clearObjects(){
-    for (auto obj : objects_){
-        delete obj;
+void Canvas::intersectSelection(){
+    invalidateFrame();
+    // 按 objects_ 的顺序取选中的曲线, 交点的生成顺序 (也就是标签) 不依赖集合里指针的顺序
+    std::vector<GeometricObject*> curves;
+    for (auto obj : objects_) {
+        ObjectType type = obj->getObjectType();
+        if (obj->isSelected() && obj->isShown() && type != ObjectType::Point && type != ObjectType::Measurement) {
+            curves.push_back(obj);
+        }
     }
-    for (auto obj : deletedObjs_){
-        delete obj;
+    if (curves.size() < 2) {
+        return;
     }
-    for (auto obj : auxObjs_){
+    // 交点各自占用了一个标签, 从生成之前的默认标签开始重新连续编号
+    quint32 labelMark = table_.labels().mark(ObjectType::Point);
+    std::vector<GeometricObject*> points = mergeDuplicates(IntersectionCreator().applyAll(curves));
+    table_.labels().restore(ObjectType::Point, labelMark);
+    clearSelections();
+    for (auto p : points) {
+        p->takeDefaultLabel();
+        objects_.push_back(p);
+        if (p->isLegal()) { // 暂时不存在的交点看不见, 不选中
+            p->setSelected(true);
+            selectedObjs_.insert(p->getHandle());
+        }
+    }
+    if (!points.empty()) {
+        loadInCache();
+    }
+    update();
+}
+
+void Canvas::setLayerVisible(int layer, bool visible) {
+    invalidateFrame();
+    LayerSet& layers = table_.layers();
+    if (layer < 0 || layer >= layers.size() || layers.isVisible(layer) == visible) {
+        return;
+    }
+    if (recorder_) {
+        recorder_->recordLayerVisible(layer, visible);
+    }
+    layers.setVisible(layer, visible);
+    hitTester_.layerChanged(layer);
+    if (!visible) {
+        // 看不见的对象不能留在选择里, 否则还会被删除或拖动
+        for (auto it = selectedObjs_.begin(); it != selectedObjs_.end();) {
+            GeometricObject* obj = table_.get(*it);
+            if (!obj || obj->getLayer() == layer) {
+                if (obj) {
+                    obj->setSelected(false);
+                }
+                it = selectedObjs_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        operationSelections_.erase(std::remove_if(operationSelections_.begin(), operationSelections_.end(),
+                                                  [layer](GeometricObject* obj) { return obj->getLayer() == layer; }),
+                                   operationSelections_.end());
+    }
+    saved_ = false;
+    update();
+}
+
+void Canvas::useLayer(const QString& name) {
+    invalidateFrame();
+    if (recorder_) {
+        recorder_->record(InteractionRecorder::UseLayer, name);
+    }
+    LayerSet& layers = table_.layers();
+    int layer = layers.find(name);
+    if (layer < 0) {
+        layer = layers.add(name);
+        if (layer < 0) {
+            warn("警告", "图层数量已达上限");
+            return;
+        }
+    }
+    layers.setCurrent(layer);
+    if (!layers.isVisible(layer)) {
+        layers.setVisible(layer, true);
+        hitTester_.layerChanged(layer);
+    }
+    for (auto obj : selection()) {
+        obj->setLayer(layer);
+    }
+    saved_ = false;
+    update();
+}
+
+bool Canvas::labelTaken(const QString& label, const GeometricObject* except) const {
+    // 索引里只有文档中的对象, 只存在于撤销记录中的对象的标签可以再用
+    GeometricObject* owner = table_.labels().find(label);
+    return owner && owner != except;
+}
+
+bool Canvas::renameObject(GeometricObject* obj, const QString& label) {
+    if (!label.isEmpty() && labelTaken(label, obj)) {
+        warn("警告", "标签 " + label + " 已被其它对象使用");
+        return false;
+    }
+    obj->setLabel(label);
+    saved_ = false;
+    return true;
+}
+
+void Canvas::findByLabel(const QString& label) {
+    invalidateFrame();
+    if (recorder_) {
+        recorder_->record(InteractionRecorder::FindLabel, label);
+    }
+    clearSelections();
+    GeometricObject* obj = table_.labels().find(label);
+    if (obj && obj->isShown()) {
+        obj->setSelected(true);
+        selectedObjs_.insert(obj->getHandle());
+    }
+    update();
+}
+
+void Canvas::renameSelection(const QString& base) {
+    invalidateFrame();
+    if (recorder_) {
+        recorder_->record(InteractionRecorder::RenameSelection, base);
+    }
+    std::vector<GeometricObject*> targets;
+    for (auto obj : objects_) {
+        if (obj->isSelected()) {
+            targets.push_back(obj);
+        }
+    }
+    if (targets.empty()) {
+        return;
+    }
+    if (targets.size() == 1) {
+        renameObject(targets.front(), base);
+        update();
+        return;
+    }
+    // 先把旧标签都去掉, 选中的对象之间互换名字时不会被当成冲突
+    for (auto obj : targets) {
+        obj->setLabel(QString());
+    }
+    int n = 1;
+    for (auto obj : targets) {
+        QString label = base + QString::number(n++);
+        while (labelTaken(label, obj)) {
+            label = base + QString::number(n++);
+        }
+        obj->setLabel(label);
+    }
+    saved_ = false;
+    update();
+}
+
+void Canvas::clearObjects(){
+    invalidateFrame();
+    for (auto obj : ownedObjects()){
         delete obj;
     }
+    snapshotRefs_.clear();
     objects_.clear();
     auxObjs_.clear();
+    structures_.clear();
     hoveredObjs_.clear();
     selectedObjs_.clear();
     initialPositions_.clear();
     operationSelections_.clear();
-    deletedObjs_.clear();
     draggedObj_ = nullptr;
-    cacheObj_ = std::vector<std::vector<GeometricObject*>>(maxCacheSize, std::vector<GeometricObject*>());
-    cacheDel_ = std::vector<std::vector<GeometricObject*>>(maxCacheSize, std::vector<GeometricObject*>());
-    cacheAux_ = std::vector<std::vector<GeometricObject*>>(maxCacheSize, std::vector<GeometricObject*>());
+    hitTester_.invalidate();
+    cacheObj_ = std::vector<std::vector<ObjectHandle>>(maxCacheSize, std::vector<ObjectHandle>());
+    cacheAux_ = std::vector<std::vector<ObjectHandle>>(maxCacheSize, std::vector<ObjectHandle>());
     cacheHidden_ = std::vector<std::vector<bool>>(maxCacheSize, std::vector<bool>());
     cachePos_ = std::vector<std::vector<QPointF>>(maxCacheSize, std::vector<QPointF>());
     maxUndoCount_ = 0;
     maxRedoCount_ = 0;
     currentCacheIndex_ = 0;
-    GetDefaultLable={
-        {ObjectType::Point, "A"},       // 点的默认标签
-        {ObjectType::Line, "line_1"},
-        {ObjectType::Lineo, "ray_1"},
-        {ObjectType::Lineoo, "segment_1"},
-        {ObjectType::Circle, "Circle1"}
-        };
-    GeometricObject::setCounter(0);
+    table_.labels().reset();
+    table_.layers().reset();
+    layerCaches_.clear();
+    table_.setNextIndex(0);
 }
 
 
@@ -1147,13 +2231,7 @@ GeometricObject* Canvas::findObjNear(const QPointF& pos) const {
     // 或者优先返回最上层的对象（如果你的对象有层级/绘制顺序）
     // 当前实现是返回第一个检测到的对象
 
-    std::vector<GeometricObject*> v = {};
-    for (auto it = objects_.rbegin(); it != objects_.rend(); ++it) { // 从后往前遍历，模拟点击最上层对象
-        GeometricObject* obj = *it;
-        if (obj && !obj->isHidden() && obj->isNear(pos)) {
-            v.push_back(obj);
-        }
-    }
+    std::vector<GeometricObject*> v = hitTester_.objectsNear(objects_, pos); // 从上到下排列, 模拟点击最上层对象
     for (auto obj : v){
         if (obj->getObjectType() == ObjectType::Point){
             return obj;
@@ -1166,13 +2244,7 @@ GeometricObject* Canvas::findObjNear(const QPointF& pos) const {
 }
 
 std::vector<GeometricObject*> Canvas::findObjectsNear(const QPointF& pos) const {
-    std::vector<GeometricObject*> v = {};
-    for (auto it = objects_.rbegin(); it != objects_.rend(); ++it) { // 从后往前遍历，模拟点击最上层对象
-        GeometricObject* obj = *it;
-        if (obj && !obj->isHidden() && obj->isNear(pos)) {
-            v.push_back(obj);
-        }
-    }
+    std::vector<GeometricObject*> v = hitTester_.objectsNear(objects_, pos);
     for (auto obj : v){
         if (obj->getObjectType() == ObjectType::Point){
             return std::vector<GeometricObject*>{};
@@ -1182,18 +2254,22 @@ std::vector<GeometricObject*> Canvas::findObjectsNear(const QPointF& pos) const
 }
 
 Point* Canvas::findPointNear(const QPointF& pos) const {
-    for (auto it = objects_.rbegin(); it != objects_.rend(); ++it) {
-        GeometricObject* obj = *it;
-        if (obj && !obj->isHidden() && obj->getObjectType() == ObjectType::Point && obj->isNear(pos)) {
-            return dynamic_cast<Point*>(obj);
+    return dynamic_cast<Point*>(hitTester_.pointNear(objects_, pos));
+}
+
+std::set<GeometricObject*> Canvas::selection() const {
+    std::set<GeometricObject*> selected;
+    for (auto handle : selectedObjs_) {
+        if (GeometricObject* obj = table_.get(handle)) {
+            selected.insert(obj);
         }
     }
-    return nullptr;
+    return selected;
 }
 
 void Canvas::clearSelections() {
-    for (auto* obj : selectedObjs_) { // 只需要遍历已选中的对象
-        if(obj) obj->setSelected(false);
+    for (auto obj : selection()) { // 只需要遍历已选中的对象
+        obj->setSelected(false);
     }
     selectedObjs_.clear();
     operationSelections_.clear();
@@ -1209,6 +2285,22 @@ void Canvas::clearTempObjects(){
 }
 
 void Canvas::flushObjects(){
+    if (lazyEvaluation_) {
+        // 只计算会被画出来或参与命中测试的对象, 它们依赖的对象由 evaluate 递归计算;
+        // 没有可见后代的隐藏对象, 辅助对象和隐藏图层里的对象保持上一次的结果, 图层重新显示时它们还是 dirty 的
+        // (不用 isShown: 不合法的对象要算过才知道现在是否合法)
+        const LayerSet& layers = table_.layers();
+        for (auto obj : objects_) {
+            if ((!obj->isHidden() && layers.isVisible(obj->getLayer())) || obj->getParents().empty()) {
+                obj->evaluate();
+            }
+        }
+        for (auto obj : tempObjects_) {
+            obj->evaluate();
+        }
+        reportErrors();
+        return;
+    }
     std::vector<GeometricObject*> v = objects_;
     for (auto obj : auxObjs_){
         v.push_back(obj);
@@ -1218,7 +2310,36 @@ void Canvas::flushObjects(){
     }
     std::sort(v.begin(), v.end(),
               [](GeometricObject* a, GeometricObject* b) {return a->getIndex() < b->getIndex();});
+    // 每个对象都重新算, 但只有真的变了的对象更新命中测试的索引和所在图层的缓存
     for (auto obj : v){
-        obj->flush();
+        obj->reflush();
+    }
+    reportErrors();
+}
+
+void Canvas::reportErrors(){
+    std::vector<QString> errors = table_.takeErrors();
+    if (errors.empty()) {
+        return;
+    }
+    QStringList lines;
+    for (const QString& error : errors) {
+        lines << error;
+    }
+    if (headless_) {
+        warn("警告", lines.join("\n"));
+        return;
+    }
+    // flushObjects 在 paintEvent 里调用, 对话框要等回到事件循环再弹
+    QMetaObject::invokeMethod(this, [this, lines]() {
+        QMessageBox::warning(this, "警告", lines.join("\n"));
+    }, Qt::QueuedConnection);
+}
+
+void Canvas::warn(const QString& title, const QString& message) {
+    if (headless_) {
+        qWarning().noquote() << title + ": " + message;
+        return;
     }
+    QMessageBox::warning(this, title, message);
 }
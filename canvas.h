@@ -8,35 +8,94 @@
 #include <QMenu>
 #include <QColorDialog>
 #include <QInputDialog>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QRegion>
+#include <QImage>
+#include <future>
+#include <memory>
 #include <vector>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include "geometricobject.h"
 #include "point.h"
 #include "operation.h"
 #include "customizedoperation.h"
+#include "toollibrary.h"
+#include "hittester.h"
+#include "structuretable.h"
+
+class InteractionRecorder;
+class TileRenderer;
 
 class Canvas : public QWidget {
     Q_OBJECT
 public:
     enum Mode { SelectionMode, CreatePointMode, OperationMode, DeletionMode };
+    // 工具栏上直接作用于选中对象的按钮
+    enum Command { DeleteCommand, HideCommand, ShowCommand, ClearCommand };
     explicit Canvas(QWidget* parent = nullptr);
     ~Canvas() override;
     void setMode(Mode newMode);
     void setOperation(const int index);
+    size_t operationCount() const { return operations.size(); }
+    // 执行工具栏命令并交给 recorder 记录; 快捷键直接调用 deleteObjects 等, 已经作为按键记录过
+    void runCommand(Command command);
     void deleteObjects();
     void hideObjects();
     void showObjects();
     void clearObjects();
+    // 选中的直线/射线/线段/圆/圆弧两两求交, 生成的所有交点只占一个撤销步骤 (Ctrl+I)
+    void intersectSelection();
+    // 按类别统计对象和撤销记录占用的内存 (Ctrl+M 显示)
+    QString memoryReport() const;
+    // 选中画布上标签为 label 的对象 (Ctrl+F)
+    void findByLabel(const QString& label);
+    // 选中的对象按画布上的顺序改名为 base1, base2, ..., 跳过其它对象已在用的标签; 只选中一个时就叫 base (Ctrl+R)
+    void renameSelection(const QString& base);
+    // 显示或隐藏整个图层, 不遍历对象; 隐藏的图层里的对象不能被选中 (Ctrl+1 ~ Ctrl+9 切换前九个图层)
+    void setLayerVisible(int layer, bool visible);
+    // 切换到名为 name 的图层 (没有时新建), 之后新建的对象放在这里; 选中的对象也移到这个图层 (Ctrl+G)
+    void useLayer(const QString& name);
     bool isSaved() { return saved_; }
     void loadFile(bool onStartup = false);
     bool saveFile();
+    bool exportFile();      // 把当前画面导出为 SVG 或 PDF
+    // 按需计算: 只 flush 可见对象和它们依赖的对象 (默认开启); 关闭时每帧重新计算所有对象
+    void setLazyEvaluation(bool lazy) { invalidateFrame(); lazyEvaluation_ = lazy; update(); }
+    // 流水线模式: 对象在 GUI 线程计算并录成一份绘制命令的快照 (QPicture), 后台线程只负责光栅化;
+    // paintEvent 只显示最近一次完成的画面
+    void setPipelined(bool pipelined);
+    // 分块绘制: 视口分成小块, 在线程池中并行光栅化后再合成到控件上
+    void setTiledRendering(bool tiled);
+    // 调用者接下来要修改对象: 当前画面和正在光栅化的画面都过期, 不等后台线程
+    void invalidateFrame();
     void setFilePath(QString path);
     void setOperationNames(std::set<QString> names);
     bool canCreateTool();
     std::pair<QString, int> createTool();
+    // 把自定义工具一次性应用到多组输入上, 整批只占一个撤销步骤
+    bool applyToolBatch(int index, const std::vector<std::vector<GeometricObject*>>& inputs);
+    // 把当前的自定义工具应用到选中的对象上 (Ctrl+B): 每种类型的对象按绘制顺序依次分给第 1, 2, ... 组输入,
+    // 例如输入是 (点, 点, 圆) 的工具, 选中 2N 个点和 N 个圆就应用 N 次
+    bool applyToolToSelection();
+    // 之后收到的输入事件都会交给 recorder 记录 (不获取所有权)
+    void setRecorder(InteractionRecorder* recorder) { recorder_ = recorder; }
+    // 离屏重放时没有人能关掉对话框: 计算错误和警告改为写到 stderr
+    void setHeadless(bool headless) { headless_ = headless; }
+    // 立即处理合并后尚未处理的鼠标移动 (通常由帧定时器调用, 重放时也需要手动调用)
+    void flushPendingInput();
+    // 读取工具库的索引并注册其中的工具, 返回注册成功的工具
+    std::vector<RegisteredTool> loadToolLibrary();
     std::vector<Operation*> customizeOperations = {};
 
+signals:
+    // 打开的文件中带有本地没有的自定义工具
+    void toolsRegistered(const std::vector<RegisteredTool>& tools);
+    // 给状态栏的一行提示 (例如 Ctrl+M 的内存统计)
+    void statusMessage(const QString& message);
+
 protected:
     void mousePressEvent(QMouseEvent* event) override;
     void mouseMoveEvent(QMouseEvent* event) override;
@@ -45,6 +104,7 @@ protected:
     void contextMenuEvent(QContextMenuEvent* event) override;
     void keyPressEvent(QKeyEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
+    void resizeEvent(QResizeEvent* event) override;
     std::vector<GeometricObject*> objects_; // 存储所有几何对象
     friend class MainWindow;
 
@@ -52,28 +112,76 @@ private:
     std::vector<Operation*> operations;     // 所有可能的 operation
     std::vector<GeometricObject*> tempObjects_;
     Mode currentMode = SelectionMode;       // 当前画布模式
-    std::vector<GeometricObject*> hoveredObjs_ = {}; // 当前鼠标悬停的对象
+    std::vector<ObjectHandle> hoveredObjs_ = {}; // 当前鼠标悬停的对象 (可能在撤销后被释放, 所以存句柄)
     GeometricObject* draggedObj_ = nullptr; // 当前拖拽的对象 (在你的代码中似乎主要通过 selectedObjs_ 和 initialPositions_ 实现拖拽)
-    std::set<GeometricObject*> selectedObjs_ = {}; // 当前选中的对象集合
+    std::set<ObjectHandle> selectedObjs_ = {}; // 当前选中的对象集合 (存句柄, 被释放的对象不会留下悬空指针)
     QPointF mousePos_;                      // 鼠标按下时的位置，用于计算拖动偏移
     std::map<GeometricObject*, QPointF> initialPositions_; // 拖动开始时选中对象的初始位置
     bool hasMoved_ = false;                 // 是否移动了
     Operation* currentOperation_ = nullptr;  // 当前进行的操作 (例如平移、旋转等)
     std::vector<GeometricObject*> operationSelections_; // 记录目前选择了哪些对象
     std::set<QString> operationNames_ = {};
-    std::vector<GeometricObject*> deletedObjs_ = {};
     std::vector<GeometricObject*> auxObjs_ = {};
-    CustomizedOperationCreator* operationCreator_;
+    CustomizedOperationCreator operationCreator_;
+    ToolLibrary toolLibrary_;
+    InteractionRecorder* recorder_ = nullptr;
+    bool headless_ = false;
+    std::vector<CustomizedOperation*> usedTools_ = {}; // 当前文件用到的自定义工具, 保存时嵌入文件
 
     QPointF multipleSelectionStartPos_;
     QPointF multipleSelectionEndPos_;
     bool isDuringMultipleSelection_;
     QString filePath_;
     bool saved_;
+    bool lazyEvaluation_ = true;
+
+    // 鼠标移动合并: 事件只记下最新位置, 每个显示帧最多处理一次
+    QTimer frameTimer_;
+    bool pendingMove_ = false;
+    QPointF pendingMovePos_;
+    Qt::MouseButtons pendingMoveButtons_;
+    // 各阶段耗时 (ns), 设置环境变量 GEOTHU_FRAME_STATS 后约每秒输出一次
+    struct FrameStats {
+        qint64 input = 0;
+        qint64 flush = 0;
+        qint64 draw = 0;
+        int frames = 0;
+        int overBudget = 0;     // 输入+计算+绘制超过一帧的帧数
+        QElapsedTimer window;
+    } frameStats_;
+
+    // 局部重绘: 改动前后对象所在的屏幕范围累积到 damage_, 之后只重绘这部分
+    QRegion damage_;
+
+    // 流水线模式: 后台线程只读取 startFrame 录下的 QPicture, 从不访问对象, 所以输入事件不用等它
+    bool pipelined_ = false;
+    std::future<QImage> frameJob_;
+    QImage frame_;
+    bool frameStale_ = true;
+    std::unique_ptr<TileRenderer> tileRenderer_; // 为空时在当前线程直接绘制
+    bool overview_ = false;     // 点太密时的概览模式: 不画标签, 普通的点画成像素点
+    // 拖动或缩放中用草稿质量绘制, 输入停下后由 idleTimer_ 触发一次完整质量的重绘
+    bool interacting_ = false;
+    QTimer idleTimer_;
+    mutable HitTester hitTester_{&table_}; // findObjNear 等查询用的索引, 变了的对象在下一次查询时更新
+    StructureTable structures_;             // 当前文档中对象的结构索引, 合并重复对象用
+    // 每个图层画好的画面, 按图层编号; 图层的 revision 和绘制选项都没变时直接贴上去
+    struct LayerCache {
+        QImage image;
+        quint64 revision = 0;
+        int options = -1;       // overview_ 和 interacting_, 它们决定了画法
+        bool shown = false;     // 上一帧是否贴过; 隐藏期间的变化没有记在 damage_ 里, 重新显示时要整体重画
+        QRect region;           // 这一帧要重画的范围
+    };
+    std::vector<LayerCache> layerCaches_;
 
-    std::vector<std::vector<GeometricObject*>> cacheObj_;
-    std::vector<std::vector<GeometricObject*>> cacheDel_;
-    std::vector<std::vector<GeometricObject*>> cacheAux_;
+    ObjectTable table_;             // 本文档的对象表; 每个对象构造时记下自己所在的表 (GeometricObject::table_)
+    std::vector<std::vector<ObjectHandle>> cacheObj_;
+    std::vector<std::vector<ObjectHandle>> cacheAux_;
+    // 对象的所有权: 每个对象出现在多少条撤销记录里 (cacheObj_ 或 cacheAux_);
+    // 删除的对象和撤销掉的新对象只留在记录里, 计数归零 (记录被覆盖或不能再重做) 时释放
+    std::unordered_map<ObjectHandle, int, ObjectHandleHash> snapshotRefs_;
+    size_t reclaimedObjects_ = 0;   // 累计释放的对象个数
     std::vector<std::vector<bool>> cacheHidden_;
     std::vector<std::vector<QPointF>> cachePos_;
     int currentCacheIndex_ = 0;
@@ -82,14 +190,46 @@ private:
 
     // --- 私有辅助函数 ---
     void updateHoverState(const QPointF& pos);                  // 更新鼠标悬停状态
+    void processMouseMove(const QPointF& pos, Qt::MouseButtons buttons);
+    void onFrame();
+    void reportFrameStats(qint64 frameNs);
+    void damage(GeometricObject* obj);                          // 把对象当前的范围加入 damage_
+    void damageWithDependents(const std::vector<GeometricObject*>& roots);
+    void updateObject(GeometricObject* obj);                    // 只重绘这个对象 (以及之前累积的范围)
+    void repaintDamage();
+    qint64 drawScene(QPainter* painter, const QRect& viewport, const QRect& dirty); // 返回 flush 的耗时 (ns)
+    qint64 startFrame();                    // 录下这一帧交给后台线程光栅化, 返回 flush 的耗时 (ns)
+    void takeFrame();                       // 后台线程光栅化完成时取走画面, 过期的丢掉
+    void updateLevelOfDetail(const QRect& viewport);
+    void beginInteraction();
+    void onIdle();
+    static bool isSubPixel(const GeometricObject* obj);
+    void onFrameReady();
     GeometricObject* findObjNear(const QPointF& pos) const;     // 查找指定位置附近的对象
     std::vector<GeometricObject*> findObjectsNear(const QPointF& pos) const;
     Point* findPointNear(const QPointF& pos) const;           // 查找指定位置附近的点对象
     void clearSelections();                                     // 清除所有对象的选中状态
+    std::set<GeometricObject*> selection() const;               // 选中的对象中还存在的那些
+    bool labelTaken(const QString& label, const GeometricObject* except) const; // 画布上除 except 外是否有对象叫 label
+    bool renameObject(GeometricObject* obj, const QString& label); // 标签已被占用时提示并返回 false
     void clearTempObjects();
+    void markToolUsed(Operation* operation);
+    // 自定义工具的执行计划损坏时提示并返回 false, 不构造任何对象
+    bool checkTool(Operation* operation);
+    // 合并新构造的对象中重复的辅助对象和同一批里的重复对象 (见 StructureTable::intern), 返回需要加入画布的对象
+    std::vector<GeometricObject*> mergeDuplicates(const std::vector<GeometricObject*>& created);
     void flushObjects();
+    // 把 flush 时记下的错误 (ObjectTable::reportError) 放到界面线程里弹出
+    void reportErrors();
+    void warn(const QString& title, const QString& message);   // 弹出警告框, headless_ 时写到 stderr
     GeometricObject* automaticIntersection(const QPointF& pos);
     void loadInCache();
+    void restoreCache();                    // 撤销和重做: 恢复到 currentCacheIndex_ 的记录
+    void retainSnapshot(int slot);
+    void releaseSnapshot(int slot, std::vector<ObjectHandle>& unreferenced);
+    void reclaim(const std::vector<ObjectHandle>& unreferenced);
+    void dropStaleAux();
+    std::vector<GeometricObject*> ownedObjects() const;    // 画布拥有的所有对象 (不含预览对象), 不重复
     void undo();
     void redo();
 };
@@ -3,13 +3,13 @@
 #include <QBrush>
 #include <QPainter>
 #include <cmath> // For std::pow, std::sqrt
+#include <algorithm>
 #include <QMessageBox>
 #include "point.h"
 #include "lineoo.h"
 #include "calculator.h"
 // 初始化全局默认值 (如果需要，这些通常在主程序或特定初始化函数中完成，
 // 但这里作为示例，假设你需要在objecttype.cpp或类似地方添加Circle的默认值)
-// extern std::map<ObjectType, QString> GetDefaultLable;
 // extern std::map<ObjectType, QColor> GetDefaultColor;
 // extern std::map<ObjectType, double> GetDefaultSize;
 // extern std::map<ObjectType, int> GetDefaultShape;
@@ -17,7 +17,7 @@
 
 Qt::PenStyle Circle::getPenStyle() const {
     // 将整数值转换为 Qt::PenStyle
-    switch (shape_) {
+    switch (getShape()) {
     case 0: // Solid
         return Qt::SolidLine;
     case 1: // Dash
@@ -30,7 +30,7 @@ Qt::PenStyle Circle::getPenStyle() const {
 }
 Qt::PenStyle Arc::getPenStyle() const {
     // 将整数值转换为 Qt::PenStyle
-    switch (shape_) {
+    switch (getShape()) {
     case 0: // Solid
         return Qt::SolidLine;
     case 1: // Dash
@@ -43,40 +43,145 @@ Qt::PenStyle Arc::getPenStyle() const {
 }
 
 Circle::Circle(const std::vector<GeometricObject*>& parents, const int& generation, bool isTemp, bool aux)
-    : GeometricObject(ObjectName::Circle, aux){
+    : GeometricObject(tableOf(parents), ObjectName::Circle, aux){
     for(auto iter: parents){
         addParent(iter);
     }
     generation_=generation;
     if (!isTemp and !aux) {
-        GetDefaultLable[ObjectType::Circle]=nextLineLable(GetDefaultLable[ObjectType::Circle]);
+        takeDefaultLabel();
     }
 }
 
 Arc::Arc(const std::vector<GeometricObject*>& parents, const int& generation, bool isTemp, bool aux)
-    : GeometricObject(ObjectName::Arc, aux){
+    : GeometricObject(tableOf(parents), ObjectName::Arc, aux){
     for(auto iter: parents){
         addParent(iter);
     }
     generation_=generation;
     if (!isTemp and !aux) {
-        GetDefaultLable[ObjectType::Arc]=nextLineLable(GetDefaultLable[ObjectType::Arc]);
+        takeDefaultLabel();
     }
 }
 
+namespace {
+
+// 超过这个半径时不再交给 QPainter::drawArc, 而是自己按误差生成折线
+const double HugeRadius = 1e4;
+
+// 角度都是数学角度 (y 轴向上), 和 getAngles() 一致
+QPointF pointOnCircle(const QPointF& center, double radius, double t) {
+    return QPointF(center.x() + radius * std::cos(t), center.y() - radius * std::sin(t));
+}
+
+// 圆弧 [start, start+span] 中落在 bounds 内的部分, 返回若干 (起始角, 跨度)
+// 交点用 atan2 求, 半径很大时也不会因为 acos/asin 在 ±1 附近的误差而错位
+std::vector<std::pair<double, double>> visibleSpans(const QPointF& center, double radius,
+                                                    double start, double span, const QRectF& bounds) {
+    std::vector<double> cuts = {0, span};
+    auto cut = [&](double t) {
+        double offset = std::fmod(t - start, 2 * PI);
+        if (offset < 0) {
+            offset += 2 * PI;
+        }
+        if (offset < span) {
+            cuts.push_back(offset);
+        }
+    };
+    for (double x : {bounds.left(), bounds.right()}) {
+        double dx = x - center.x();
+        if (std::abs(dx) <= radius) {
+            double dy = std::sqrt((radius - dx) * (radius + dx));
+            cut(std::atan2(dy, dx));
+            cut(std::atan2(-dy, dx));
+        }
+    }
+    for (double y : {bounds.top(), bounds.bottom()}) {
+        double dy = center.y() - y;
+        if (std::abs(dy) <= radius) {
+            double dx = std::sqrt((radius - dy) * (radius + dy));
+            cut(std::atan2(dy, dx));
+            cut(std::atan2(dy, -dx));
+        }
+    }
+    std::sort(cuts.begin(), cuts.end());
+    std::vector<std::pair<double, double>> spans;
+    for (size_t i = 0; i + 1 < cuts.size(); ++i) {
+        double from = cuts[i], to = cuts[i + 1];
+        if (to <= from || !bounds.contains(pointOnCircle(center, radius, start + (from + to) / 2))) {
+            continue;
+        }
+        if (!spans.empty() && spans.back().first + spans.back().second >= start + from) {
+            spans.back().second = start + to - spans.back().first;
+        } else {
+            spans.push_back({start + from, to - from});
+        }
+    }
+    return spans;
+}
+
+// 只画圆弧在 bounds 内的部分: 屏幕上几乎是直线的段画成线段, 半径很大或草稿质量时画成折线,
+// 否则交给 drawArc. 每段折线的弓高不超过容差, 所以代价只和可见部分的长度有关, 和半径无关
+void strokeArc(QPainter* painter, const QPointF& center, double radius, double start, double span,
+               const QRectF& bounds) {
+    QRectF rect(center.x() - radius, center.y() - radius, radius * 2, radius * 2);
+    if (!renderOptions.draft && bounds.contains(rect)) {
+        if (span >= 2 * PI) {
+            painter->drawEllipse(center, radius, radius);
+        } else {
+            painter->drawArc(rect, qRound(start * 180 / PI * 16), qRound(span * 180 / PI * 16));
+        }
+        return;
+    }
+    const double tolerance = renderOptions.draft ? 1.0 : 0.25;
+    for (auto [from, length] : visibleSpans(center, radius, start, span, bounds)) {
+        double sagitta = 2 * radius * std::pow(std::sin(length / 4), 2);
+        if (sagitta < tolerance) {
+            painter->drawLine(pointOnCircle(center, radius, from), pointOnCircle(center, radius, from + length));
+        } else if (renderOptions.draft || radius > HugeRadius) {
+            double step = 4 * std::asin(std::min(1.0, std::sqrt(tolerance / (2 * radius))));
+            int n = std::max(int(std::ceil(length / step)), int(std::ceil(8 * length / (2 * PI))));
+            QPolygonF polygon;
+            polygon.reserve(n + 1);
+            for (int i = 0; i <= n; ++i) {
+                polygon << pointOnCircle(center, radius, from + length * i / n);
+            }
+            painter->drawPolyline(polygon);
+        } else {
+            painter->drawArc(rect, qRound(from * 180 / PI * 16), qRound(length * 180 / PI * 16));
+        }
+    }
+}
+
+// 圆的线条 (外接正方形扩展线宽后为 stroke) 在 viewport 内可能画到的范围;
+// 圆完全在 viewport 外或 viewport 完全在圆内部时为空
+QRectF visibleStroke(const QRectF& stroke, const QPointF& center, double radius, const QRectF& viewport) {
+    if (viewport.contains(stroke)) {
+        return stroke;
+    }
+    double pad = (stroke.width() - 2 * radius) / 2;
+    QRectF bounds = viewport.adjusted(-pad, -pad, pad, pad);
+    if (visibleSpans(center, radius, 0, 2 * PI, bounds).empty()) {
+        return QRectF();
+    }
+    return stroke & bounds;
+}
+
+} // namespace
+
 void Circle::draw(QPainter* painter) const {
     if (!isShown()) return;
 
     // 获取圆心和半径
     auto points = getTwoPoints();
     QPointF center = points.first;
-    long double radius = QLineF(points.first, points.second).length();
+    Real radius = QLineF(points.first, points.second).length();
 
     QPen pen;
-    long double add = ((int)hovered_) * HOVER_ADD_WIDTH;
+    Real add = ((int)drawsHovered()) * HOVER_ADD_WIDTH;
 
     // 如果被选中，先绘制一个较宽的选中效果
-    if (selected_) {
+    if (drawsSelected() && !renderOptions.draft) {
         QColor selectcolor = getColor().lighter(250);
         selectcolor.setAlpha(128);
         pen.setColor(selectcolor);
@@ -84,7 +189,7 @@ void Circle::draw(QPainter* painter) const {
         pen.setStyle(Qt::SolidLine);
         painter->setPen(pen);
 
-        painter->drawEllipse(center, radius, radius);
+        strokeArc(painter, center, radius, 0, 2 * PI, strokeRect(paintableRect(painter)));
 
     }
 
@@ -96,13 +201,13 @@ void Circle::draw(QPainter* painter) const {
 
     // 根据圆的类型绘制不同形状
 
-        painter->drawEllipse(center, radius, radius);
+        strokeArc(painter, center, radius, 0, 2 * PI, strokeRect(paintableRect(painter)));
         // 添加标签绘制（如果有）
-        if (!labelhidden_) {
+        if (!islablehidden() && renderOptions.labels) {
             painter->setPen(Qt::black);
             painter->drawText(center.x() + radius + 6,
                               center.y() - 6,
-                              label_);
+                              getLabel());
         }
 
 }
@@ -110,26 +215,21 @@ void Arc::draw(QPainter* painter) const {
 
     if (!isShown()) return;
 
-    qDebug()<<"theta(p0-p1)="<<(double)Theta(getTwoPoints().first-getTwoPoints().second);
-
     // 获取圆心和半径
     auto points = getTwoPoints();
     QPointF center = points.first;
-    long double radius = QLineF(points.first, points.second).length();
-    std::pair<long double,long double> Angles = getAngles();
-    qDebug()<<"A= "<<parents_[0]->position()<<" B= "<<parents_[1]->position();
-    qDebug()<<"Angles= [ "<<(double)Angles.first<<","<<(double)Angles.second<<" ]";
+    Real radius = QLineF(points.first, points.second).length();
+    std::pair<Real,Real> Angles = getAngles();
 
     int startAngleQt = (Angles.first) * 180 / PI * 16;
     int spanAngleQt = (Angles.second - Angles.first) * 180 / PI * 16;
     if(spanAngleQt<0){ spanAngleQt += 360*16; }
     if(spanAngleQt>=360*16){ spanAngleQt -= 360*16; }
-    QRectF rect(center.x() - radius, center.y() - radius, radius * 2, radius * 2);
     QPen pen;
-    long double add = ((int)hovered_) * HOVER_ADD_WIDTH;
+    Real add = ((int)drawsHovered()) * HOVER_ADD_WIDTH;
 
     // 如果被选中，先绘制一个较宽的选中效果
-    if (selected_) {
+    if (drawsSelected() && !renderOptions.draft) {
         QColor selectcolor = getColor().lighter(250);
         selectcolor.setAlpha(128);
         pen.setColor(selectcolor);
@@ -137,7 +237,8 @@ void Arc::draw(QPainter* painter) const {
         pen.setStyle(Qt::SolidLine);
         painter->setPen(pen);
 
-        painter->drawArc(rect, startAngleQt, spanAngleQt);
+        strokeArc(painter, center, radius, startAngleQt / 16.0 * PI / 180, spanAngleQt / 16.0 * PI / 180,
+                  strokeRect(paintableRect(painter)));
     }
 
     // 设置正常绘制的画笔
@@ -148,13 +249,14 @@ void Arc::draw(QPainter* painter) const {
 
     // 根据圆的类型绘制不同形状
 
-    painter->drawArc(rect, startAngleQt, spanAngleQt);
+    strokeArc(painter, center, radius, startAngleQt / 16.0 * PI / 180, spanAngleQt / 16.0 * PI / 180,
+              strokeRect(paintableRect(painter)));
     // 添加标签绘制（如果有）
-    if (!labelhidden_) {
+    if (!islablehidden() && renderOptions.labels) {
         painter->setPen(Qt::black);
         painter->drawText(center.x() + radius*cos(startAngleQt+16*10) + 6,
                           center.y() + radius*sin(startAngleQt+16*10)- 6,
-                          label_);
+                          getLabel());
     }
 
 }
@@ -162,119 +264,161 @@ void Arc::draw(QPainter* painter) const {
 
 bool Circle::isNear(const QPointF& pos) const {
     if (!isShown()) return false;
-    return (abs(len(pos-position())-len(getTwoPoints()))<getSize()+1e-2);
+    return (abs(len(pos-position())-derived_.length)<getSize()+1e-2);
 }
 
 bool Arc::isNear(const QPointF& pos) const {
     if (!isShown()) return false;
 
-    auto [s,t] = getAngles();
-    long double theta=Theta(pos-position());
+    return (abs(len(pos-position())-derived_.length)<getSize()+1e-2) &&
+           containsDirection(pos);
+}
 
-    return (abs(len(pos-position())-len(getTwoPoints()))<getSize()+1e-2) &&
-           thetainst(theta,s,t);
+Circle::Kernel Circle::resolveKernel(){
+    switch(generation_){
+    case -4:
+        return expectParentNum(2) ? &Circle::flushCentralSymmetry : &Circle::flushInvalid;
+    case -3:
+        return expectParentNum(2) ? &Circle::flushAxialSymmetry : &Circle::flushInvalid;
+    case 0:
+        return expectParentNum(2) ? &Circle::flushCenterPoint : &Circle::flushInvalid;
+    case 1:
+        if(parents_.size()==2){
+            return expectParentType(1, ObjectType::Lineoo) ? &Circle::flushCenterSegment : &Circle::flushInvalid;
+        }
+        return expectParentNum(3) ? &Circle::flushCenterDistance : &Circle::flushInvalid;
+    case 2:
+        return expectParentNum(3) ? &Circle::flushThreePoints : &Circle::flushInvalid;
+    default:
+        reportError("Cirle的flush方法未实现!");
+        return &Circle::flushInvalid;
+    }
 }
 
 GeometricObject* Circle::flush(){
     position_.clear();
-    legal_ = true;
+    setLegal(true);
     for (auto iter : parents_) {
         if (!iter->isLegal()) {
-            legal_ = false;
+            setLegal(false);
             position_.push_back(QPointF());position_.push_back(QPointF(1, 1));
+            updateDerived(); // 和 flushInvalid 一样由占位的两个点算, 不留上一次合法时的结果
             return this;
         }
     }
-
-    switch(generation_){
-    case -4:{
-        position_.push_back(2*parents_[1]->position()-parents_[0]->getTwoPoints().first);
-        position_.push_back(2*parents_[1]->position()-parents_[0]->getTwoPoints().second);
-        return this;
-    }
-    case -3:{
-        position_.push_back(reflect(parents_[0]->getTwoPoints().first,parents_[1]->getTwoPoints()));
-        position_.push_back(reflect(parents_[0]->getTwoPoints().second,parents_[1]->getTwoPoints()));
-        return this;
-    }
-    case 0:{
-        position_.push_back(parents_[0]->position()),position_.push_back(parents_[1]->position());
-        return this;
-    }
-    case 1:{
-        if(parents_.size()==2){
-            position_.push_back(parents_[0]->position());
-            position_.push_back(parents_[0]->position()+QPointF(dynamic_cast<Lineoo*>(parents_[1])->length(),0));
-        }
-        else{
-            position_.push_back(parents_[0]->position());
-            position_.push_back(parents_[0]->position()+QPointF(len(parents_[1]->position()-parents_[2]->position()),0));
-        }
-        return this;
-    }
-    case 2:{
-        position_.push_back(calculateCircleCenter(parents_[0]->position(),parents_[1]->position(),parents_[2]->position())),position_.push_back(parents_[0]->position());
-        return this;
-    }
-    default:{
-        QMessageBox::warning(nullptr,"警告","Cirle的flush方法未实现!");
-        position_.push_back(QPointF());position_.push_back(QPointF(1, 1));
-        return this;
+    if (!kernel_) {
+        kernel_ = resolveKernel();
     }
+    (this->*kernel_)();
+    updateDerived();
+    return this;
+}
+
+void Circle::flushInvalid(){
+    setLegal(false);
+    position_.push_back(QPointF());position_.push_back(QPointF(1, 1));
+}
+
+void Circle::flushCenterPoint(){
+    position_.push_back(parents_[0]->position()),position_.push_back(parents_[1]->position());
+}
+
+void Circle::flushCenterSegment(){
+    position_.push_back(parents_[0]->position());
+    position_.push_back(parents_[0]->position()+QPointF(static_cast<Lineoo*>(parents_[1])->length(),0));
+}
+
+void Circle::flushCenterDistance(){
+    position_.push_back(parents_[0]->position());
+    position_.push_back(parents_[0]->position()+QPointF(len(parents_[1]->position()-parents_[2]->position()),0));
+}
+
+void Circle::flushThreePoints(){
+    position_.push_back(calculateCircleCenter(parents_[0]->position(),parents_[1]->position(),parents_[2]->position())),position_.push_back(parents_[0]->position());
+}
+
+Arc::Kernel Arc::resolveKernel(){
+    switch (generation_) {
+    case -4:
+        return expectParentNum(2) && expectParentType(0, ObjectType::Arc) ? &Arc::flushCentralSymmetryArc : &Arc::flushInvalid;
+    case -3:
+        return expectParentNum(2) && expectParentType(0, ObjectType::Arc) ? &Arc::flushAxialSymmetryArc : &Arc::flushInvalid;
+    case 0:
+        return expectParentNum(2) ? &Arc::flushSemicircle : &Arc::flushInvalid;
+    case 1:
+        return expectParentNum(3) ? &Arc::flushCenterTwoPoints : &Arc::flushInvalid;
+    default:
+        reportError("Cirle的flush方法未实现!");
+        return &Arc::flushInvalid;
     }
 }
+
 GeometricObject* Arc::flush(){
     position_.clear();
-    legal_ = true;
+    setLegal(true);
     for (auto iter : parents_) {
         if (!iter->isLegal()) {
-            legal_ = false;
+            setLegal(false);
             position_.push_back(QPointF());position_.push_back(QPointF(1, 1));
+            updateDerived(); // 和 flushInvalid 一样由占位的两个点算, 不留上一次合法时的结果
             return this;
         }
     }
-    /*
-    QPointF p= QPointF(1.0,0.01);
-    qDebug()<<(double)Theta(p);qDebug()<<(double)(Theta(p)/PI)<<" pi";*/
-
-    switch (generation_) {
-    case -4:{
-        position_.push_back(2*parents_[1]->position()-parents_[0]->getTwoPoints().first);
-        position_.push_back(2*parents_[1]->position()-parents_[0]->getTwoPoints().second);
-        Angles_.second=normalizeAngle(PI+dynamic_cast<Arc*>(parents_[0])->getAngles().second);
-        Angles_.first=normalizeAngle(PI+dynamic_cast<Arc*>(parents_[0])->getAngles().first);
-        return this;
-    }
-    case -3:{
-        position_.push_back(reflect(parents_[0]->getTwoPoints().first,parents_[1]->getTwoPoints()));
-        position_.push_back(reflect(parents_[0]->getTwoPoints().second,parents_[1]->getTwoPoints()));
-        long double reflectAngle = Theta(parents_[1]->getTwoPoints());
-        Angles_.second=normalizeAngle(normalizeAngle(2*reflectAngle-dynamic_cast<Arc*>(parents_[0])->getAngles().first));
-        Angles_.first=normalizeAngle(normalizeAngle(2*reflectAngle-dynamic_cast<Arc*>(parents_[0])->getAngles().second));
-        return this;
-    }
-    case 0:{
-        position_.push_back((parents_[0]->position()+parents_[1]->position())/2);
-        position_.push_back(parents_[0]->position());
-        Angles_.first= Theta(parents_[0]->position()-parents_[1]->position());
-        Angles_.second=(Angles_.first>= PI? Angles_.first- PI: Angles_.first+ PI);
-        return this;
-    }
-    case 1:{
-        position_.push_back(parents_[0]->position());
-        position_.push_back(parents_[1]->position());
-        Angles_.first = Theta(parents_[1]->position()-parents_[0]->position());
-        Angles_.second = Theta(parents_[2]->position()-parents_[0]->position());
-        return this;
+    if (!kernel_) {
+        kernel_ = resolveKernel();
     }
-    default:{
-        QMessageBox::warning(nullptr,"警告","Cirle的flush方法未实现!");
-        position_.push_back(QPointF());position_.push_back(QPointF(1, 1));
-        return this;
-    }
-    }
-}
-std::pair<long double, long double> Arc::getAngles() const{
+    (this->*kernel_)();
+    updateDerived();
+    derived_.span = AngleSubstract(Angles_.second, Angles_.first);
+    return this;
+}
+
+void Arc::flushInvalid(){
+    setLegal(false);
+    position_.push_back(QPointF());position_.push_back(QPointF(1, 1));
+}
+
+void Arc::flushCentralSymmetryArc(){
+    flushCentralSymmetry();
+    auto angles = static_cast<Arc*>(parents_[0])->getAngles();
+    Angles_.second=normalizeAngle(PI+angles.second);
+    Angles_.first=normalizeAngle(PI+angles.first);
+    auto [from, to] = static_cast<Arc*>(parents_[0])->getDirections();
+    from_ = -from, to_ = -to;
+}
+
+void Arc::flushAxialSymmetryArc(){
+    flushAxialSymmetry();
+    Real reflectAngle = parents_[1]->derived().theta; // 和反方向只差 π, 2 倍后相同
+    auto angles = static_cast<Arc*>(parents_[0])->getAngles();
+    Angles_.second=normalizeAngle(normalizeAngle(2*reflectAngle-angles.first));
+    Angles_.first=normalizeAngle(normalizeAngle(2*reflectAngle-angles.second));
+    // 反射改变转向, 起点和终点互换
+    QPointF u = parents_[1]->derived().unit;
+    auto [from, to] = static_cast<Arc*>(parents_[0])->getDirections();
+    from_ = 2 * QPointF::dotProduct(to, u) * u - to;
+    to_ = 2 * QPointF::dotProduct(from, u) * u - from;
+}
+
+void Arc::flushSemicircle(){
+    position_.push_back((parents_[0]->position()+parents_[1]->position())/2);
+    position_.push_back(parents_[0]->position());
+    Angles_.first= Theta(parents_[0]->position()-parents_[1]->position());
+    Angles_.second=(Angles_.first>= PI? Angles_.first- PI: Angles_.first+ PI);
+    from_ = parents_[0]->position()-parents_[1]->position();
+    to_ = -from_;
+}
+
+void Arc::flushCenterTwoPoints(){
+    position_.push_back(parents_[0]->position());
+    position_.push_back(parents_[1]->position());
+    Angles_.first = Theta(parents_[1]->position()-parents_[0]->position());
+    Angles_.second = Theta(parents_[2]->position()-parents_[0]->position());
+    from_ = parents_[1]->position()-parents_[0]->position();
+    to_ = parents_[2]->position()-parents_[0]->position();
+}
+
+std::pair<Real, Real> Arc::getAngles() const{
     return Angles_;
 }
 QPointF Circle::position() const {
@@ -284,13 +428,11 @@ QPointF Arc::position() const {
     return getTwoPoints().first;
 }
 
-long double Circle::getRadius() const {
-    const auto& points = getTwoPoints();
-    return len(points.first - points.second);
+Real Circle::getRadius() const {
+    return derived_.length;
 }
-long double Arc::getRadius() const {
-    const auto& points = getTwoPoints();
-    return len(points.first - points.second);
+Real Arc::getRadius() const {
+    return derived_.length;
 }
 
 std::pair<const QPointF, const QPointF> Circle::getTwoPoints() const {
@@ -300,18 +442,26 @@ std::pair<const QPointF, const QPointF> Arc::getTwoPoints() const {
     return std::make_pair(position_[0],position_[1]);
 }
 
+QRectF Circle::boundingRect(const QRectF& viewport) const {
+    auto [center, p] = getTwoPoints();
+    double radius = QLineF(center, p).length();
+    QRectF rect(center.x() - radius, center.y() - radius, radius * 2, radius * 2);
+    return visibleStroke(strokeRect(rect), center, radius, viewport)
+        .united(labelRect(QPointF(center.x() + radius + 6, center.y() - 6)));
+}
+
 bool Circle::isTouchedByRectangle(const QPointF& start, const QPointF& end) const {
     auto p = getTwoPoints();
-    long double dist = QLineF(p.first, p.second).length();
-    long double x = p.first.x(), y = p.first.y();
-    std::vector<long double> v = {start.x(), end.y(), end.x(), start.y()};
-        std::vector<long double> w = {x, y};
-        long double minDist = 1e9L, maxDist = 0L;
+    Real dist = QLineF(p.first, p.second).length();
+    Real x = p.first.x(), y = p.first.y();
+    std::vector<Real> v = {start.x(), end.y(), end.x(), start.y()};
+        std::vector<Real> w = {x, y};
+        Real minDist = 1e9L, maxDist = 0L;
         for (int i = 0; i < 4; ++i){
                 maxDist = std::max(len(QPointF(v[2 * (i/2)], v[2 * (i%2) + 1])-p.first), maxDist);
             }
-        long double minX = std::min(std::abs(start.x() - x), std::abs(end.x() - x));
-        long double minY = std::min(std::abs(start.y() - y), std::abs(end.y() - y));
+        Real minX = std::min(std::abs(start.x() - x), std::abs(end.x() - x));
+        Real minY = std::min(std::abs(start.y() - y), std::abs(end.y() - y));
         if ((start.y() - y) * (end.y() - y) <= 0){
                 minDist = std::min(minDist, minX);
             } else{
@@ -327,16 +477,26 @@ bool Circle::isTouchedByRectangle(const QPointF& start, const QPointF& end) cons
     }
     return maxDist >= dist and minDist <= dist;
 }
+QRectF Arc::boundingRect(const QRectF& viewport) const {
+    // 按整个圆估计; 标签位置和 draw() 中的算法一致
+    auto [center, p] = getTwoPoints();
+    double radius = QLineF(center, p).length();
+    QRectF rect(center.x() - radius, center.y() - radius, radius * 2, radius * 2);
+    int startAngleQt = getAngles().first * 180 / PI * 16;
+    return visibleStroke(strokeRect(rect), center, radius, viewport).united(labelRect(QPointF(center.x() + radius*cos(startAngleQt+16*10) + 6,
+                                                     center.y() + radius*sin(startAngleQt+16*10) - 6)));
+}
+
 bool Arc::isTouchedByRectangle(const QPointF& start, const QPointF& end) const {
-    long double left = std::min(start.x(), end.x());
-    long double right = std::max(start.x(), end.x());
-    long double top = std::min(start.y(), end.y());
-    long double bottom = std::max(start.y(), end.y());
+    Real left = std::min(start.x(), end.x());
+    Real right = std::max(start.x(), end.x());
+    Real top = std::min(start.y(), end.y());
+    Real bottom = std::max(start.y(), end.y());
 
     // 3. 检查圆弧端点是否在矩形内
-    long double radius=len(getTwoPoints());
-    long double x = position().x() + radius * cos(Angles_.first);
-    long double y = position().y() - radius * sin(Angles_.first); // 注意y向下为正
+    Real radius=len(getTwoPoints());
+    Real x = position().x() + radius * cos(Angles_.first);
+    Real y = position().y() - radius * sin(Angles_.first); // 注意y向下为正
     if (x >= left && x <= right && y >= top && y <= bottom)
         return true;
     x = position().x() + radius * cos(Angles_.second);
@@ -360,10 +520,10 @@ bool Arc::isTouchedByRectangle(const QPointF& start, const QPointF& end) const {
         if(!inter.exist){
             continue;
         }
-        if(0<=inter.t[0] && inter.t[0]<=1 && thetainst(Theta(inter.p[0]-position()),Angles_.first,Angles_.second)){
+        if(0<=inter.t[0] && inter.t[0]<=1 && containsDirection(inter.p[0])){
             return true;
         }
-        if(0<=inter.t[1] && inter.t[1]<=1 && thetainst(Theta(inter.p[1]-position()),Angles_.first,Angles_.second)){
+        if(0<=inter.t[1] && inter.t[1]<=1 && containsDirection(inter.p[1])){
             return true;
         }
     }
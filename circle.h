@@ -6,6 +6,7 @@
 #include <QPointF>
 #include <cmath> // For std::sqrt in isNear
 #include "operation.h"
+#include "predicates.h"
 
 class Saveloadhelper;
 
@@ -21,9 +22,10 @@ public:
     bool isNear(const QPointF& pos) const override;
     QPointF position() const override; // 通常返回圆心
 
-    long double getRadius() const;
+    Real getRadius() const;
     GeometricObject* flush() override;
     virtual bool isTouchedByRectangle(const QPointF& start, const QPointF& end) const override;
+    QRectF boundingRect(const QRectF& viewport) const override;
 
     std::pair<const QPointF, const QPointF> getTwoPoints() const override;
 
@@ -31,6 +33,15 @@ protected:
 
     Qt::PenStyle getPenStyle() const;
 
+    // flush 的计算核心, 第一次 flush 时根据 generation_ 解析一次
+    typedef void (Circle::*Kernel)();
+    Kernel kernel_ = nullptr;
+    Kernel resolveKernel();
+    void flushInvalid();
+    void flushCenterPoint();
+    void flushCenterSegment();
+    void flushCenterDistance();
+    void flushThreePoints();
 };
 
 //Circle 的产生方式:
@@ -73,19 +84,34 @@ public:
     bool isNear(const QPointF& pos) const override;
     QPointF position() const override; // 返回圆心
 
-    long double getRadius() const;
+    Real getRadius() const;
     GeometricObject* flush() override;
     virtual bool isTouchedByRectangle(const QPointF& start, const QPointF& end) const override;
+    QRectF boundingRect(const QRectF& viewport) const override;
 
     std::pair<const QPointF, const QPointF> getTwoPoints() const override;//Arc的getTwoPoints保证second是弧的起点
 
-    std::pair<long double, long double> getAngles() const;
+    std::pair<Real, Real> getAngles() const;
+    // 圆心指向起点和终点的向量 (屏幕坐标, 不必是单位向量), 供 withinArc 判定, 不需要三角函数
+    std::pair<QPointF, QPointF> getDirections() const { return {from_, to_}; }
+    bool containsDirection(const QPointF& p) const { return withinArc(position(), from_, to_, p); }
 
     friend class Saveloadhelper;
 protected:
-    std::pair<long double,long double> Angles_;
+    std::pair<Real,Real> Angles_;
+    QPointF from_, to_;
     Qt::PenStyle getPenStyle() const;
 
+    // flush 的计算核心, 第一次 flush 时根据 generation_ 解析一次
+    typedef void (Arc::*Kernel)();
+    Kernel kernel_ = nullptr;
+    Kernel resolveKernel();
+    void flushInvalid();
+    void flushCentralSymmetryArc();
+    void flushAxialSymmetryArc();
+    void flushSemicircle();
+    void flushCenterTwoPoints();
+
 };
 //Arc产生方式
 //0:两点半圆, 1:弧心+弧起点+弧终点方向, 2:过三点的弧
@@ -5,6 +5,8 @@
 #include "lineoo.h"
 #include "circle.h"
 #include "measurement.h"
+#include "toollibrary.h"
+#include <unordered_map>
 
 std::set<GeometricObject*> ancestor(GeometricObject* obj){
     if (obj->getParents().empty()){
@@ -99,16 +101,6 @@ void traceBack(std::vector<GeometricObject*>& v, std::set<GeometricObject*> inpu
     }
 }
 
-template <typename T>
-int findIndex(const T& element, const std::vector<T>& vec) {
-    for (std::size_t i = 0; i < vec.size(); ++i) {
-        if (vec[i] == element) {
-            return static_cast<int>(i);  // Cast to match return type
-        }
-    }
-    return -1;
-}
-
 CustomizedOperation* CustomizedOperationCreator::apply(std::set<GeometricObject*> selectedObjs, QString name){
     CustomizedOperation* ret = new CustomizedOperation(name);
     std::set<GeometricObject*> input = getInput(selectedObjs);
@@ -123,13 +115,16 @@ CustomizedOperation* CustomizedOperationCreator::apply(std::set<GeometricObject*
         }
     }
     ret->inputType = permutations(inputType);
+    ret->signature = inputType;
 
-    std::vector<GeometricObject*> relatedObjs = {};
-    for (auto obj : input) {
-        relatedObjs.push_back(obj);
-    }
-    std::stable_sort(relatedObjs.begin(), relatedObjs.end(),
+    std::vector<GeometricObject*> inputObjs(input.begin(), input.end());
+    std::stable_sort(inputObjs.begin(), inputObjs.end(),
                      [](GeometricObject* a, GeometricObject* b) { return *a < *b; });
+    // 已经有槽位的对象 (输入和之前的步骤) 按句柄查槽位
+    std::unordered_map<ObjectHandle, int, ObjectHandleHash> relatedObjs;
+    for (auto obj : inputObjs) {
+        relatedObjs.emplace(obj->getHandle(), int(relatedObjs.size()));
+    }
     std::vector<GeometricObject*> objsToConstruct = {};
     for (auto obj : output) {
         traceBack(objsToConstruct, input, obj);
@@ -140,75 +135,230 @@ CustomizedOperation* CustomizedOperationCreator::apply(std::set<GeometricObject*
     // [ ([parents' indices], generation, objecttype, aux) ]
     std::vector<std::tuple<std::vector<int>, int, ObjectType, bool>> applyOrder = {};
     for (auto obj : objsToConstruct) {
-        std::vector<GeometricObject*> parents = obj->getParents();
+        const ObjectList& parents = obj->getParents();
         std::vector<int> indices = {};
         for (auto parent : parents){
-            int index = findIndex(parent, relatedObjs);
-            if (index == -1){
+            auto it = relatedObjs.find(parent->getHandle());
+            if (it == relatedObjs.end()){
                 qDebug() << "error!";
             }
-            indices.push_back(index);
+            indices.push_back(it == relatedObjs.end() ? -1 : it->second);
         }
         bool aux = (output.find(obj) == output.end());
         applyOrder.push_back({indices, obj->getGeneration(), obj->getObjectType(), aux});
-        relatedObjs.push_back(obj);
+        relatedObjs.emplace(obj->getHandle(), int(relatedObjs.size()));
     }
     ret->applyOrder = applyOrder;
+    ret->inputCount = input.size();
+    ret->compile();
 
     return ret;
 }
 
+namespace {
+
+GeometricObject* makePoint(const std::vector<GeometricObject*>& parents, int generation, bool aux){
+    return new Point(parents, generation, aux);
+}
+GeometricObject* makeLine(const std::vector<GeometricObject*>& parents, int generation, bool aux){
+    return new Line(parents, generation, false, aux);
+}
+GeometricObject* makeLineo(const std::vector<GeometricObject*>& parents, int generation, bool aux){
+    return new Lineo(parents, generation, false, aux);
+}
+GeometricObject* makeLineoo(const std::vector<GeometricObject*>& parents, int generation, bool aux){
+    return new Lineoo(parents, generation, false, aux);
+}
+GeometricObject* makeCircle(const std::vector<GeometricObject*>& parents, int generation, bool aux){
+    return new Circle(parents, generation, false, aux);
+}
+GeometricObject* makeArc(const std::vector<GeometricObject*>& parents, int generation, bool aux){
+    return new Arc(parents, generation, false, aux);
+}
+GeometricObject* makeMeasurement(const std::vector<GeometricObject*>& parents, int generation, bool aux){
+    return new Measurement(parents, generation, false, aux);
+}
+
+}
+
 CustomizedOperation::CustomizedOperation(QString name){
     operationName = name.toStdString();
 }
 
-std::set<GeometricObject*> CustomizedOperation::apply(std::vector<GeometricObject*> objs,
-                                                      QPointF position) const {
-    objsRelated.clear();
-    objsRelated = objs;
-    std::stable_sort(objsRelated.begin(), objsRelated.end(),
-                     [](GeometricObject* a, GeometricObject* b) { return *a < *b; });
-    std::set<GeometricObject*> ret = {};
+CustomizedOperation::CustomizedOperation(QString name, const std::vector<ObjectType>& signature,
+                                         const ToolLibrary* library, int entry)
+    : signature(signature), library(library), libraryEntry(entry), planLoaded(false) {
+    operationName = name.toStdString();
+    inputType = permutations(signature);
+    inputCount = signature.size();
+}
+
+void CustomizedOperation::ensurePlan() const {
+    if (planLoaded) {
+        return;
+    }
+    planLoaded = true;
+    // 执行计划是按需加载的缓存, 逻辑上不改变工具本身
+    CustomizedOperation* self = const_cast<CustomizedOperation*>(this);
+    if (!library || !library->loadPlan(libraryEntry, self)) {
+        qDebug() << "CustomizedOperation: failed to load" << QString::fromStdString(operationName);
+        if (planError.isEmpty()) {
+            planError = "the plan could not be read from the tool library";
+        }
+        self->plan.clear();
+    }
+}
+
+bool CustomizedOperation::samePlan(const CustomizedOperation& other) const {
+    ensurePlan();
+    other.ensurePlan();
+    return signature == other.signature && inputCount == other.inputCount && applyOrder == other.applyOrder;
+}
+
+bool CustomizedOperation::isUsable(QString* error) const {
+    ensurePlan();
+    if (error) {
+        *error = planError;
+    }
+    return planError.isEmpty();
+}
+
+void CustomizedOperation::writePlan(QDataStream& out) const {
+    ensurePlan();
+    out << qint32(inputCount) << qint32(applyOrder.size());
     for (auto& t : applyOrder) {
-        std::vector<int> indices;
-        std::vector<GeometricObject*> parents;
-        int generation;
-        ObjectType type;
+        const std::vector<int>& indices = std::get<0>(t);
+        out << QVector<qint32>(indices.begin(), indices.end()) << qint32(std::get<1>(t))
+            << qint32(std::get<2>(t)) << std::get<3>(t);
+    }
+}
+
+bool CustomizedOperation::readPlan(QDataStream& in) {
+    qint32 inputs, steps;
+    in >> inputs >> steps;
+    std::vector<std::tuple<std::vector<int>, int, ObjectType, bool>> order;
+    for (int i = 0; i < steps && in.status() == QDataStream::Ok; ++i) {
+        QVector<qint32> indices;
+        qint32 generation, type;
         bool aux;
-        GeometricObject* newObj = nullptr;
-        std::tie(indices, generation, type, aux) = t;
-        for (int i : indices) {
-            parents.push_back(objsRelated[i]);
-        }
+        in >> indices >> generation >> type >> aux;
+        order.emplace_back(std::vector<int>(indices.begin(), indices.end()), generation,
+                           static_cast<ObjectType>(type), aux);
+    }
+    if (in.status() != QDataStream::Ok) {
+        planError = "the plan is truncated";
+        return false;
+    }
+    planLoaded = true;
+    applyOrder = order;
+    inputCount = inputs;
+    return compile();
+}
+
+bool CustomizedOperation::compile(){
+    plan.clear();
+    plan.reserve(applyOrder.size());
+    planError.clear();
+    maxParentCount = 0;
+    size_t available = inputCount;
+    for (auto& t : applyOrder) {
+        PlanStep step;
+        ObjectType type;
+        std::tie(step.slots, step.generation, type, step.aux) = t;
         switch (type) {
-        case (ObjectType::Point):
-            newObj = new Point(parents, generation, aux);
-            break;
-        case (ObjectType::Line):
-            newObj = new Line(parents, generation, false, aux);
-            break;
-        case (ObjectType::Lineo):
-            newObj = new Lineo(parents, generation, false, aux);
-            break;
-        case (ObjectType::Lineoo):
-            newObj = new Lineoo(parents, generation, false, aux);
-            break;
-        case (ObjectType::Circle):
-            newObj = new Circle(parents, generation, false, aux);
-            break;
-        case (ObjectType::Arc):
-            newObj = new Arc(parents, generation, false, aux);
-            break;
-        case (ObjectType::Measurement):
-            newObj = new Measurement(parents, generation, false, aux);
-            break;
-        default:
-            break;
+        case (ObjectType::Point):       step.factory = makePoint; break;
+        case (ObjectType::Line):        step.factory = makeLine; break;
+        case (ObjectType::Lineo):       step.factory = makeLineo; break;
+        case (ObjectType::Lineoo):      step.factory = makeLineoo; break;
+        case (ObjectType::Circle):      step.factory = makeCircle; break;
+        case (ObjectType::Arc):         step.factory = makeArc; break;
+        case (ObjectType::Measurement): step.factory = makeMeasurement; break;
+        default:                        step.factory = nullptr; break;
+        }
+        int number = int(plan.size()) + 1;
+        if (!step.factory) {
+            planError = QString("step %1 has an unknown object type %2").arg(number).arg(int(type));
+        }
+        for (int i : step.slots) {
+            if (i < 0 || size_t(i) >= available) {
+                planError = QString("step %1 refers to a missing parent (slot %2)").arg(number).arg(i);
+            }
         }
-        newObj->flush();
-        objsRelated.push_back(newObj);
-        ret.insert(newObj);
+        if (!planError.isEmpty()) {
+            qDebug() << "CustomizedOperation: rejected" << QString::fromStdString(operationName) << planError;
+            plan.clear();
+            return false;
+        }
+        maxParentCount = std::max(maxParentCount, step.slots.size());
+        plan.push_back(step);
+        ++available;
+    }
+    return true;
+}
+
+void CustomizedOperation::construct(std::vector<GeometricObject*> objs,
+                                    std::vector<ObjectHandle>& slots,
+                                    std::vector<GeometricObject*>& created) const {
+    // 输入按 (类型, index) 排序, 与创建工具时 relatedObjs 的顺序一致
+    std::stable_sort(objs.begin(), objs.end(),
+                     [](GeometricObject* a, GeometricObject* b) { return *a < *b; });
+    if (objs.empty()) {
+        return;
+    }
+    ObjectTable* table = objs.front()->getTable();
+    slots.clear();
+    for (auto obj : objs) {
+        slots.push_back(obj->getHandle());
+    }
+    slots.resize(inputCount + plan.size());
+    std::vector<GeometricObject*> parents;
+    parents.reserve(maxParentCount);
+    size_t next = inputCount;
+    // 编译过的计划每一步都有构造函数, 父对象都在它之前
+    for (const PlanStep& step : plan) {
+        parents.clear();
+        for (int i : step.slots) {
+            parents.push_back(table->get(slots[i]));
+        }
+        GeometricObject* newObj = step.factory(parents, step.generation, step.aux);
+        created.push_back(newObj);
+        slots[next++] = newObj->getHandle();
+    }
+}
+
+std::set<GeometricObject*> CustomizedOperation::apply(std::vector<GeometricObject*> objs,
+                                                      QPointF position) const {
+    ensurePlan();
+    std::vector<ObjectHandle> slots;
+    std::vector<GeometricObject*> created;
+    created.reserve(plan.size());
+    construct(objs, slots, created);
+    // 所有对象都构造完之后再按构造顺序统一 flush, 父对象总是先于子对象
+    for (auto obj : created) {
+        obj->flush();
+    }
+    return std::set<GeometricObject*>(created.begin(), created.end());
+}
+
+std::vector<std::set<GeometricObject*>> CustomizedOperation::applyBatch(
+    const std::vector<std::vector<GeometricObject*>>& inputs) const {
+    ensurePlan();
+    std::vector<ObjectHandle> slots;
+    std::vector<GeometricObject*> created;
+    created.reserve(plan.size() * inputs.size());
+    std::vector<size_t> bounds = {0};
+    bounds.reserve(inputs.size() + 1);
+    for (const auto& objs : inputs) {
+        construct(objs, slots, created);
+        bounds.push_back(created.size());
+    }
+    for (auto obj : created) {
+        obj->flush();
+    }
+    std::vector<std::set<GeometricObject*>> ret;
+    ret.reserve(inputs.size());
+    for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+        ret.emplace_back(created.begin() + bounds[i], created.begin() + bounds[i + 1]);
     }
-    objsRelated.clear();
     return ret;
 }
@@ -3,19 +3,61 @@
 
 #include "operation.h"
 #include "geometricobject.h"
+#include <QDataStream>
+
+class ToolLibrary;
 
 class CustomizedOperation : public Operation {
 private:
     friend class CustomizedOperationCreator;
-    mutable std::vector<GeometricObject*> objsRelated;
 
     // [ ([parents' indices], generation, objecttype, aux) ]
     std::vector<std::tuple<std::vector<int>, int, ObjectType, bool>> applyOrder;
 
+    // 编译后的执行计划: 构造函数和父对象槽位在创建工具时就已经解析好
+    typedef GeometricObject* (*Factory)(const std::vector<GeometricObject*>& parents, int generation, bool aux);
+    struct PlanStep {
+        Factory factory;
+        std::vector<int> slots; // 父对象在槽位数组中的下标
+        int generation;
+        bool aux;
+    };
+    std::vector<PlanStep> plan;
+    size_t inputCount = 0;
+    size_t maxParentCount = 0;
+    std::vector<ObjectType> signature; // 输入对象的类型, inputType 是它的全排列
+
+    // 从工具库载入的工具在第一次使用时才读取执行计划
+    const ToolLibrary* library = nullptr;
+    int libraryEntry = -1;
+    mutable bool planLoaded = true;
+    mutable QString planError;  // 非空时计划不能用, 不构造任何对象
+    void ensurePlan() const;
+
+    // 任何一步的类型或父对象槽位不合法时整个计划作废, 否则依赖它的步骤会缺父对象
+    bool compile();
+    // 只构造对象, 不 flush; 新对象按构造顺序追加到 created 中
+    // slots 按计划的槽位存输入和已构造对象的句柄, 在输入所在文档的对象表里查找
+    void construct(std::vector<GeometricObject*> objs, std::vector<ObjectHandle>& slots,
+                   std::vector<GeometricObject*>& created) const;
+
 public:
     CustomizedOperation(QString name);
+    CustomizedOperation(QString name, const std::vector<ObjectType>& signature,
+                        const ToolLibrary* library, int entry);
+    const std::vector<ObjectType>& getSignature() const { return signature; }
+    void setName(const QString& name) { operationName = name.toStdString(); }
+    // 输入类型和执行计划都相同 (名字可以不同)
+    bool samePlan(const CustomizedOperation& other) const;
+    // 执行计划能否使用 (需要时先从工具库读入); 不能用时 error 里是原因
+    bool isUsable(QString* error = nullptr) const;
+    void writePlan(QDataStream& out) const;
+    bool readPlan(QDataStream& in);
     virtual std::set<GeometricObject*> apply(std::vector<GeometricObject*> objs,
                                              QPointF position = QPointF()) const override;
+    // 对 N 组输入一次性应用工具, 所有新对象在最后统一 flush 一遍
+    std::vector<std::set<GeometricObject*>> applyBatch(
+        const std::vector<std::vector<GeometricObject*>>& inputs) const;
 };
 
 class CustomizedOperationCreator {
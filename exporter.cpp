@@ -0,0 +1,183 @@
+#include "exporter.h"
+#include "line.h"
+#include "lineo.h"
+#include "circle.h"
+#include "measurement.h"
+#include "calculator.h"
+#include <QFile>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QPageSize>
+#include <QPageLayout>
+#include <QDebug>
+#include <cmath>
+
+namespace {
+
+QString num(double x) {
+    return QString::number(x, 'g', 10);
+}
+
+QString escaped(const QString& s) {
+    return s.toHtmlEscaped();
+}
+
+// 对应 Qt::DashLine 和 Qt::DotLine 的默认线型 (以线宽为单位)
+QString dashArray(int shape, double width) {
+    switch (shape) {
+    case LineStyle::Dashed:
+        return QString(" stroke-dasharray=\"%1,%2\"").arg(num(4 * width), num(2 * width));
+    case LineStyle::Dotted:
+        return QString(" stroke-dasharray=\"%1,%2\"").arg(num(width), num(2 * width));
+    default:
+        return QString();
+    }
+}
+
+QString stroke(const GeometricObject* obj) {
+    QString ret = QString(" stroke=\"%1\" stroke-width=\"%2\"").arg(obj->getColor().name(), num(obj->getSize()));
+    if (obj->getColor().alpha() != 255) {
+        ret += QString(" stroke-opacity=\"%1\"").arg(num(obj->getColor().alphaF()));
+    }
+    return ret + dashArray(obj->getShape(), obj->getSize());
+}
+
+void label(QTextStream& out, double x, double y, const QString& text) {
+    out << "<text x=\"" << num(x) << "\" y=\"" << num(y) << "\">" << escaped(text) << "</text>\n";
+}
+
+} // namespace
+
+Exporter::Exporter(const QSizeF& size) : bounds_(QPointF(0, 0), size) {}
+
+std::vector<GeometricObject*> Exporter::drawOrder(const std::vector<GeometricObject*>& objects) {
+    std::vector<GeometricObject*> ret;
+    for (auto obj : objects) {
+        if (obj->isShown() && obj->getObjectType() != ObjectType::Point) {
+            ret.push_back(obj);
+        }
+    }
+    for (auto obj : objects) {
+        if (obj->isShown() && obj->getObjectType() == ObjectType::Point) {
+            ret.push_back(obj);
+        }
+    }
+    return ret;
+}
+
+void Exporter::writeSvgObject(QTextStream& out, GeometricObject* obj) const {
+    switch (obj->getObjectType()) {
+    case ObjectType::Point: {
+        QPointF p = obj->position();
+        out << "<circle cx=\"" << num(p.x()) << "\" cy=\"" << num(p.y()) << "\" r=\"" << num(obj->getSize())
+            << "\" fill=\"" << obj->getColor().name() << "\" stroke=\"black\"/>\n";
+        if (!obj->islablehidden()) {
+            label(out, p.x() + 6, p.y() - 6, obj->getLabel());
+        }
+        break;
+    }
+    case ObjectType::Line:
+    case ObjectType::Lineo:
+    case ObjectType::Lineoo: {
+        auto [p1, p2] = obj->getTwoPoints();
+        QPointF a = p1, b = p2;
+        if (obj->getObjectType() == ObjectType::Line) {
+            if (!clipExtendedLine(bounds_, p1, p2, a, b)) {
+                return;
+            }
+        } else if (obj->getObjectType() == ObjectType::Lineo) {
+            if (!clipExtendedLineo(bounds_, p1, p2, b)) {
+                return;
+            }
+        }
+        out << "<line x1=\"" << num(a.x()) << "\" y1=\"" << num(a.y()) << "\" x2=\"" << num(b.x())
+            << "\" y2=\"" << num(b.y()) << "\"" << stroke(obj) << "/>\n";
+        if (!obj->islablehidden() && obj->getObjectType() != ObjectType::Lineo) {
+            label(out, (p1.x() + p2.x()) / 2 + 6, (p1.y() + p2.y()) / 2 - 6, obj->getLabel());
+        }
+        break;
+    }
+    case ObjectType::Circle: {
+        QPointF center = obj->position();
+        double r = obj->derived().length;
+        out << "<circle cx=\"" << num(center.x()) << "\" cy=\"" << num(center.y()) << "\" r=\"" << num(r)
+            << "\" fill=\"none\"" << stroke(obj) << "/>\n";
+        if (!obj->islablehidden()) {
+            label(out, center.x() + r + 6, center.y() - 6, obj->getLabel());
+        }
+        break;
+    }
+    case ObjectType::Arc: {
+        Arc* arc = static_cast<Arc*>(obj);
+        QPointF center = arc->position();
+        double r = arc->getRadius();
+        auto [s, t] = arc->getAngles();
+        double span = normalizeAngle(t - s);
+        // 角度是 y 轴向上的数学角度; 屏幕上逆时针对应 SVG 的 sweep-flag = 0
+        QPointF from(center.x() + r * std::cos(s), center.y() - r * std::sin(s));
+        QPointF to(center.x() + r * std::cos(t), center.y() - r * std::sin(t));
+        out << "<path d=\"M " << num(from.x()) << ' ' << num(from.y()) << " A " << num(r) << ' ' << num(r)
+            << " 0 " << (span > PI ? 1 : 0) << " 0 " << num(to.x()) << ' ' << num(to.y())
+            << "\" fill=\"none\"" << stroke(obj) << "/>\n";
+        if (!arc->islablehidden()) {
+            // 和 Arc::draw 放在同一个位置 (它的角度以 1/16 度为单位)
+            int startAngleQt = s * 180 / PI * 16;
+            label(out, center.x() + r * std::cos(startAngleQt + 16 * 10) + 6,
+                  center.y() + r * std::sin(startAngleQt + 16 * 10) - 6, arc->getLabel());
+        }
+        break;
+    }
+    case ObjectType::Measurement: {
+        QPointF p = obj->position();
+        out << "<text x=\"" << num(p.x()) << "\" y=\"" << num(p.y())
+            << "\" font-family=\"Arial\" font-size=\"16pt\">"
+            << escaped(static_cast<Measurement*>(obj)->getText()) << "</text>\n";
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+bool Exporter::writeSvg(const std::vector<GeometricObject*>& objects, const QString& path) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "Exporter: cannot write" << path;
+        return false;
+    }
+    QTextStream out(&file);
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << num(bounds_.width()) << "\" height=\""
+        << num(bounds_.height()) << "\" viewBox=\"0 0 " << num(bounds_.width()) << ' '
+        << num(bounds_.height()) << "\">\n"
+        << "<g font-family=\"sans-serif\" font-size=\"12\" stroke-linecap=\"round\">\n";
+    for (auto obj : drawOrder(objects)) {
+        writeSvgObject(out, obj);
+    }
+    out << "</g>\n</svg>\n";
+    out.flush();
+    return out.status() == QTextStream::Ok && file.error() == QFile::NoError;
+}
+
+bool Exporter::writePdf(const std::vector<GeometricObject*>& objects, const QString& path) const {
+    QPdfWriter writer(path);
+    // 72 dpi 时一个设备像素就是一个 point, draw() 中的 viewport 正好是整个页面
+    writer.setResolution(72);
+    writer.setPageLayout(QPageLayout(QPageSize(bounds_.size(), QPageSize::Point),
+                                     QPageLayout::Portrait, QMarginsF()));
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        qWarning() << "Exporter: cannot write" << path;
+        return false;
+    }
+    painter.setRenderHint(QPainter::Antialiasing);
+    // 导出总是完整的细节, 不受画布当前的概览模式影响; 导出的是图形本身, 不带选中和悬停效果
+    RenderOptions options = renderOptions;
+    renderOptions = RenderOptions();
+    renderOptions.highlights = false;
+    for (auto obj : drawOrder(objects)) {
+        obj->draw(&painter);
+    }
+    renderOptions = options;
+    return painter.end();
+}
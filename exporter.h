@@ -0,0 +1,27 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <QRectF>
+#include <QString>
+#include <QTextStream>
+#include <vector>
+#include "geometricobject.h"
+
+// 把已经计算好的几何对象直接导出为矢量文件, 不经过 Canvas 的绘制
+// SVG 边遍历边写入文件; PDF 由 QPdfWriter 逐个对象调用 draw()
+class Exporter {
+public:
+    explicit Exporter(const QSizeF& size);
+
+    bool writeSvg(const std::vector<GeometricObject*>& objects, const QString& path) const;
+    bool writePdf(const std::vector<GeometricObject*>& objects, const QString& path) const;
+
+private:
+    QRectF bounds_;
+
+    // 和 Canvas::paintEvent 一致: 先画非点对象, 再画点
+    static std::vector<GeometricObject*> drawOrder(const std::vector<GeometricObject*>& objects);
+    void writeSvgObject(QTextStream& out, GeometricObject* obj) const;
+};
+
+#endif // EXPORTER_H
@@ -2,16 +2,11 @@
 #define GEOMETRICOBJECT_CPP
 
 #include "geometricobject.h"
+#include "calculator.h"
+#include "lineoo.h"
+#include <QFontMetricsF>
 #include <qmessagebox.h>
-// 默认标签映射表
-std::map<ObjectType, QString> GetDefaultLable = {
-    {ObjectType::Point, "A"},       // 点的默认标签
-    {ObjectType::Line, "line_1"},
-    {ObjectType::Lineo, "ray_1"},
-    {ObjectType::Lineoo, "segment_1"},
-    {ObjectType::Circle, "Circle1"},
-    {ObjectType::Arc, "Arc1"}
-};
+RenderOptions renderOptions;
 
 // 默认颜色映射表
 std::map<ObjectType, QColor> GetDefaultColor = {
@@ -43,46 +38,40 @@ std::map<ObjectType, int> GetDefaultShape = {
     {ObjectType::Arc, LineStyle::Solid}
 };
 
-int GeometricObject::counter = 0;
-
-void GeometricObject::setCounter(int n) {
-    counter = n;
-}
-
-GeometricObject::GeometricObject(ObjectName name, bool aux):
-    position_(),
-    selected_(true),      // 默认选中状态 (注意：这里设置为 true，通常可能希望是 false)
-    hovered_(false),      // 默认悬停状态
-    legal_(true),         // 默认合法状态
-    hidden_(false),       // 默认隐藏状态
-    labelhidden_(true),       // 标签默认隐藏状态
-    name_(name),          // 对象类型名
-    label_(GetDefaultLable[name]),   // 使用映射表获取默认标签
-    color_(GetDefaultColor[name]),   // 使用映射表获取默认颜色
-    size_(GetDefaultSize[name]),     // 使用映射表获取默认大小
-    shape_(GetDefaultShape[name]),   // 使用映射表获取默认形状/线型
+GeometricObject::GeometricObject(ObjectTable* table, ObjectName name, bool aux):
+    table_(table),
     generation_(0),
-    aux_(aux),
-    index_(counter) {
+    name_(name),          // 对象类型名
+    label_(table_->labels().peek(name)),   // 这一类对象的下一个自动标签, 正式对象在子类构造函数里占用它
+    style_(table_->styles().defaultStyle(name)),   // 默认的颜色, 大小和线型, 缓存在样式表里
+    // 默认选中 (注意：通常可能希望是未选中), 合法, 需要计算; 标签默认隐藏
+    flags_(Selected | Legal | Dirty | LabelHidden),
+    layer_(quint8(table_->layers().current())) {
     if (name == ObjectName::Point){
-        labelhidden_ = false;
+        setFlag(LabelHidden, false);
     }
     if (aux){
-        hidden_ = true;
+        setFlag(Aux, true);
+        setFlag(Hidden, true);
     }
-    ++counter;
+    handle_ = table_->insert(this);
+    index_ = table_->takeIndex();
 }
 
 GeometricObject::~GeometricObject() {
+    table_->remove(handle_); // 之后这个对象的句柄都查不到它
+    if (flags_ & Named) {
+        table_->labels().unbind(label_, this);
+    }
     // 移除父子关系
-    std::vector<GeometricObject*> parents_copy = parents_; // 创建父对象列表的副本以安全迭代
+    ObjectList parents_copy = parents_; // 创建父对象列表的副本以安全迭代
     for (GeometricObject* p : parents_copy) {
         if (p) {
             p->removeChild(this); // 让父对象移除对当前对象的子对象引用
         }
     }
 
-    std::vector<GeometricObject*> children_copy = children_; // 创建子对象列表的副本以安全迭代
+    ObjectList children_copy = children_; // 创建子对象列表的副本以安全迭代
     for (GeometricObject* c : children_copy) {
         if (c) {
             c->removeParent(this); // 让子对象移除对当前对象的父对象引用
@@ -93,6 +82,111 @@ GeometricObject::~GeometricObject() {
     parents_.clear();   // 清空父对象列表
 }
 
+size_t GeometricObject::heapUsage() const {
+    // 列表只有超出内置容量时才在堆上; 标签和样式在对象表里, 由所有对象共用
+    size_t bytes = 0;
+    if (position_.capacity() > 2) {
+        bytes += position_.capacity() * sizeof(QPointF);
+    }
+    for (const ObjectList* list : {&parents_, &children_}) {
+        if (list->capacity() > 3) {
+            bytes += list->capacity() * sizeof(GeometricObject*);
+        }
+    }
+    return bytes;
+}
+
+void GeometricObject::markDirty() {
+    // 干净的对象的祖先一定都是干净的, 所以遇到已经标记过的对象就可以停下
+    if (flags_ & Dirty) {
+        return;
+    }
+    flags_ |= Dirty;
+    for (auto child : children_) {
+        child->markDirty();
+    }
+}
+
+GeometricObject* GeometricObject::evaluate() {
+    if (!(flags_ & Dirty)) {
+        return this;
+    }
+    for (auto parent : parents_) {
+        parent->evaluate();
+    }
+    flush();
+    table_->markChanged(handle_);   // 位置和合法性只在这里变, 命中测试只需要更新这个对象
+    table_->layers().touch(layer_); // 图层缓存也在算完以后才失效, markDirty 时还不知道会不会变
+    flags_ &= ~Dirty;
+    return this;
+}
+
+bool GeometricObject::reflush() {
+    SmallVector<QPointF, 2> before = position_;
+    quint8 legal = flags_ & Legal;
+    flush();
+    flags_ &= ~Dirty;
+    if (position_ == before && (flags_ & Legal) == legal) {
+        return false;
+    }
+    table_->markChanged(handle_);
+    table_->layers().touch(layer_);
+    return true;
+}
+
+void GeometricObject::flushCentralSymmetry() {
+    auto ppp = parents_[0]->getTwoPoints();
+    QPointF center = parents_[1]->position();
+    position_.push_back(2*center-ppp.first);
+    position_.push_back(2*center-ppp.second);
+}
+
+void GeometricObject::flushAxialSymmetry() {
+    auto ppp = parents_[0]->getTwoPoints();
+    auto axis = parents_[1]->getTwoPoints();
+    position_.push_back(reflect(ppp.first,axis));
+    position_.push_back(reflect(ppp.second,axis));
+}
+
+void GeometricObject::updateDerived() {
+    if (position_.size() < 2) {
+        return;
+    }
+    QPointF d = position_[1] - position_[0];
+    derived_.length2 = len2(d);
+    derived_.length = std::sqrt(derived_.length2);
+    derived_.unit = derived_.length > 0 ? d / double(derived_.length) : QPointF();
+    derived_.normal = QPointF(-derived_.unit.y(), derived_.unit.x());
+    derived_.theta = Theta(d);
+    if (getObjectType() == ObjectType::Circle || getObjectType() == ObjectType::Arc) {
+        double r = derived_.length;
+        derived_.box = QRectF(position_[0].x() - r, position_[0].y() - r, 2 * r, 2 * r);
+        derived_.span = 2 * PI;
+    } else {
+        derived_.box = QRectF(position_[0], position_[1]).normalized();
+        derived_.span = 0;
+    }
+}
+
+QRectF GeometricObject::boundingRect(const QRectF& viewport) const {
+    return viewport;
+}
+
+QRectF GeometricObject::labelRect(const QPointF& anchor) const {
+    const QString& label = getLabel();
+    if (islablehidden() || label.isEmpty()) {
+        return QRectF();
+    }
+    // 标签用的是控件的默认字体, anchor 是基线的起点
+    QFontMetricsF fm{QFont()};
+    return fm.boundingRect(label).translated(anchor).adjusted(-1, -1, 1, 1);
+}
+
+QRectF GeometricObject::strokeRect(const QRectF& r) const {
+    double d = (getSize() + HOVER_ADD_WIDTH + SELECTED_WIDTH) / 2 + 1; // 多出的 1 像素给抗锯齿
+    return r.normalized().adjusted(-d, -d, d, d);
+}
+
 bool GeometricObject::operator < (const GeometricObject& other) const {
     if (getObjectType() != other.getObjectType()) {
         return getObjectType() < other.getObjectType();
@@ -110,9 +204,27 @@ bool GeometricObject::addParent(GeometricObject* parent) {
     }
     parents_.push_back(parent);
     parent->addChild(this); // 维持双向关系：让父对象也添加当前对象作为子对象
+    markDirty();
     return true; // 成功添加到当前对象的父对象列表
 }
 
+bool GeometricObject::replaceParent(GeometricObject* oldParent, GeometricObject* newParent) {
+    auto it = std::find(parents_.begin(), parents_.end(), oldParent);
+    if (!newParent || newParent == this || it == parents_.end()) {
+        return false;
+    }
+    *it = newParent;
+    auto child = std::find(oldParent->children_.begin(), oldParent->children_.end(), this);
+    if (child != oldParent->children_.end()) {
+        oldParent->children_.erase(child);
+    }
+    if (std::find(newParent->children_.begin(), newParent->children_.end(), this) == newParent->children_.end()) {
+        newParent->children_.push_back(this);
+    }
+    markDirty();
+    return true;
+}
+
 bool GeometricObject::addChild(GeometricObject* child) {
     if (!child || child == this) {
         return false; // 无效操作：子对象为空或子对象是自身
@@ -148,16 +260,17 @@ bool GeometricObject::removeParent(GeometricObject* parent) {
     if (it != parents_.end()) {
         parents_.erase(it);
         parent->removeChild(this); // 维持双向关系：让父对象也移除当前对象的子对象引用
+        markDirty();
         return true; // 成功从当前对象的父对象列表中移除
     }
     return false; // 未找到父对象，未做更改
 }
 
-const std::vector<GeometricObject*>& GeometricObject::getChildren() const {
+const ObjectList& GeometricObject::getChildren() const {
     return children_; // 返回子对象列表的常量引用
 }
 
-const std::vector<GeometricObject*>& GeometricObject::getParents() const {
+const ObjectList& GeometricObject::getParents() const {
     return parents_; // 返回父对象列表的常量引用
 }
 
@@ -172,11 +285,7 @@ bool GeometricObject::hasParent(GeometricObject* parent) const {
 }
 
 std::pair<const QPointF, const QPointF> GeometricObject::getTwoPoints() const{
-    QMessageBox::warning(
-        nullptr,
-        "警告",
-        QString::fromStdString(std::string(GetObjectNameString(this->getObjectType()))+"没有getTwoPoint方法!")
-        );
+    reportError(QString::fromStdString(std::string(GetObjectNameString(this->getObjectType()))+"没有getTwoPoint方法!"));
     return std::make_pair(QPointF(),QPointF(1,1));
 }
 
@@ -4,9 +4,11 @@
 #include <QPainter>
 #include <vector>
 #include "objecttype.h"
+#include "scalar.h"
+#include "objecttable.h"
+#include "smallvector.h"
 #include<qmessagebox.h>
 
-extern std::map<ObjectType, QString> GetDefaultLable;
 extern std::map<ObjectType, QColor> GetDefaultColor;
 extern std::map<ObjectType, double> GetDefaultSize;
 extern std::map<ObjectType, int> GetDefaultShape;
@@ -19,12 +21,39 @@ const int Dotted = 2; // 如果以后需要
 
 class Saveloadhelper;
 
+// 绘制的细节程度, 由 Canvas 每帧根据屏幕上对象的密度设置, draw() 只读取
+struct RenderOptions {
+    bool labels = true;     // 对象挤在一起时标签只会糊成一片, 不画
+    bool draft = false;     // 拖动/缩放中的草稿质量: 不抗锯齿, 不画选中光晕, 曲线用折线近似
+    bool highlights = true; // 选中和悬停效果; 导出时关掉, 只导出图形本身
+};
+extern RenderOptions renderOptions;
+
+// painter 上可能被画到的范围: 有裁剪时是裁剪区域 (例如分块绘制的一个块), 否则是整个 viewport
+inline QRectF paintableRect(const QPainter* painter) {
+    return painter->hasClipping() ? painter->clipBoundingRect() : QRectF(painter->viewport());
+}
+
+// 由两个定义点导出的量 (两点距离, 方向等), 每次 flush 之后算一次,
+// 命中测试和子对象的 flush 直接读取, 不用再重复开方和求角度
+struct DerivedGeometry {
+    Real length = 0;     // 两点距离: 圆和圆弧的半径, 线段的长度
+    Real length2 = 0;    // 距离的平方
+    QPointF unit;               // 从第一个点指向第二个点的单位向量
+    QPointF normal;             // unit 旋转 90°, 点到直线的有向距离就是和它的点积
+    Real theta = 0;      // unit 的角度 (Theta)
+    Real span = 0;       // 圆弧的角度跨度, 圆为 2π
+    QRectF box;                 // 圆和圆弧是外接正方形, 直线类是两个点围成的矩形
+};
+
+class GeometricObject;
+// 父对象和子对象列表: 大多数对象的父对象不超过 3 个, 直接存在对象里
+typedef SmallVector<GeometricObject*, 3> ObjectList;
+
 class GeometricObject {
 public:
-    static int counter;
-    static void setCounter(int n);
-
-    GeometricObject(ObjectName name, bool aux = false);
+    // 对象登记到 table (它所在文档的对象表), 析构时从中注销
+    GeometricObject(ObjectTable* table, ObjectName name, bool aux = false);
 
     virtual ~GeometricObject();
 
@@ -33,46 +62,105 @@ public:
     virtual bool isNear(const QPointF& Pos) const = 0;
     virtual QPointF position() const = 0;
     virtual std::pair<const QPointF, const QPointF> getTwoPoints() const;
+    // draw() 可能画到的屏幕范围 (含标签和悬停/选中效果), 用于局部重绘
+    // viewport 是可见区域, 直线和射线裁剪到其中; 默认返回整个 viewport
+    virtual QRectF boundingRect(const QRectF& viewport) const;
 
     // --- Status Getters ---
-    bool isShown()const {return legal_ && !hidden_ && !aux_;}
-    bool isSelected() const { return selected_; }
-    bool isHidden() const { return hidden_; }
-    bool isLegal() const { return legal_; }
-    bool isHovered() const { return hovered_; }
-    bool isAux() const { return aux_; }
-    QString getLabel() const { return label_; }
-    QColor getColor() const { return color_; }
-    double getSize() const { return size_; }
-    int getShape() const { return shape_; }
+    bool isShown()const {return isShownInLayer() && table_->layers().isVisible(layer_);}
+    bool isShownInLayer() const {return (flags_ & (Legal | Hidden | Aux)) == Legal;} // 不考虑所在图层是否显示
+    bool isSelected() const { return flags_ & Selected; }
+    bool isHidden() const { return flags_ & Hidden; }
+    bool isLegal() const { return flags_ & Legal; }
+    bool isHovered() const { return flags_ & Hovered; }
+    bool isAux() const { return flags_ & Aux; }
+    QString getLabel() const { return table_->labels().text(label_); }
+    const Style& getStyle() const { return table_->styles()[style_]; }
+    QColor getColor() const { return getStyle().color; }
+    double getSize() const { return getStyle().size; }
+    int getShape() const { return getStyle().shape; }
     int getIndex() const { return index_; }
+    int getLayer() const { return layer_; }
+    ObjectHandle getHandle() const { return handle_; }
+    ObjectTable* getTable() const { return table_; }
     int getGeneration() const { return generation_; }
-    bool islablehidden() const {return labelhidden_;}
+    const DerivedGeometry& derived() const { return derived_; }
+    size_t heapUsage() const;   // 成员里的 vector 和标签占用的堆内存 (字节), 不含对象本身
+    bool islablehidden() const {return flags_ & LabelHidden;}
 
     // --- Status Setters ---
-    void setSelected(bool selected) { selected_ = selected; }
-    void setHidden(bool hidden) { hidden_ = hidden; }
-    void setLegal(bool legal) { legal_ = legal ;}
-    void setHovered(bool hovered) { hovered_ = hovered; }
-    void setlabelhidden(bool labelhidden) { labelhidden_ = labelhidden; }
-    void setLabel(QString str) { label_ = str; } // update default label to the next char maybe?
-    void setColor(QColor color){ color_ = color; GetDefaultColor[name_] = color; }
-    void setSize(double size) { size_ = size; GetDefaultSize[name_] = size; }
-    void setShape(int shape) { shape_ = shape; GetDefaultShape[name_] = shape;}
+    void setSelected(bool selected) { setFlag(Selected, selected); }
+    void setHidden(bool hidden) { setFlag(Hidden, hidden); table_->markChanged(handle_); }
+    void setLegal(bool legal) { setFlag(Legal, legal); }
+    void setHovered(bool hovered) { setFlag(Hovered, hovered); }
+    void setlabelhidden(bool labelhidden) { setFlag(LabelHidden, labelhidden); }
+    void setLayer(int layer) {
+        table_->layers().touch(layer_);
+        layer_ = quint8(layer);
+        table_->layers().touch(layer_);
+        table_->markChanged(handle_);   // 命中测试的索引里没有隐藏图层的对象
+    }
+    void setLabel(const QString& str) { bindLabel(table_->labels().encode(str)); markDirty(); } // 度量的文字里有父对象的标签
+    // 取这一类对象的下一个自动标签 (跳过已被占用的) 并登记到索引; 正式对象在构造函数里调用
+    // 临时对象和辅助对象不调用, 只显示下一个标签而不占用它
+    void takeDefaultLabel() { bindLabel(table_->labels().take(name_)); }
+    // 对象离开文档 (删除, 撤销掉它的创建) 时注销标签, 回到文档 (撤销删除, 重做) 时重新登记; 标签文字不变,
+    // 除非回来时它已被其它对象占用
+    void unbindLabel() {
+        if (flags_ & Named) {
+            table_->labels().unbind(label_, this);
+            setFlag(Named, false);
+        }
+    }
+    void rebindLabel() {
+        if (!(flags_ & Named)) {
+            bindLabel(label_);
+        }
+    }
+    // 改样式的同时把它设为这一类对象的默认样式
+    void setColor(QColor color){
+        GetDefaultColor[name_] = color;
+        StylePalette::defaultsChanged();
+        setStyle(color, getSize(), getShape());
+    }
+    void setSize(double size) {
+        GetDefaultSize[name_] = size;
+        StylePalette::defaultsChanged();
+        setStyle(getColor(), size, getShape());
+        table_->markChanged(handle_); // 线宽决定命中的容差
+    }
+    void setShape(int shape) {
+        GetDefaultShape[name_] = shape;
+        StylePalette::defaultsChanged();
+        setStyle(getColor(), getSize(), shape);
+    }
 
     // --- Parent Management ---
     bool addParent(GeometricObject* parent);//四个add/remove函数都内置了双向设置, 也就是只要A设置add/remove B, B自动就会add/remove A
     bool removeParent(GeometricObject* parent);
-    const std::vector<GeometricObject*>& getParents() const;
+    const ObjectList& getParents() const;
     bool hasParent(GeometricObject* parent) const;
+    // 把父对象 oldParent 换成 newParent, 位置不变 (父对象的顺序决定了几何含义)
+    bool replaceParent(GeometricObject* oldParent, GeometricObject* newParent);
 
     // --- Child Management ---
     bool addChild(GeometricObject* child);
     bool removeChild(GeometricObject* child);
-    const std::vector<GeometricObject*>& getChildren() const;
+    const ObjectList& getChildren() const;
     bool hasChild(GeometricObject* child) const;
 
     virtual GeometricObject* flush()=0;//返回自己
+    // 除父对象外决定几何的参数: 约束点在所在曲线上的位置; 其它对象只由父对象决定
+    virtual QPointF constraint() const { return QPointF(); }
+
+    // --- 按需计算 ---
+    // 没有被标记的对象在父对象改变之前可以直接沿用上一次 flush 的结果
+    void markDirty();                   // 标记自己和所有后代需要重新计算
+    bool isDirty() const { return flags_ & Dirty; }
+    GeometricObject* evaluate();        // 先保证父对象是最新的, 需要时再 flush 自己
+    // 不管有没有被标记都 flush 一遍 (关闭按需计算时每帧调用, 父对象要先算); 位置或合法性真的变了时
+    // 才和 evaluate 一样通知命中测试和图层缓存. 返回是否变了
+    virtual bool reflush();
     virtual bool isTouchedByRectangle(const QPointF& start, const QPointF& end) const=0;
 
     friend class Saveloadhelper;
@@ -80,86 +168,94 @@ public:
     bool operator < (const GeometricObject& other) const;
 
 protected:
-
-    inline void expectParentNum(size_t num)const{
-        if(parents_.size()!=num)
-            QMessageBox::warning(
-                nullptr,
-                "警告",
-                label_+"的parents_大小不为"+QString::number(num)+"!");
+    enum Flag : quint8 {
+        Selected = 1 << 0,
+        Hovered = 1 << 1,
+        Legal = 1 << 2,
+        Hidden = 1 << 3,
+        Aux = 1 << 4,
+        LabelHidden = 1 << 5,
+        Dirty = 1 << 6,
+        Named = 1 << 7,         // label_ 已登记在 table_->labels() 的索引中
+    };
+    // 影响画出来的样子的标志; 悬停和选中的对象画在图层缓存里, 所以也算
+    static const quint8 Appearance = Selected | Hovered | Legal | Hidden | Aux | LabelHidden;
+    // 外观真的变了才让所在图层的缓存失效: 每次移动鼠标都会 setHovered, 每次 flush 都会 setLegal,
+    // 大多数时候值不变
+    void setFlag(Flag flag, bool on) {
+        quint8 flags = on ? (flags_ | flag) : (flags_ & ~flag);
+        if (flags != flags_ && (flag & Appearance)) {
+            table_->layers().touch(layer_);
+        }
+        flags_ = flags;
     }
-    std::vector<QPointF> position_;
-    bool selected_;
-    bool hovered_;
-    mutable bool legal_;
-    bool hidden_;
-    bool aux_;
-    bool labelhidden_;
-    std::vector<GeometricObject*> parents_ = {};
-    std::vector<GeometricObject*> children_ = {};
-    QString label_;
-    QColor color_;
-    double size_;
-    int shape_;
-    int generation_;//这个对象是怎么产生的
-    //统一约定: -1为平移产生的, -2为旋转产生的, -3为轴对称产生的, -4为中心对称产生的, -5为反演产生的
-    ObjectName name_;
-    int index_;
-};
-
-inline QString nextLineLable(const QString& input) {
-    // 从后往前找到第一个非数字字符的位置
-    int i = input.length();
-    while (i > 0 && input[i-1].isDigit()) {
-        --i;
+    void setStyle(const QColor& color, double size, int shape) {
+        style_ = table_->styles().intern(color, size, shape);
+        table_->layers().touch(layer_);
     }
-
-    // 如果没有数字部分，直接返回原字符串
-    if (i == input.length()) {
-        return input;
+    // 辅助对象不登记; 标签已被其它对象占用时 (旧文件里的重复标签, 撤销回来的对象) 改用下一个自动标签
+    void bindLabel(LabelRegistry::Code code) {
+        unbindLabel();
+        label_ = code;
+        table_->layers().touch(layer_);     // 标签的文字变了
+        if (flags_ & Aux) {
+            return;
+        }
+        if (!table_->labels().bind(label_, this)) {
+            label_ = table_->labels().take(name_);
+            table_->labels().bind(label_, this);
+        }
+        setFlag(Named, true);
     }
 
-    // 分离单词和数字部分
-    QString word = input.left(i);
-    QString numStr = input.mid(i);
+    // 由父对象构造的对象和父对象在同一个文档里; 子类构造时 parents 不能为空
+    static ObjectTable* tableOf(const std::vector<GeometricObject*>& parents) { return parents.front()->table_; }
 
-    // 将数字部分转为整数并加1
-    bool ok;
-    int num = numStr.toInt(&ok);
-    if (!ok) {
-        return input;  // 转换失败时返回原字符串
-    }
+    // draw() 里用来决定画不画选中和悬停效果
+    bool drawsSelected() const { return isSelected() && renderOptions.highlights; }
+    bool drawsHovered() const { return isHovered() && renderOptions.highlights; }
 
-    // 拼接结果
-    return word + QString::number(num + 1);
-}
-
-inline int string2int(QString input) {
-    if (input == ""){
-        return 0;
-    } else {
-        QChar c = input[input.length() - 1];
-        input.erase(input.end() - 1);
-        return string2int(input) * 26 + (c.unicode() - QChar('A').unicode() + 1);
+    // 计算中的错误记到对象表里 (见 ObjectTable::reportError), 不在这里弹对话框
+    void reportError(const QString& message)const{ table_->reportError(message); }
+    inline bool expectParentNum(size_t num)const{
+        if(parents_.size()!=num){
+            reportError(getLabel()+"的parents_大小不为"+QString::number(num)+"!");
+            return false;
+        }
+        return true;
     }
-}
-
-inline QString int2string(int n) {
-    if (n <= 26){
-        char c = 'A' + n - 1;
-        return QString(c);
-    } else {
-        char c = 'A' + (n-1) % 26;
-        return int2string((n-1)/26) + QString(c);
+    // 检查第 i 个父对象的类型, 通过后计算核心里可以直接 static_cast
+    inline bool expectParentType(size_t i, ObjectType type)const{
+        if(i>=parents_.size()||parents_[i]->getObjectType()!=type){
+            reportError(getLabel()+"的第"+QString::number(i)+"个父对象不是"+QString::fromStdString(GetObjectNameString(type))+"!");
+            return false;
+        }
+        return true;
     }
-}
-
-inline QString nextPointLable(const QString& input) {
-    return int2string(string2int(input) + 1);
-}
 
-inline QString previousPointLable(const QString& input){
-        return int2string(string2int(input) - 1);
-}
+    // 中心对称 (-4) 和轴对称 (-3) 时两个定义点的变换, 直线类和圆共用的计算核心
+    void flushCentralSymmetry();
+    void flushAxialSymmetry();
+    // 由 position_ 的前两个点更新 derived_, 各曲线的 flush 在最后调用
+    void updateDerived();
+    // 在 anchor 处 drawText(getLabel()) 占用的范围, 标签隐藏时为空
+    QRectF labelRect(const QPointF& anchor) const;
+    // 线宽加上悬停和选中时的额外宽度, 向外扩展 r
+    QRectF strokeRect(const QRectF& r) const;
+    SmallVector<QPointF, 2> position_;
+    ObjectList parents_;
+    ObjectList children_;
+    DerivedGeometry derived_;
+    ObjectTable* table_;        // 构造时登记的对象表, 样式和标签也存在这里
+    ObjectHandle handle_;
+    int index_;                 // 在所属对象表中的创建顺序
+    int generation_;//这个对象是怎么产生的
+    //统一约定: -1为平移产生的, -2为旋转产生的, -3为轴对称产生的, -4为中心对称产生的, -5为反演产生的
+    ObjectName name_;
+    LabelRegistry::Code label_; // 由 table_->labels() 编码, 显示时才转成字符串
+    quint16 style_;             // 在 table_->styles() 中的编号
+    quint8 flags_;              // Flag 的组合
+    quint8 layer_;              // 在 table_->layers() 中的编号
+};
 
 #endif // GEOMETRICOBJECT_H
@@ -0,0 +1,367 @@
+#include "hittester.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace {
+
+const int MaxCells = 16; // 包围盒覆盖超过这么多格子的对象不进网格
+
+// 下面的核心一次处理 n 个对象, 数组连续, 循环里没有分支和函数调用, 可以向量化;
+// 网格里的单个候选也用同样的核心 (n = 1), 保证两条路径的判定完全一致
+
+// 到直线的距离: 和单位法向的点积
+void nearLines(int n, const double* x, const double* y, const double* nx, const double* ny,
+               const double* tol2, double px, double py, unsigned char* hit) {
+    for (int i = 0; i < n; ++i) {
+        double d = (px - x[i]) * nx[i] + (py - y[i]) * ny[i];
+        hit[i] = d * d < tol2[i];
+    }
+}
+
+// 到线段的距离: 投影参数截断到 [0, length] 后到该点的距离
+void nearSegments(int n, const double* x, const double* y, const double* ux, const double* uy,
+                  const double* length, const double* tol2, double px, double py, unsigned char* hit) {
+    for (int i = 0; i < n; ++i) {
+        double dx = px - x[i], dy = py - y[i];
+        double t = std::min(std::max(dx * ux[i] + dy * uy[i], 0.0), length[i]);
+        double ex = dx - ux[i] * t, ey = dy - uy[i] * t;
+        hit[i] = ex * ex + ey * ey < tol2[i];
+    }
+}
+
+// |到圆心的距离 - 半径| < 容差, 两边平方后不用开方
+void nearCircles(int n, const double* x, const double* y, const double* inner2, const double* outer2,
+                 double px, double py, unsigned char* hit) {
+    for (int i = 0; i < n; ++i) {
+        double dx = px - x[i], dy = py - y[i];
+        double d2 = dx * dx + dy * dy;
+        hit[i] = (d2 > inner2[i]) & (d2 < outer2[i]);
+    }
+}
+
+void nearPoints(int n, const double* x, const double* y, const double* r2, double px, double py,
+                unsigned char* hit) {
+    for (int i = 0; i < n; ++i) {
+        double dx = px - x[i], dy = py - y[i];
+        hit[i] = dx * dx + dy * dy <= r2[i];
+    }
+}
+
+} // namespace
+
+HitTester::HitTester(ObjectTable* table, double cellSize) : table_(table), cellSize_(cellSize) {}
+
+qint64 HitTester::cellKey(int cx, int cy) const {
+    return (qint64(cx) << 32) ^ quint32(cy);
+}
+
+bool HitTester::insert(const QRectF& box, int entry) {
+    double x0 = std::floor(box.left() / cellSize_), x1 = std::floor(box.right() / cellSize_);
+    double y0 = std::floor(box.top() / cellSize_), y1 = std::floor(box.bottom() / cellSize_);
+    if (!std::isfinite(x0 + x1 + y0 + y1) || (x1 - x0 + 1) * (y1 - y0 + 1) > MaxCells) {
+        return false;
+    }
+    if (entry < 0) {
+        return true; // 只检查是否放得进网格
+    }
+    for (int cy = int(y0); cy <= int(y1); ++cy) {
+        for (int cx = int(x0); cx <= int(x1); ++cx) {
+            cells_[cellKey(cx, cy)].push_back(entry);
+        }
+    }
+    return true;
+}
+
+void HitTester::ensureBuilt(const std::vector<GeometricObject*>& objects) {
+    bool all = table_->takeChanged(changed_);
+    if (!valid_ || all || objects.size() != objects_.size()) {
+        rebuild(objects);
+        return;
+    }
+    for (ObjectHandle handle : changed_) {
+        GeometricObject* obj = table_->get(handle);
+        if (!obj || handle.slot >= slotIndex_.size()) {
+            continue;
+        }
+        int i = slotIndex_[handle.slot];
+        if (i < 0 || objects_[i] != obj) {
+            continue; // 辅助对象和预览对象不在索引里
+        }
+        remove(i);
+        add(i);
+    }
+    // 作废的数据和格子里的旧登记多了以后查询会变慢, 这时再整体重建一次
+    if (dead_ > live_ + 64) {
+        rebuild(objects_);
+    }
+}
+
+void HitTester::layerChanged(int layer) {
+    if (!valid_) {
+        return;
+    }
+    for (int i = 0; i < int(objects_.size()); ++i) {
+        if (objects_[i] && objects_[i]->getLayer() == layer) {
+            remove(i);
+            add(i);
+        }
+    }
+}
+
+void HitTester::rebuild(const std::vector<GeometricObject*>& objects) {
+    if (&objects != &objects_) {
+        objects_ = objects;
+    }
+    points_ = Points();
+    lines_ = Lines();
+    segments_ = Segments();
+    wideSegments_ = Segments();
+    circles_ = Circles();
+    wideCircles_ = Circles();
+    others_.clear();
+    cells_.clear();
+    live_ = dead_ = 0;
+    where_.assign(objects_.size(), Location());
+    slotIndex_.clear();
+    for (int i = 0; i < int(objects_.size()); ++i) {
+        if (!objects_[i]) {
+            continue;
+        }
+        quint32 slot = objects_[i]->getHandle().slot;
+        if (slot >= slotIndex_.size()) {
+            slotIndex_.resize(slot + 1, -1);
+        }
+        slotIndex_[slot] = i;
+        add(i);
+    }
+    valid_ = true;
+}
+
+void HitTester::remove(int i) {
+    Location& at = where_[i];
+    switch (at.kind) {
+    case PointKind: points_.order[at.index] = -1; break;
+    case SegmentKind: segments_.order[at.index] = -1; break;
+    case CircleKind: circles_.order[at.index] = -1; break;
+    case LineKind: lines_.order[at.index] = -1; break;
+    case WideSegmentKind: wideSegments_.order[at.index] = -1; break;
+    case WideCircleKind: wideCircles_.order[at.index] = -1; break;
+    case OtherKind: others_[at.index] = -1; break;
+    case NoKind: return;
+    }
+    at = Location();
+    --live_;
+    ++dead_;
+}
+
+void HitTester::add(int i) {
+    GeometricObject* obj = objects_[i];
+    if (!obj || !obj->isShown()) {
+        return;
+    }
+    Location& at = where_[i];
+    const DerivedGeometry& d = obj->derived();
+    double tol = 1e-2 + obj->getSize();
+    QRectF box = d.box.adjusted(-tol, -tol, tol, tol);
+    auto other = [&]() {
+        at = {OtherKind, int(others_.size())};
+        others_.push_back(i);
+    };
+    switch (obj->getObjectType()) {
+    case ObjectType::Point: {
+        QPointF p = obj->position();
+        double r = obj->getSize() + 4;
+        int index = points_.x.size();
+        if (!insert(QRectF(p.x() - r, p.y() - r, 2 * r, 2 * r), index << 2 | PointKind)) {
+            other();
+            break;
+        }
+        at = {PointKind, index};
+        points_.x.push_back(p.x());
+        points_.y.push_back(p.y());
+        points_.r2.push_back(r * r);
+        points_.order.push_back(i);
+        break;
+    }
+    case ObjectType::Line:
+    case ObjectType::Lineo: {
+        // 射线和 Lineo::isNear 一样按所在直线判定
+        if (d.length == 0) {
+            other();
+            break;
+        }
+        QPointF p = obj->getTwoPoints().first;
+        at = {LineKind, int(lines_.x.size())};
+        lines_.x.push_back(p.x());
+        lines_.y.push_back(p.y());
+        lines_.nx.push_back(d.normal.x());
+        lines_.ny.push_back(d.normal.y());
+        lines_.tol2.push_back(tol * tol);
+        lines_.order.push_back(i);
+        break;
+    }
+    case ObjectType::Lineoo: {
+        if (d.length == 0) {
+            other();
+            break;
+        }
+        bool local = insert(box, -1);
+        Segments& segments = local ? segments_ : wideSegments_;
+        int index = segments.x.size();
+        if (local) {
+            insert(box, index << 2 | SegmentKind);
+        }
+        at = {local ? SegmentKind : WideSegmentKind, index};
+        QPointF p = obj->getTwoPoints().first;
+        segments.x.push_back(p.x());
+        segments.y.push_back(p.y());
+        segments.ux.push_back(d.unit.x());
+        segments.uy.push_back(d.unit.y());
+        segments.length.push_back(d.length);
+        segments.tol2.push_back(tol * tol);
+        segments.order.push_back(i);
+        break;
+    }
+    case ObjectType::Circle:
+    case ObjectType::Arc: {
+        bool local = insert(box, -1);
+        Circles& circles = local ? circles_ : wideCircles_;
+        int index = circles.x.size();
+        if (local) {
+            insert(box, index << 2 | CircleKind);
+        }
+        at = {local ? CircleKind : WideCircleKind, index};
+        double r = d.length;
+        QPointF c = obj->position();
+        circles.x.push_back(c.x());
+        circles.y.push_back(c.y());
+        circles.inner2.push_back(r > tol ? (r - tol) * (r - tol) : -1.0);
+        circles.outer2.push_back((r + tol) * (r + tol));
+        circles.arc.push_back(obj->getObjectType() == ObjectType::Arc);
+        circles.order.push_back(i);
+        break;
+    }
+    default:
+        other();
+        break;
+    }
+    ++live_;
+}
+
+void HitTester::collectPoints(const QPointF& pos, std::vector<int>& hits) const {
+    auto cell = cells_.find(cellKey(int(std::floor(pos.x() / cellSize_)), int(std::floor(pos.y() / cellSize_))));
+    if (cell == cells_.end()) {
+        return;
+    }
+    unsigned char hit;
+    for (int entry : cell->second) {
+        int i = entry >> 2;
+        if ((entry & 3) == PointKind && points_.order[i] >= 0) {
+            nearPoints(1, &points_.x[i], &points_.y[i], &points_.r2[i], pos.x(), pos.y(), &hit);
+            if (hit) {
+                hits.push_back(points_.order[i]);
+            }
+        }
+    }
+}
+
+std::vector<GeometricObject*> HitTester::objectsNear(const std::vector<GeometricObject*>& objects,
+                                                     const QPointF& pos) {
+    ensureBuilt(objects);
+    const double px = pos.x(), py = pos.y();
+    std::vector<int> hits;
+    collectPoints(pos, hits);
+
+    // 每次都要检查的对象: 整批计算
+    int lines = lines_.x.size(), wideSegments = wideSegments_.x.size(), wideCircles = wideCircles_.x.size();
+    mask_.resize(std::max({lines, wideSegments, wideCircles}));
+    nearLines(lines, lines_.x.data(), lines_.y.data(), lines_.nx.data(), lines_.ny.data(), lines_.tol2.data(),
+              px, py, mask_.data());
+    for (int i = 0; i < lines; ++i) {
+        if (mask_[i] && lines_.order[i] >= 0) {
+            hits.push_back(lines_.order[i]);
+        }
+    }
+    nearSegments(wideSegments, wideSegments_.x.data(), wideSegments_.y.data(), wideSegments_.ux.data(),
+                 wideSegments_.uy.data(), wideSegments_.length.data(), wideSegments_.tol2.data(), px, py,
+                 mask_.data());
+    for (int i = 0; i < wideSegments; ++i) {
+        if (mask_[i] && wideSegments_.order[i] >= 0) {
+            hits.push_back(wideSegments_.order[i]);
+        }
+    }
+    nearCircles(wideCircles, wideCircles_.x.data(), wideCircles_.y.data(), wideCircles_.inner2.data(),
+                wideCircles_.outer2.data(), px, py, mask_.data());
+    auto addCircle = [&](const Circles& circles, int i) {
+        // 圆弧还要在角度范围内, 这种对象很少, 直接交给 isNear
+        if (circles.order[i] >= 0 && (!circles.arc[i] || objects_[circles.order[i]]->isNear(pos))) {
+            hits.push_back(circles.order[i]);
+        }
+    };
+    for (int i = 0; i < wideCircles; ++i) {
+        if (mask_[i]) {
+            addCircle(wideCircles_, i);
+        }
+    }
+
+    // 鼠标所在格子里的线段和圆
+    auto cell = cells_.find(cellKey(int(std::floor(px / cellSize_)), int(std::floor(py / cellSize_))));
+    if (cell != cells_.end()) {
+        unsigned char hit;
+        for (int entry : cell->second) {
+            int i = entry >> 2;
+            switch (entry & 3) {
+            case SegmentKind:
+                nearSegments(1, &segments_.x[i], &segments_.y[i], &segments_.ux[i], &segments_.uy[i],
+                             &segments_.length[i], &segments_.tol2[i], px, py, &hit);
+                if (hit && segments_.order[i] >= 0) {
+                    hits.push_back(segments_.order[i]);
+                }
+                break;
+            case CircleKind:
+                nearCircles(1, &circles_.x[i], &circles_.y[i], &circles_.inner2[i], &circles_.outer2[i], px, py,
+                            &hit);
+                if (hit) {
+                    addCircle(circles_, i);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    for (int i : others_) {
+        if (i >= 0 && objects_[i]->isNear(pos)) {
+            hits.push_back(i);
+        }
+    }
+
+    std::sort(hits.begin(), hits.end(), std::greater<int>());
+    std::vector<GeometricObject*> ret;
+    ret.reserve(hits.size());
+    for (int i : hits) {
+        if (objects_[i]->isShown()) {
+            ret.push_back(objects_[i]);
+        }
+    }
+    return ret;
+}
+
+GeometricObject* HitTester::pointNear(const std::vector<GeometricObject*>& objects, const QPointF& pos) {
+    ensureBuilt(objects);
+    std::vector<int> hits;
+    collectPoints(pos, hits);
+    for (int i : others_) {
+        if (i >= 0 && objects_[i]->getObjectType() == ObjectType::Point && objects_[i]->isNear(pos)) {
+            hits.push_back(i);
+        }
+    }
+    hits.erase(std::remove_if(hits.begin(), hits.end(), [this](int i) { return !objects_[i]->isShown(); }),
+               hits.end());
+    if (hits.empty()) {
+        return nullptr;
+    }
+    return objects_[*std::max_element(hits.begin(), hits.end())];
+}
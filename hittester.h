@@ -0,0 +1,84 @@
+#ifndef HITTESTER_H
+#define HITTESTER_H
+
+#include <QPointF>
+#include <unordered_map>
+#include <vector>
+#include "geometricobject.h"
+
+// 鼠标附近有哪些对象: 和逐个调用 isNear 的结果相同, 但不做虚函数调用
+// 可见对象的定义数据按类型存成连续的数组 (点的坐标, 直线的起点和法向, 圆心和半径...),
+// 直线和射线以及很大的线段/圆每次整体扫一遍 (循环可以被编译器向量化),
+// 其余对象按包围盒放进均匀网格, 只检查鼠标所在格子里的候选
+// 几何或显示状态变了的对象由对象表记下 (ObjectTable::markChanged), 查询前只更新这些对象:
+// 旧的数据作废, 新的追加到数组末尾, 作废的太多时才整体重建; 拖动时每帧只更新动了的对象
+// 隐藏图层里的对象不进索引, 查询时整个跳过; 显示/隐藏图层时只更新这个图层的对象
+class HitTester {
+public:
+    explicit HitTester(ObjectTable* table, double cellSize = 64);
+
+    // objects 增删了对象 (创建, 删除, 撤销, 重做) 时调用, 下一次查询时整体重建;
+    // objects 里存的是指针, 删掉一个再建一个数量不变, 所以不能靠数量判断
+    void invalidate() { valid_ = false; }
+    // layer 被显示或隐藏了: 把其中的对象加入或移出索引
+    void layerChanged(int layer);
+
+    // objects 是绘制顺序; 结果按从上到下 (objects 从后往前) 排列
+    std::vector<GeometricObject*> objectsNear(const std::vector<GeometricObject*>& objects, const QPointF& pos);
+    // 最上面的一个点, 没有时返回 nullptr
+    GeometricObject* pointNear(const std::vector<GeometricObject*>& objects, const QPointF& pos);
+
+private:
+    // 数组里作废的数据 order 为 -1, 批量计算照算, 结果不用
+    struct Points {
+        std::vector<double> x, y, r2;       // r2: 命中半径的平方
+        std::vector<int> order;             // 在 objects 中的下标
+    };
+    struct Lines {                          // 直线和射线: 到所在直线的距离
+        std::vector<double> x, y, nx, ny, tol2;
+        std::vector<int> order;
+    };
+    struct Segments {
+        std::vector<double> x, y, ux, uy, length, tol2;
+        std::vector<int> order;
+    };
+    struct Circles {                        // 圆和圆弧: 到圆心的距离落在圆环内; 圆弧命中后再检查角度
+        std::vector<double> x, y, inner2, outer2;
+        std::vector<unsigned char> arc;
+        std::vector<int> order;
+    };
+    // 前三种进网格 (格子里登记 下标 << 2 | Kind), wide 的线段和圆每次查询都整体检查
+    enum Kind { PointKind, SegmentKind, CircleKind, LineKind, WideSegmentKind, WideCircleKind, OtherKind, NoKind };
+    struct Location {
+        Kind kind = NoKind;
+        int index = -1;
+    };
+
+    ObjectTable* table_;
+    double cellSize_;
+    bool valid_ = false;
+    std::vector<GeometricObject*> objects_;     // 建立时的 objects, 用 order 取回对象
+    std::vector<Location> where_;               // objects_ 中每个对象的数据在哪里
+    std::vector<int> slotIndex_;                // 句柄的槽位 -> 在 objects_ 中的下标, 不在其中为 -1
+    int live_ = 0;
+    int dead_ = 0;                              // 作废的数据个数
+    Points points_;
+    Lines lines_;
+    Segments segments_, wideSegments_;
+    Circles circles_, wideCircles_;
+    std::vector<int> others_;                   // 度量, 退化的直线等, 仍然调用 isNear
+    std::unordered_map<qint64, std::vector<int>> cells_; // 格子 -> (下标 << 2 | Kind)
+    std::vector<unsigned char> mask_;           // 批量计算的结果, 复用以免每次分配
+    std::vector<ObjectHandle> changed_;         // 复用以免每次分配
+
+    void ensureBuilt(const std::vector<GeometricObject*>& objects);
+    void rebuild(const std::vector<GeometricObject*>& objects);
+    void add(int i);                            // 按 objects_[i] 当前的状态加入索引
+    void remove(int i);                         // 作废 objects_[i] 的数据
+    qint64 cellKey(int cx, int cy) const;
+    // 把 box 覆盖的格子都登记上 entry, 覆盖太多格子时不登记并返回 false
+    bool insert(const QRectF& box, int entry);
+    void collectPoints(const QPointF& pos, std::vector<int>& hits) const;
+};
+
+#endif // HITTESTER_H
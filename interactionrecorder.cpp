@@ -0,0 +1,249 @@
+#include "interactionrecorder.h"
+#include "canvas.h"
+#include "mainwindow.h"
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QKeyEvent>
+#include <QTextStream>
+#include <QDebug>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+const quint32 LogMagic = 0x5448524C; // "THRL"
+const quint16 LogVersion = 3;    // 版本 1 只有输入事件, 版本 2 没有输入框的结果, 仍然可以重放
+const char* KindNames[] = {"press", "move", "release", "wheel", "key", "mode", "tool", "command", "resize",
+                           "find", "rename", "layer", "visible"};
+}
+
+InteractionRecorder::InteractionRecorder(const QString& path) : file_(path) {}
+
+InteractionRecorder::~InteractionRecorder() {
+    file_.close();
+}
+
+bool InteractionRecorder::start(const QSize& canvasSize, const QString& documentPath) {
+    if (!file_.open(QIODevice::WriteOnly)) {
+        qWarning() << "InteractionRecorder: cannot write" << file_.fileName();
+        return false;
+    }
+    out_.setDevice(&file_);
+    out_.setVersion(QDataStream::Qt_6_0);
+    out_ << LogMagic << LogVersion << canvasSize << documentPath;
+    timer_.start();
+    return true;
+}
+
+void InteractionRecorder::record(Kind kind, const QInputEvent* event) {
+    if (!file_.isOpen()) {
+        return;
+    }
+    out_ << quint8(kind) << qint64(timer_.nsecsElapsed());
+    switch (kind) {
+    case MousePress:
+    case MouseMove:
+    case MouseRelease: {
+        auto e = static_cast<const QMouseEvent*>(event);
+        out_ << e->position() << qint32(e->button()) << qint32(e->buttons().toInt())
+             << qint32(e->modifiers().toInt());
+        break;
+    }
+    case Wheel: {
+        auto e = static_cast<const QWheelEvent*>(event);
+        out_ << e->position() << e->angleDelta() << qint32(e->buttons().toInt())
+             << qint32(e->modifiers().toInt());
+        break;
+    }
+    case KeyPress: {
+        auto e = static_cast<const QKeyEvent*>(event);
+        out_ << qint32(e->key()) << qint32(e->modifiers().toInt()) << e->text();
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void InteractionRecorder::record(Kind kind, qint32 value) {
+    if (!file_.isOpen()) {
+        return;
+    }
+    out_ << quint8(kind) << qint64(timer_.nsecsElapsed()) << value;
+}
+
+void InteractionRecorder::record(Kind kind, const QString& text) {
+    if (!file_.isOpen()) {
+        return;
+    }
+    out_ << quint8(kind) << qint64(timer_.nsecsElapsed()) << text;
+}
+
+void InteractionRecorder::recordResize(const QSize& canvasSize) {
+    if (!file_.isOpen()) {
+        return;
+    }
+    out_ << quint8(Resize) << qint64(timer_.nsecsElapsed()) << canvasSize;
+}
+
+void InteractionRecorder::recordLayerVisible(int layer, bool visible) {
+    if (!file_.isOpen()) {
+        return;
+    }
+    out_ << quint8(LayerVisible) << qint64(timer_.nsecsElapsed()) << qint32(layer) << visible;
+}
+
+int InteractionReplayer::run(const QString& logPath, const QString& documentPath) {
+    QFile file(logPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open" << logPath;
+        return 2;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic;
+    quint16 version;
+    QSize size;
+    QString recordedDocument;
+    in >> magic >> version >> size >> recordedDocument;
+    if (magic != LogMagic || version < 1 || version > LogVersion) {
+        qWarning() << "Not an interaction log:" << logPath;
+        return 2;
+    }
+
+    MainWindow window;
+    Canvas& canvas = *window.m_canvas;
+    canvas.setHeadless(true);   // 计算错误不弹对话框, 否则下一次 processEvents 会卡在看不见的模态框上
+    window.show();
+    // 画布是主窗口的中央部件, 通过调整窗口大小让画布变成记录的大小
+    auto resizeCanvas = [&](const QSize& canvasSize) {
+        QCoreApplication::processEvents();
+        window.resize(window.size() + canvasSize - canvas.size());
+        QCoreApplication::processEvents();
+    };
+    resizeCanvas(size.isValid() ? size : QSize(1200, 800));
+    QString document = documentPath.isEmpty() ? recordedDocument : documentPath;
+    if (!document.isEmpty() && QFileInfo::exists(document)) {
+        canvas.setFilePath(document);
+        canvas.loadFile(true);
+    }
+    QCoreApplication::processEvents();
+
+    std::vector<qint64> latencies[InteractionRecorder::KindCount];
+    qint64 recordedDuration = 0;
+    QElapsedTimer total;
+    total.start();
+    while (!in.atEnd()) {
+        quint8 kind;
+        qint64 timestamp;
+        in >> kind >> timestamp;
+        if (in.status() != QDataStream::Ok || kind >= InteractionRecorder::KindCount) {
+            qWarning() << "Truncated interaction log";
+            break;
+        }
+        recordedDuration = timestamp;
+
+        QElapsedTimer timer;
+        if (kind == InteractionRecorder::Resize) {
+            QSize canvasSize;
+            in >> canvasSize;
+            timer.start();
+            resizeCanvas(canvasSize);
+        } else if (kind == InteractionRecorder::SetMode || kind == InteractionRecorder::SetOperation
+                   || kind == InteractionRecorder::Command) {
+            qint32 value;
+            in >> value;
+            timer.start();
+            if (kind == InteractionRecorder::SetMode) {
+                canvas.setMode(static_cast<Canvas::Mode>(value));
+            } else if (kind == InteractionRecorder::Command) {
+                canvas.runCommand(static_cast<Canvas::Command>(value));
+            } else if (value >= 0 && value < int(canvas.operationCount())) {
+                canvas.setOperation(value);
+            } else {
+                qWarning() << "Replay: tool" << value << "is not in the tool library";
+            }
+        } else if (kind == InteractionRecorder::FindLabel || kind == InteractionRecorder::RenameSelection
+                   || kind == InteractionRecorder::UseLayer) {
+            QString text;
+            in >> text;
+            timer.start();
+            if (kind == InteractionRecorder::FindLabel) {
+                canvas.findByLabel(text);
+            } else if (kind == InteractionRecorder::RenameSelection) {
+                canvas.renameSelection(text);
+            } else {
+                canvas.useLayer(text);
+            }
+        } else if (kind == InteractionRecorder::LayerVisible) {
+            qint32 layer;
+            bool visible;
+            in >> layer >> visible;
+            timer.start();
+            canvas.setLayerVisible(layer, visible);
+        } else if (kind == InteractionRecorder::Wheel) {
+            QPointF pos;
+            QPoint angleDelta;
+            qint32 buttons, modifiers;
+            in >> pos >> angleDelta >> buttons >> modifiers;
+            QWheelEvent event(pos, pos, QPoint(), angleDelta, Qt::MouseButtons::fromInt(buttons),
+                              Qt::KeyboardModifiers::fromInt(modifiers), Qt::NoScrollPhase, false);
+            timer.start();
+            QCoreApplication::sendEvent(&canvas, &event);
+        } else if (kind == InteractionRecorder::KeyPress) {
+            qint32 key, modifiers;
+            QString text;
+            in >> key >> modifiers >> text;
+            // 保存/打开/导出/查找/批量改名/切换图层会弹出模态对话框, 重放时跳过; 查找, 改名和图层的结果单独记录过
+            if (modifiers == Qt::ControlModifier && (key == Qt::Key_S || key == Qt::Key_L || key == Qt::Key_E
+                                                     || key == Qt::Key_F || key == Qt::Key_R || key == Qt::Key_G)) {
+                continue;
+            }
+            // 版本 3 起图层的显示/隐藏记为 LayerVisible, 按键 Ctrl+1 ~ Ctrl+9 不再重放, 以免切换两次
+            if (version >= 3 && modifiers == Qt::ControlModifier && key >= Qt::Key_1 && key <= Qt::Key_9) {
+                continue;
+            }
+            QKeyEvent event(QEvent::KeyPress, key, Qt::KeyboardModifiers::fromInt(modifiers), text);
+            timer.start();
+            QCoreApplication::sendEvent(&canvas, &event);
+        } else {
+            QPointF pos;
+            qint32 button, buttons, modifiers;
+            in >> pos >> button >> buttons >> modifiers;
+            QEvent::Type type = kind == InteractionRecorder::MousePress ? QEvent::MouseButtonPress
+                                : kind == InteractionRecorder::MouseMove ? QEvent::MouseMove
+                                                                          : QEvent::MouseButtonRelease;
+            QMouseEvent event(type, pos, pos, static_cast<Qt::MouseButton>(button),
+                              Qt::MouseButtons::fromInt(buttons), Qt::KeyboardModifiers::fromInt(modifiers));
+            timer.start();
+            QCoreApplication::sendEvent(&canvas, &event);
+        }
+        // 事件处理加上同步重绘才是用户感受到的延迟; 合并的鼠标移动在这一帧里处理
+        canvas.flushPendingInput();
+        canvas.repaint();
+        latencies[kind].push_back(timer.nsecsElapsed());
+    }
+    qint64 replayDuration = total.nsecsElapsed();
+
+    QTextStream out(stdout);
+    out << "event     count    mean(ms)   p50(ms)   p95(ms)   max(ms)\n";
+    for (int kind = 0; kind < InteractionRecorder::KindCount; ++kind) {
+        std::vector<qint64>& v = latencies[kind];
+        if (v.empty()) {
+            continue;
+        }
+        std::sort(v.begin(), v.end());
+        double sum = 0;
+        for (qint64 t : v) {
+            sum += t;
+        }
+        auto ms = [](double ns) { return QString::number(ns / 1e6, 'f', 3).rightJustified(10); };
+        out << QString(KindNames[kind]).leftJustified(8) << QString::number(v.size()).rightJustified(7)
+            << ms(sum / v.size()) << ms(v[v.size() / 2]) << ms(v[std::min(v.size() - 1, v.size() * 95 / 100)])
+            << ms(v.back()) << "\n";
+    }
+    out << "recorded " << QString::number(recordedDuration / 1e9, 'f', 3) << " s, replayed in "
+        << QString::number(replayDuration / 1e9, 'f', 3) << " s\n";
+    return 0;
+}
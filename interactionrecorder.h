@@ -0,0 +1,49 @@
+#ifndef INTERACTIONRECORDER_H
+#define INTERACTIONRECORDER_H
+
+#include <QString>
+#include <QSize>
+#include <QFile>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QInputEvent>
+
+class Canvas;
+
+// 记录 Canvas 收到的鼠标/滚轮/键盘事件, 以及工具栏切换模式和工具, 工具栏命令和窗口大小的变化,
+// 用于之后离屏重放和性能分析; 会弹出输入框的快捷键 (查找, 批量改名, 切换图层) 另外记下输入框的结果,
+// 重放时跳过按键, 直接执行结果; 图层的显示/隐藏也单独记录, 重放时画面和录制时一致
+// 文件格式: [magic, version, 画布大小, 初始文件路径] 之后每个事件一条记录:
+// [kind, 时间戳(ns), 事件数据]
+class InteractionRecorder {
+public:
+    enum Kind : quint8 { MousePress, MouseMove, MouseRelease, Wheel, KeyPress,
+                         SetMode, SetOperation, Command, Resize, FindLabel, RenameSelection,
+                         UseLayer, LayerVisible, KindCount };
+
+    explicit InteractionRecorder(const QString& path);
+    ~InteractionRecorder();
+
+    bool start(const QSize& canvasSize, const QString& documentPath);
+    void record(Kind kind, const QInputEvent* event);
+    // SetMode, SetOperation 和 Command 的数据是一个整数 (Canvas::Mode, 工具下标, Canvas::Command)
+    void record(Kind kind, qint32 value);
+    // FindLabel, RenameSelection 和 UseLayer 的数据是输入框里的文字
+    void record(Kind kind, const QString& text);
+    void recordResize(const QSize& canvasSize);
+    void recordLayerVisible(int layer, bool visible);
+
+private:
+    QFile file_;
+    QDataStream out_;
+    QElapsedTimer timer_;
+};
+
+// 在离屏的主窗口里按原来的顺序尽可能快地重放记录的事件, 统计每类事件从分发到重绘完成的耗时
+// 用主窗口而不是单独的 Canvas, 这样工具库里的自定义工具和录制时有相同的下标
+class InteractionReplayer {
+public:
+    static int run(const QString& logPath, const QString& documentPath);
+};
+
+#endif // INTERACTIONRECORDER_H
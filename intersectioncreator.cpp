@@ -1,5 +1,9 @@
 #include "intersectioncreator.h"
 #include"point.h"
+#include"predicates.h"
+#include<algorithm>
+#include<cmath>
+#include<unordered_map>
 
 IntersectionCreator::IntersectionCreator(){
     inputType.push_back(std::vector<ObjectType>{ObjectType::Line    ,ObjectType::Line});
@@ -34,33 +38,171 @@ IntersectionCreator::IntersectionCreator(){
 
 std::set<GeometricObject*> IntersectionCreator::apply(std::vector<GeometricObject*> objs,
                                                        QPointF position)const{
-    int index=getInputIndex(objs);
     std::set<GeometricObject*> ret;
-    if(index<=8){
-        GeometricObject *p=new Point(objs, index+5);
+    for(auto p:create(objs)){
         p->flush();
         ret.insert(p);
     }
+    return ret;
+}
+
+std::vector<GeometricObject*> IntersectionCreator::create(std::vector<GeometricObject*> objs)const{
+    int index=getInputIndex(objs);
+    std::vector<GeometricObject*> ret;
+    if(index<0){
+        return ret;
+    }
+    if(index<=8){
+        ret.push_back(new Point(objs, index+5));
+    }
     else if(index<=15){
         if(index>=13){
             index=24-index;
             std::swap(objs[0],objs[1]);
         }
-        GeometricObject *p1=new Point(objs, index*2-4);
-        GeometricObject *p2=new Point(objs, index*2-3);
-        p1->flush();
-        p2->flush();
-        ret.insert(p1);ret.insert(p2);
+        ret.push_back(new Point(objs, index*2-4));
+        ret.push_back(new Point(objs, index*2-3));
     } else if(index<=24){
         if(index>=21){
             index=40-index;
             std::swap(objs[0],objs[1]);
         }
-        GeometricObject *p1=new Point(objs, index*2+2);
-        GeometricObject *p2=new Point(objs, index*2+3);
-        p1->flush();
-        p2->flush();
-        ret.insert(p1);ret.insert(p2);
+        ret.push_back(new Point(objs, index*2+2));
+        ret.push_back(new Point(objs, index*2+3));
+    }
+    return ret;
+}
+
+namespace {
+
+const int MaxCells = 4096; // 包围盒覆盖超过这么多格子的曲线不进网格, 和其它所有有界曲线配对
+
+// 闭区间意义下的重叠; 水平/竖直线段的包围盒面积为 0, 不能用 QRectF::intersects
+bool overlaps(const QRectF& a, const QRectF& b){
+    return a.left()<=b.right() && b.left()<=a.right() && a.top()<=b.bottom() && b.top()<=a.bottom();
+}
+
+// 两条直线 (射线) 精确平行时没有交点
+bool parallel(const GeometricObject* a, const GeometricObject* b){
+    auto [A,B]=a->getTwoPoints();
+    auto [C,D]=b->getTwoPoints();
+    return sumOfProductsSign(B.x(), A.x(), D.y(), C.y(), A.y(), B.y(), D.x(), C.x())==0;
+}
+
+// 直线是否可能穿过矩形: 四个角严格在同一侧时不可能
+bool crossesBox(const GeometricObject* line, const QRectF& box){
+    auto [A,B]=line->getTwoPoints();
+    int s1=orientation(A,B,box.topLeft()), s2=orientation(A,B,box.topRight());
+    int s3=orientation(A,B,box.bottomLeft()), s4=orientation(A,B,box.bottomRight());
+    return !((s1>0 && s2>0 && s3>0 && s4>0) || (s1<0 && s2<0 && s3<0 && s4<0));
+}
+
+qint64 cellKey(qint64 cx, qint64 cy){
+    return (cx << 32) ^ quint32(cy);
+}
+
+} // namespace
+
+std::vector<GeometricObject*> IntersectionCreator::applyAll(const std::vector<GeometricObject*>& curves)const{
+    std::vector<int> unbounded, bounded;
+    for(int i=0;i<int(curves.size());++i){
+        switch(curves[i]->getObjectType()){
+        case ObjectType::Line:
+        case ObjectType::Lineo:
+            unbounded.push_back(i);
+            break;
+        case ObjectType::Lineoo:
+        case ObjectType::Circle:
+        case ObjectType::Arc:
+            bounded.push_back(i);
+            break;
+        default:
+            break;
+        }
+    }
+
+    std::vector<std::pair<int,int>> pairs;
+    auto addPair=[&](int i,int j){ pairs.push_back(std::minmax(i,j)); };
+
+    // 直线和射线: 和其它直线/射线两两配对, 和有界曲线先用包围盒排除
+    for(size_t u=0;u<unbounded.size();++u){
+        GeometricObject* line=curves[unbounded[u]];
+        for(size_t v=u+1;v<unbounded.size();++v){
+            if(!parallel(line,curves[unbounded[v]])){
+                addPair(unbounded[u],unbounded[v]);
+            }
+        }
+        for(int b:bounded){
+            if(crossesBox(line,curves[b]->derived().box)){
+                addPair(unbounded[u],b);
+            }
+        }
+    }
+
+    // 有界曲线: 格子大小取包围盒的平均尺寸
+    if(bounded.size()>1){
+        double extent=0;
+        for(int b:bounded){
+            const QRectF& box=curves[b]->derived().box;
+            extent+=std::max(box.width(),box.height());
+        }
+        double cellSize=std::max(extent/bounded.size(),1.0);
+        auto cellOf=[&](double x){ return qint64(std::floor(x/cellSize)); };
+
+        std::unordered_map<qint64,std::vector<int>> cells;
+        std::vector<int> big;
+        for(int b:bounded){
+            const QRectF& box=curves[b]->derived().box;
+            qint64 x0=cellOf(box.left()),x1=cellOf(box.right()),y0=cellOf(box.top()),y1=cellOf(box.bottom());
+            if((x1-x0+1)*(y1-y0+1)>MaxCells){
+                big.push_back(b);
+                continue;
+            }
+            for(qint64 cy=y0;cy<=y1;++cy){
+                for(qint64 cx=x0;cx<=x1;++cx){
+                    cells[cellKey(cx,cy)].push_back(b);
+                }
+            }
+        }
+        for(const auto& [key,members]:cells){
+            for(size_t m=0;m<members.size();++m){
+                const QRectF& box1=curves[members[m]]->derived().box;
+                for(size_t n=m+1;n<members.size();++n){
+                    const QRectF& box2=curves[members[n]]->derived().box;
+                    if(!overlaps(box1,box2)){
+                        continue;
+                    }
+                    // 一对曲线可能同时出现在多个格子里, 只在包含两个包围盒交集左上角的格子里记一次
+                    QPointF corner(std::max(box1.left(),box2.left()),std::max(box1.top(),box2.top()));
+                    if(cellKey(cellOf(corner.x()),cellOf(corner.y()))==key){
+                        addPair(members[m],members[n]);
+                    }
+                }
+            }
+        }
+        for(int b:big){
+            const QRectF& box1=curves[b]->derived().box;
+            for(int o:bounded){
+                if(o==b || (o<b && std::find(big.begin(),big.end(),o)!=big.end())){
+                    continue;
+                }
+                const QRectF& box2=curves[o]->derived().box;
+                if(overlaps(box1,box2)){
+                    addPair(b,o);
+                }
+            }
+        }
+    }
+
+    // 按 curves 中的顺序生成, 结果和选择顺序有关而和哈希表的遍历顺序无关
+    std::sort(pairs.begin(),pairs.end());
+    std::vector<GeometricObject*> ret;
+    for(auto [i,j]:pairs){
+        // 和两个对象的交点工具一样, 暂时不存在的交点也保留 (不合法, 不显示), 曲线移动后可能出现
+        for(auto p:create({curves[i],curves[j]})){
+            p->flush();
+            ret.push_back(p);
+        }
     }
     return ret;
 }
@@ -10,6 +10,12 @@ public:
     IntersectionCreator();
     std::set<GeometricObject*> apply(std::vector<GeometricObject*> objs,
                                       QPointF position = QPointF()) const override;
+    // 两个对象的交点, 按 generation 排列, 还没有 flush
+    std::vector<GeometricObject*> create(std::vector<GeometricObject*> objs) const;
+    // curves 中所有直线/射线/线段/圆/圆弧两两求交, 返回候选对的全部交点 (每个都已 flush 一次, 和 apply 一样包括暂时不存在的)
+    // 有界的曲线按包围盒放进均匀网格, 只有落在同一格子里的才组成候选对;
+    // 直线和射线先用包围盒的四个角是否在同一侧排除不可能相交的曲线
+    std::vector<GeometricObject*> applyAll(const std::vector<GeometricObject*>& curves) const;
 };
 
 #endif // INTERSECTIONCREATOR_H
@@ -0,0 +1,177 @@
+#include "labelregistry.h"
+
+namespace {
+// 按 Kind 下标; Letters 没有前缀, 单独处理
+const char* const Prefixes[] = {nullptr, nullptr, "line_", "ray_", "segment_", "Circle", "Arc"};
+constexpr int MaxLetters = 5;   // 超过 ZZZZZ 的字母标签按普通字符串处理
+constexpr int MaxDigits = 7;    // 9999999 < MaxNumber
+}
+
+LabelPool::LabelPool() {
+    intern(QString());
+}
+
+quint32 LabelPool::intern(const QString& label) {
+    auto it = ids_.constFind(label);
+    if (it != ids_.constEnd()) {
+        return it.value();
+    }
+    quint32 id = quint32(labels_.size());
+    labels_.push_back(label);
+    ids_.insert(label, id);
+    return id;
+}
+
+bool LabelPool::lookup(const QString& label, quint32& id) const {
+    auto it = ids_.constFind(label);
+    if (it == ids_.constEnd()) {
+        return false;
+    }
+    id = it.value();
+    return true;
+}
+
+size_t LabelPool::bytes() const {
+    size_t bytes = labels_.capacity() * sizeof(QString);
+    for (const QString& label : labels_) {
+        bytes += label.capacity() * sizeof(QChar);
+    }
+    return bytes;
+}
+
+LabelRegistry::LabelRegistry() {
+    reset();
+}
+
+void LabelRegistry::reset() {
+    for (quint32& n : next_) {
+        n = 1;
+    }
+}
+
+int LabelRegistry::kindOf(ObjectType type) {
+    switch (type) {
+    case ObjectType::Point: return Letters;
+    case ObjectType::Line: return LineKind;
+    case ObjectType::Lineo: return LineoKind;
+    case ObjectType::Lineoo: return LineooKind;
+    case ObjectType::Circle: return CircleKind;
+    case ObjectType::Arc: return ArcKind;
+    default: return NoKind;
+    }
+}
+
+QString LabelRegistry::text(Code code) const {
+    if (!(code & AutoBit)) {
+        return pool_[code];
+    }
+    int kind = (code >> 24) & 0x7F;
+    quint32 n = code & MaxNumber;
+    if (kind != Letters) {
+        return QLatin1String(Prefixes[kind]) + QString::number(n);
+    }
+    // 双射 26 进制: 1 -> A, 26 -> Z, 27 -> AA
+    char buffer[8];
+    int i = sizeof(buffer);
+    while (n > 0) {
+        buffer[--i] = char('A' + (n - 1) % 26);
+        n = (n - 1) / 26;
+    }
+    return QString::fromLatin1(buffer + i, int(sizeof(buffer)) - i);
+}
+
+bool LabelRegistry::parse(const QString& label, Code& code) {
+    int length = label.size();
+    if (length == 0) {
+        return false;
+    }
+    bool letters = length <= MaxLetters;
+    for (int i = 0; letters && i < length; ++i) {
+        letters = label[i] >= QLatin1Char('A') && label[i] <= QLatin1Char('Z');
+    }
+    if (letters) {
+        quint32 n = 0;
+        for (QChar c : label) {
+            n = n * 26 + (c.unicode() - 'A' + 1);
+        }
+        code = autoCode(Letters, n);
+        return true;
+    }
+    for (int kind = LineKind; kind < KindCount; ++kind) {
+        QLatin1String prefix(Prefixes[kind]);
+        int digits = length - prefix.size();
+        if (digits <= 0 || digits > MaxDigits || !label.startsWith(prefix) || label[prefix.size()] == QLatin1Char('0')) {
+            continue;
+        }
+        quint32 n = 0;
+        int i = prefix.size();
+        for (; i < length && label[i].isDigit() && label[i].unicode() < 128; ++i) {
+            n = n * 10 + (label[i].unicode() - '0');
+        }
+        if (i == length) {
+            code = autoCode(kind, n);
+            return true;
+        }
+    }
+    return false;
+}
+
+LabelRegistry::Code LabelRegistry::encode(const QString& label) {
+    Code code;
+    if (parse(label, code)) {
+        return code;
+    }
+    return pool_.intern(label);
+}
+
+LabelRegistry::Code LabelRegistry::peek(ObjectType type) const {
+    int kind = kindOf(type);
+    if (kind == NoKind) {
+        return 0;
+    }
+    for (quint32 n = next_[kind]; n <= MaxNumber; ++n) {
+        Code code = autoCode(kind, n);
+        if (!isUsed(code)) {
+            return code;
+        }
+    }
+    return 0;   // 一千六百万个编号都用完了
+}
+
+LabelRegistry::Code LabelRegistry::take(ObjectType type) {
+    Code code = peek(type);
+    if (code & AutoBit) {
+        next_[kindOf(type)] = (code & MaxNumber) + 1;
+    }
+    return code;
+}
+
+bool LabelRegistry::bind(Code code, GeometricObject* obj) {
+    if (code == 0) {
+        return true;        // 字符串池的 0 号是空标签
+    }
+    auto it = index_.emplace(code, obj).first;
+    return it->second == obj;
+}
+
+void LabelRegistry::unbind(Code code, GeometricObject* obj) {
+    auto it = index_.find(code);
+    if (it != index_.end() && it->second == obj) {
+        index_.erase(it);
+    }
+}
+
+GeometricObject* LabelRegistry::find(const QString& label) const {
+    Code code;
+    if (!parse(label, code) && !pool_.lookup(label, code)) {
+        return nullptr;     // 没有人用过的标签, 不加入字符串池
+    }
+    auto it = index_.find(code);
+    return it == index_.end() ? nullptr : it->second;
+}
+
+size_t LabelRegistry::bytes() const {
+    // 每个索引节点大约是键, 指针和 next 指针, 再加上桶数组
+    return sizeof(next_) + pool_.bytes() +
+           index_.size() * (sizeof(Code) + 2 * sizeof(void*)) + index_.bucket_count() * sizeof(void*);
+}
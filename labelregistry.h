@@ -0,0 +1,79 @@
+#ifndef LABELREGISTRY_H
+#define LABELREGISTRY_H
+
+#include <QHash>
+#include <QString>
+#include <unordered_map>
+#include <vector>
+#include "objecttype.h"
+
+class GeometricObject;
+
+// 标签的字符串池: 用户起的标签只存一份 (例如反复应用自定义工具得到的辅助对象);
+// 只增不减, 改名前的旧字符串保留到对象表销毁
+class LabelPool {
+public:
+    LabelPool();
+    quint32 intern(const QString& label);
+    bool lookup(const QString& label, quint32& id) const;
+    const QString& operator[](quint32 id) const { return labels_[id]; }
+    size_t size() const { return labels_.size(); }
+    size_t bytes() const;
+
+private:
+    std::vector<QString> labels_;
+    QHash<QString, quint32> ids_;
+};
+
+// 一个文档的标签
+// 自动标签 (A, B, ..., AA; line_1; ray_1; segment_1; Circle1; Arc1) 只存种类和序号, 显示时才格式化,
+// 创建对象时不分配字符串; 其它标签放在 LabelPool 里. 两种标签统一编码成 32 位的 Code,
+// 文字相同的标签编码相同, 所以 "B" 无论是自动生成的还是用户输入的都是同一个编码
+// 文档里的正式对象 (不是临时对象或辅助对象, 也不是只存在于撤销记录中的对象) 把自己的编码登记到索引中:
+// 每个标签最多属于一个对象, 按名字查找是 O(1), 自动编号会跳过已被占用的标签
+class LabelRegistry {
+public:
+    typedef quint32 Code;
+
+    LabelRegistry();
+
+    QString text(Code code) const;
+    // 标签的编码, 需要时加入字符串池
+    Code encode(const QString& label);
+
+    // 该类型下一个没有被占用的自动标签, 不改变计数器; 没有自动标签的类型 (度量) 返回空标签
+    Code peek(ObjectType type) const;
+    // 同上, 之后的自动编号从它的下一个开始
+    Code take(ObjectType type);
+    // 计数器的当前值; 生成一批候选对象再删掉大部分时, 用 restore 回到生成之前
+    quint32 mark(ObjectType type) const { return next_[kindOf(type)]; }
+    void restore(ObjectType type, quint32 mark) { next_[kindOf(type)] = mark; }
+    // 所有计数器回到 1 (A, line_1, ...); 字符串池和索引不变
+    void reset();
+
+    // code 已被其它对象占用时不登记并返回 false; 空标签不登记, 总是成功
+    bool bind(Code code, GeometricObject* obj);
+    void unbind(Code code, GeometricObject* obj);
+    bool isUsed(Code code) const { return index_.count(code) > 0; }
+    // 标签为 label 的对象, 没有时返回 nullptr
+    GeometricObject* find(const QString& label) const;
+
+    size_t size() const { return pool_.size(); }
+    size_t bytes() const;
+
+private:
+    enum Kind { NoKind, Letters, LineKind, LineoKind, LineooKind, CircleKind, ArcKind, KindCount };
+    static const Code AutoBit = 0x80000000u;
+    static const quint32 MaxNumber = 0x00FFFFFFu;
+
+    static int kindOf(ObjectType type);
+    static Code autoCode(int kind, quint32 n) { return AutoBit | Code(kind) << 24 | n; }
+    // label 是某种自动标签时给出它的编码, 例如 "segment_12", "AB"; "segment_012" 不算
+    static bool parse(const QString& label, Code& code);
+
+    quint32 next_[KindCount];
+    LabelPool pool_;
+    std::unordered_map<Code, GeometricObject*> index_;
+};
+
+#endif // LABELREGISTRY_H
@@ -0,0 +1,30 @@
+#include "layerset.h"
+
+int LayerSet::find(const QString& name) const {
+    for (int i = 0; i < size(); ++i) {
+        if (layers_[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int LayerSet::add(const QString& name) {
+    if (size() >= MaxLayers) {
+        return -1;
+    }
+    layers_.push_back({name, true, 0});
+    return size() - 1;
+}
+
+void LayerSet::touchAll() {
+    for (Layer& layer : layers_) {
+        ++layer.revision;
+    }
+}
+
+void LayerSet::reset() {
+    layers_.clear();
+    layers_.push_back({"default", true, 0});
+    current_ = 0;
+}
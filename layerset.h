@@ -0,0 +1,49 @@
+#ifndef LAYERSET_H
+#define LAYERSET_H
+
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+
+// 一个文档的图层 (例如作图, 注释, 答案): 每个对象属于一个图层, 新对象放在当前图层
+// 显示/隐藏整个图层只改这里的一个标志, 不遍历对象; 各图层的 revision 在其中的对象
+// 看起来变了时增加 (算完后的几何, 选中, 悬停, 显示, 样式, 标签, 对象进出图层), Canvas 据此决定哪个图层的缓存要重画
+// 只在 GUI 线程上修改
+class LayerSet {
+public:
+    static const int MaxLayers = 256;   // 对象里用 8 位存图层编号
+
+    LayerSet() { reset(); }
+
+    int size() const { return int(layers_.size()); }
+    const QString& name(int layer) const { return layers_[layer].name; }
+    void setName(int layer, const QString& name) { layers_[layer].name = name; }
+    // 没有这个名字的图层时返回 -1
+    int find(const QString& name) const;
+    // 新建图层并返回它的编号; 图层已满时返回 -1
+    int add(const QString& name);
+
+    bool isVisible(int layer) const { return layers_[layer].visible; }
+    void setVisible(int layer, bool visible) { layers_[layer].visible = visible; }
+
+    int current() const { return current_; }
+    void setCurrent(int layer) { current_ = layer; }
+
+    quint64 revision(int layer) const { return layers_[layer].revision; }
+    void touch(int layer) { ++layers_[layer].revision; }
+    void touchAll();
+
+    // 只剩一个显示着的默认图层
+    void reset();
+
+private:
+    struct Layer {
+        QString name;
+        bool visible = true;
+        quint64 revision = 0;
+    };
+    std::vector<Layer> layers_;
+    int current_ = 0;
+};
+
+#endif // LAYERSET_H
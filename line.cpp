@@ -7,8 +7,7 @@
 #include "circle.h"
 #include "calculator.h"
 
-void drawExtendedLine(QPainter* painter, const QPointF& p1, const QPointF& p2) {
-    QRectF bounds = painter->viewport();
+bool clipExtendedLine(const QRectF& bounds, const QPointF& p1, const QPointF& p2, QPointF& a, QPointF& b) {
     qreal minX = bounds.left();
     qreal maxX = bounds.right();
     qreal minY = bounds.top();
@@ -71,26 +70,37 @@ void drawExtendedLine(QPainter* painter, const QPointF& p1, const QPointF& p2) {
                     }
                 }
             }
-            painter->drawLine(intersections[idx1], intersections[idx2]);
+            a = intersections[idx1];
+            b = intersections[idx2];
         } else {
-            painter->drawLine(intersections[0], intersections[1]);
+            a = intersections[0];
+            b = intersections[1];
         }
+        return true;
+    }
+    return false;
+}
+
+void drawExtendedLine(QPainter* painter, const QPointF& p1, const QPointF& p2) {
+    QPointF a, b;
+    if (clipExtendedLine(paintableRect(painter), p1, p2, a, b)) {
+        painter->drawLine(a, b);
     }
 }
 
 Line::Line(const std::vector<GeometricObject*>& parents, const int& generation, bool isTemp, bool aux)
-    : GeometricObject(ObjectName::Line, aux){
+    : GeometricObject(tableOf(parents), ObjectName::Line, aux){
     for(auto iter: parents){
         addParent(iter);
     }
     generation_=generation;
     if (!isTemp and !aux) {
-        GetDefaultLable[ObjectType::Line]=nextLineLable(GetDefaultLable[ObjectType::Line]);
+        takeDefaultLabel();
     }
 }
 
 Qt::PenStyle Line::getPenStyle()const{
-    switch(shape_){
+    switch(getShape()){
     case 0:return Qt::SolidLine;
     case 1:return Qt::DashLine;
     case 2:return Qt::DotLine;
@@ -105,18 +115,18 @@ void Line::draw(QPainter* painter) const {
     auto ppp=getTwoPoints();
     auto P1=ppp.first,P2=ppp.second;
 
-    if (!labelhidden_) {
+    if (!islablehidden() && renderOptions.labels) {
         painter->setPen(Qt::black);
         painter->drawText((P1.x()+P2.x())/2 + 6,
                           (P1.y()+P2.y())/2 - 6,
-                          label_);
+                          getLabel());
     }
 
     QPen pen; // 创建一个QPen对象用于绘制
 
-    long double add=((int)hovered_)*HOVER_ADD_WIDTH;
+    Real add=((int)drawsHovered())*HOVER_ADD_WIDTH;
 
-    if(selected_){
+    if(drawsSelected() && !renderOptions.draft){
         QColor selectcolor=getColor().lighter(250);
         selectcolor.setAlpha(128);
         pen.setColor(selectcolor);
@@ -134,18 +144,19 @@ void Line::draw(QPainter* painter) const {
     return;
 }
 
-// 辅助函数：计算点 p 到直线 p1p2 的距离
-long double Line::distanceToLine(const QPointF& p, const std::pair<QPointF,QPointF>& Points) const {
-    long double x1=Points.first.x(),x2=Points.second.x(),y1=Points.first.y(),y2=Points.second.y();
-    long double X=p.x(),Y=p.y();
-    return std::abs((y2-y1)*X+(x1-x2)*Y+y1*x2-y2*x1)/std::sqrt((y2-y1)*(y2-y1)+(x1-x2)*(x1-x2));
+// 辅助函数：计算点 p 到直线 p1p2 的距离 (法向量在 flush 时已经算好)
+Real Line::distanceToLine(const QPointF& p) const {
+    if (derived_.length == 0) {
+        return len(p - position_[0]); // 两个定义点重合时没有方向
+    }
+    return std::abs(QPointF::dotProduct(p - position_[0], derived_.normal));
 }
 
 
 bool Line::isNear(const QPointF& pos) const {
     if (!isShown()) return false; // 如果对象隐藏，则认为不在附近
     // 判断点到线段的距离是否小于容差值 (容差值考虑了线的厚度)
-    return distanceToLine(pos, getTwoPoints()) < ( 1e-2 + getSize() );
+    return distanceToLine(pos) < ( 1e-2 + getSize() );
 }
 
 QPointF Line::position() const {
@@ -153,149 +164,145 @@ QPointF Line::position() const {
 }
 
 inline std::pair<const QPointF,const QPointF> zhongchui(std::pair<const QPointF&,const QPointF&> ppp){
-    long double x1=ppp.first.x(),x2=ppp.second.x(),y1=ppp.first.y(),y2=ppp.second.y();
+    Real x1=ppp.first.x(),x2=ppp.second.x(),y1=ppp.first.y(),y2=ppp.second.y();
     return std::make_pair(QPointF((x1+x2)/2.0,(y1+y2)/2.0),
                           QPointF((x1+x2)/2.0+y2-y1,(y1+y2)/2.0+x1-x2));
 }
 
+Line::Kernel Line::resolveKernel(){
+    switch(generation_){
+    case -4:
+        return expectParentNum(2) ? &Line::flushCentralSymmetry : &Line::flushInvalid;
+    case -3:
+        return expectParentNum(2) ? &Line::flushAxialSymmetry : &Line::flushInvalid;
+    case 0:
+        return expectParentNum(2) ? &Line::flushThroughPoints : &Line::flushInvalid;
+    case 1:
+        return expectParentNum(2) ? &Line::flushBisectorOfPoints : &Line::flushInvalid;
+    case 2:
+        return expectParentNum(1) ? &Line::flushBisectorOfSegment : &Line::flushInvalid;
+    case 3://缺少三点
+        if(!parents_.empty() && parents_[0]->getObjectType()==ObjectType::Point){
+            return expectParentNum(3) ? &Line::flushParallelToPoints : &Line::flushInvalid;
+        }
+        return expectParentNum(2) ? &Line::flushParallelToLine : &Line::flushInvalid;
+    case 6:
+        return expectParentNum(2) ? &Line::flushPerpendicular : &Line::flushInvalid;
+    case 7:
+        return expectParentNum(2) ? &Line::flushTangentAtPoint : &Line::flushInvalid;
+    case 8:
+    case 9:
+        return expectParentNum(2) ? &Line::flushTangentFromPoint : &Line::flushInvalid;
+    default:
+        reportError("line的flush方法没有完成!");
+        return &Line::flushInvalid;
+    }
+}
+
 GeometricObject* Line::flush(){
     position_.clear();
-    legal_=true;
+    setLegal(true);
     for(auto iter:parents_){
         if(!iter->isLegal()){
-            legal_=false;
+            setLegal(false);
             position_.push_back(QPointF());
             position_.push_back(QPointF(1,1));
+            updateDerived(); // 和 flushInvalid 一样由占位的两个点算, 不留上一次合法时的结果
             return this;
         }
     }
-    switch(generation_){
-    case -4:{
-        position_.push_back(2*parents_[1]->position()-parents_[0]->getTwoPoints().first);
-        position_.push_back(2*parents_[1]->position()-parents_[0]->getTwoPoints().second);
-        return this;
-    }
-    case -3:{
-        position_.push_back(reflect(parents_[0]->getTwoPoints().first,parents_[1]->getTwoPoints()));
-        position_.push_back(reflect(parents_[0]->getTwoPoints().second,parents_[1]->getTwoPoints()));
-        return this;
-    }
-    case 0:
-        position_.push_back(parents_[0]->position());
-        position_.push_back(parents_[1]->position());
-        return this;
-    case 1:{
-        auto pair = zhongchui(std::make_pair(parents_[0]->position(),parents_[1]->position()));
-        position_.push_back(pair.first);
-        position_.push_back(pair.second);
-        return this;
+    if(!kernel_){
+        kernel_=resolveKernel();
     }
-    case 2:{
-        auto pair = zhongchui(parents_[0]->getTwoPoints());
-        position_.push_back(pair.first);
-        position_.push_back(pair.second);
-        return this;
-    }
-    case 3:{//缺少三点
-        QPointF P1,P2,P3;
-        if(parents_[0]->getObjectType()==ObjectType::Point){
-            expectParentNum(3);
-            P1=parents_[0]->position();
-            P2=parents_[1]->position();
-            P3=parents_[2]->position();
-        }
-        else{
-            expectParentNum(2);
-            auto ppp=parents_[0]->getTwoPoints();
-            P1=ppp.first,P2=ppp.second;
-            P3=parents_[1]->position();
-        }
-        position_.push_back(P3);
-        position_.push_back(QPointF(P3.x()+P1.x()-P2.x(),P3.y()+P1.y()-P2.y()));
-        return this;
-    }
-    case 6:{
-        expectParentNum(2);
-        QPointF P1 = parents_[0]->position();
-        auto p = parents_[1]->getTwoPoints();
-        QPointF P2 = p.first, P3 = p.second;
-        if (P2.y() == P3.y()){
-            position_.push_back(P1);
-            position_.push_back(QPointF(P1.x(), P2.y() + 200));
-            return this;
-        } else {
-            position_.push_back(P1);
-            position_.push_back(QPointF(P3.y() - P2.y() + P1.x(), P1.y() + P2.x() - P3.x()));
-            return this;
-        }
-    }
-    case 7:{
-        expectParentNum(2);
-        QPointF P2 = parents_[1]->position(), P3 = parents_[0]->position();
-        QPointF P1 = P3;
-        if (P2.y() == P3.y()){
-            position_.push_back(P1);
-            position_.push_back(QPointF(P1.x(), P2.y() + 200));
-            return this;
-        } else {
-            position_.push_back(P1);
-            position_.push_back(QPointF(P3.y() - P2.y() + P1.x(), P1.y() + P2.x() - P3.x()));
-            return this;
-        }
+    (this->*kernel_)();
+    updateDerived();
+    return this;
+}
+
+void Line::flushInvalid(){
+    setLegal(false);
+    position_.push_back(QPointF());
+    position_.push_back(QPointF(1,1));
+}
+
+void Line::flushThroughPoints(){
+    position_.push_back(parents_[0]->position());
+    position_.push_back(parents_[1]->position());
+}
+
+void Line::flushBisectorOfPoints(){
+    auto pair = zhongchui(std::make_pair(parents_[0]->position(),parents_[1]->position()));
+    position_.push_back(pair.first);
+    position_.push_back(pair.second);
+}
+
+void Line::flushBisectorOfSegment(){
+    auto pair = zhongchui(parents_[0]->getTwoPoints());
+    position_.push_back(pair.first);
+    position_.push_back(pair.second);
+}
+
+void Line::flushParallelToPoints(){
+    QPointF P1=parents_[0]->position();
+    QPointF P2=parents_[1]->position();
+    QPointF P3=parents_[2]->position();
+    position_.push_back(P3);
+    position_.push_back(QPointF(P3.x()+P1.x()-P2.x(),P3.y()+P1.y()-P2.y()));
+}
+
+void Line::flushParallelToLine(){
+    auto ppp=parents_[0]->getTwoPoints();
+    QPointF P1=ppp.first,P2=ppp.second;
+    QPointF P3=parents_[1]->position();
+    position_.push_back(P3);
+    position_.push_back(QPointF(P3.x()+P1.x()-P2.x(),P3.y()+P1.y()-P2.y()));
+}
+
+void Line::flushPerpendicular(){
+    QPointF P1 = parents_[0]->position();
+    auto p = parents_[1]->getTwoPoints();
+    QPointF P2 = p.first, P3 = p.second;
+    position_.push_back(P1);
+    if (P2.y() == P3.y()){
+        position_.push_back(QPointF(P1.x(), P2.y() + 200));
+    } else {
+        position_.push_back(QPointF(P3.y() - P2.y() + P1.x(), P1.y() + P2.x() - P3.x()));
     }
-    case 8:{
-        expectParentNum(2);
-        GeometricObject* circle = parents_[1];
-        QPointF P1 = parents_[0]->position(), P2 = circle->position();
-        long double radius = len(circle->getTwoPoints());
-        long double dist1 = std::sqrt(std::pow(P1.x() - P2.x(), 2) + std::pow(P1.y() - P2.y(), 2));
-        if (dist1 * dist1 - radius * radius < 0){
-            legal_ = false;
-            position_.push_back(QPointF(1, 1));
-            position_.push_back(QPointF(2, 2));
-            return this;
-        }
-        legal_ = true;
-        long double dist2 = std::sqrt(dist1 * dist1 - radius * radius);
-        QPointF direction1 = P2 - P1, direction2 = QPointF(-direction1.y(), direction1.x());
-        QPointF P3 = P1 + direction1 * dist2 / dist1 + direction2 * radius / dist1;
-        position_.push_back(P1);
-        position_.push_back(P3);
-        if(parents_[1]->getObjectType()==ObjectType::Arc and !thetainst(normalizeAngle(Theta(P3-P1)-PI_2),dynamic_cast<Arc*>(circle)->getAngles())){
-            legal_=false;
-        }
-        return this;
+}
+
+void Line::flushTangentAtPoint(){
+    QPointF P2 = parents_[1]->position(), P3 = parents_[0]->position();
+    QPointF P1 = P3;
+    position_.push_back(P1);
+    if (P2.y() == P3.y()){
+        position_.push_back(QPointF(P1.x(), P2.y() + 200));
+    } else {
+        position_.push_back(QPointF(P3.y() - P2.y() + P1.x(), P1.y() + P2.x() - P3.x()));
     }
-    case 9:{
-        expectParentNum(2);
-        GeometricObject* circle = parents_[1];
-        QPointF P1 = parents_[0]->position(), P2 = circle->position();
-        long double radius = len(circle->getTwoPoints());
-        long double dist1 = std::sqrt(std::pow(P1.x() - P2.x(), 2) + std::pow(P1.y() - P2.y(), 2));
-        if (dist1 * dist1 - radius * radius < 0){
-            legal_ = false;
-            position_.push_back(QPointF(1, 1));
-            position_.push_back(QPointF(2, 2));
-            return this;
-        }
-        legal_ = true;
-        long double dist2 = std::sqrt(dist1 * dist1 - radius * radius);
-        QPointF direction1 = P2 - P1, direction2 = QPointF(-direction1.y(), direction1.x());
-        QPointF P3 = P1 + direction1 * dist2 / dist1 - direction2 * radius / dist1;
-        position_.push_back(P1);
-        position_.push_back(P3);
-        if(parents_[1]->getObjectType()==ObjectType::Arc and !thetainst(normalizeAngle(Theta(P3-P1)+PI_2),dynamic_cast<Arc*>(circle)->getAngles())){
-            legal_=false;
-        }
-        return this;
+}
+
+void Line::flushTangentFromPoint(){
+    GeometricObject* circle = parents_[1];
+    QPointF P1 = parents_[0]->position(), P2 = circle->position();
+    Real radius = len(circle->getTwoPoints());
+    Real dist1 = std::sqrt(std::pow(P1.x() - P2.x(), 2) + std::pow(P1.y() - P2.y(), 2));
+    if (dist1 * dist1 - radius * radius < 0){
+        setLegal(false);
+        position_.push_back(QPointF(1, 1));
+        position_.push_back(QPointF(2, 2));
+        return;
     }
-    default:
-        break;
+    // 8 和 9 分别是两侧的切线
+    int side = generation_ == 8 ? 1 : -1;
+    Real dist2 = std::sqrt(dist1 * dist1 - radius * radius);
+    QPointF direction1 = P2 - P1, direction2 = QPointF(-direction1.y(), direction1.x());
+    QPointF P3 = P1 + direction1 * dist2 / dist1 + side * direction2 * radius / dist1;
+    position_.push_back(P1);
+    position_.push_back(P3);
+    // 切点 P3 相对圆心的方向要在圆弧范围内
+    if(circle->getObjectType()==ObjectType::Arc and !static_cast<Arc*>(circle)->containsDirection(P3)){
+        setLegal(false);
     }
-    QMessageBox::warning(nullptr, "警告", "line的flush方法没有完成!");
-    position_.push_back(QPointF());
-    position_.push_back(QPointF(1,1));
-    return this;
 }
 std::pair<const QPointF,const QPointF> Line::getTwoPoints() const{
     return std::make_pair(position_[0],position_[1]);
@@ -319,10 +326,20 @@ std::set<GeometricObject*> LineCreator::wait(std::vector<GeometricObject*> objs)
     return { new Line(objs, 0, true) };
 }
 
+QRectF Line::boundingRect(const QRectF& viewport) const {
+    auto [P1, P2] = getTwoPoints();
+    QRectF ret = labelRect(QPointF((P1.x()+P2.x())/2 + 6, (P1.y()+P2.y())/2 - 6));
+    QPointF a, b;
+    if (clipExtendedLine(viewport, P1, P2, a, b)) {
+        ret = ret.united(strokeRect(QRectF(a, b)));
+    }
+    return ret;
+}
+
 bool Line::isTouchedByRectangle(const QPointF& start, const QPointF& end) const {
     auto p = getTwoPoints();
-    long double x1 = p.first.x(), x2 = p.second.x(), y1 = p.first.y(), y2 = p.second.y();
-    long double a = y1 - y2, b = x2 - x1, c = y2*x1 - y1*x2;
+    Real x1 = p.first.x(), x2 = p.second.x(), y1 = p.first.y(), y2 = p.second.y();
+    Real a = y1 - y2, b = x2 - x1, c = y2*x1 - y1*x2;
     std::vector<QPointF> v = {start, end, QPointF(start.x(), end.y()), QPointF(end.x(), start.y())};
     std::set<int> sgn;
     for (auto point : v){
@@ -24,13 +24,32 @@ public:
 
     GeometricObject* flush() override;
     virtual bool isTouchedByRectangle(const QPointF& start, const QPointF& end) const override;
+    QRectF boundingRect(const QRectF& viewport) const override;
 
 protected:
     // isNear 计算的辅助函数 (点到线段的距离)
     Qt::PenStyle getPenStyle()const;
-    long double distanceToLine(const QPointF& p,const std::pair<QPointF,QPointF>& Points) const;
+    Real distanceToLine(const QPointF& p) const;
+
+    // flush 的计算核心, 第一次 flush 时根据 generation_ 解析一次
+    typedef void (Line::*Kernel)();
+    Kernel kernel_ = nullptr;
+    Kernel resolveKernel();
+    void flushInvalid();
+    void flushThroughPoints();
+    void flushBisectorOfPoints();
+    void flushBisectorOfSegment();
+    void flushParallelToPoints();
+    void flushParallelToLine();
+    void flushPerpendicular();
+    void flushTangentAtPoint();
+    void flushTangentFromPoint();
 };
 
+// 把直线 p1p2 裁剪到 bounds 内, 得到端点 a, b; 直线不经过 bounds 时返回 false
+bool clipExtendedLine(const QRectF& bounds, const QPointF& p1, const QPointF& p2, QPointF& a, QPointF& b);
+void drawExtendedLine(QPainter* painter, const QPointF& p1, const QPointF& p2);
+
 //line的shape:
 //0实线, 1虚线, 2点线
 
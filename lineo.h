@@ -25,13 +25,26 @@ public:
 
     GeometricObject* flush() override;
     virtual bool isTouchedByRectangle(const QPointF& start, const QPointF& end) const override;
+    QRectF boundingRect(const QRectF& viewport) const override;
 
 protected:
     // isNear 计算的辅助函数 (点到线段的距离)
     Qt::PenStyle getPenStyle()const;
-    long double distanceToLineo(const QPointF& p,const std::pair<QPointF,QPointF>& Points) const;
+    Real distanceToLineo(const QPointF& p) const;
+
+    // flush 的计算核心, 第一次 flush 时根据 generation_ 解析一次
+    typedef void (Lineo::*Kernel)();
+    Kernel kernel_ = nullptr;
+    Kernel resolveKernel();
+    void flushInvalid();
+    void flushThroughPoints();
+    void flushAngleBisector();
 };
 
+// 射线 p1p2 (p1为顶点) 延伸到 bounds 边界的终点
+bool clipExtendedLineo(const QRectF& bounds, const QPointF& p1, const QPointF& p2, QPointF& end);
+void drawExtendedLineo(QPainter* painter, const QPointF& p1, const QPointF& p2);
+
 //Lineo的shape:
 //0实线, 1虚线, 2点线
 
@@ -3,18 +3,18 @@
 #include "calculator.h"
 
 Lineoo::Lineoo(const std::vector<GeometricObject*>& parents, const int& generation, bool isTemp, bool aux)
-    : GeometricObject(ObjectName::Lineoo, aux){
+    : GeometricObject(tableOf(parents), ObjectName::Lineoo, aux){
     for(auto iter: parents){
         addParent(iter);
     }
     generation_=generation;
     if (!isTemp and !aux){
-        GetDefaultLable[ObjectType::Lineoo]=nextLineLable(GetDefaultLable[ObjectType::Lineoo]);
+        takeDefaultLabel();
     }
 }
 
 Qt::PenStyle Lineoo::getPenStyle()const{
-    switch(shape_){
+    switch(getShape()){
     case 0:return Qt::SolidLine;
     case 1:return Qt::DashLine;
     case 2:return Qt::DotLine;
@@ -29,20 +29,20 @@ void Lineoo::draw(QPainter* painter) const {
     auto ppp=getTwoPoints();
     auto P1=ppp.first,P2=ppp.second;
 
-    if (!labelhidden_) {
+    if (!islablehidden() && renderOptions.labels) {
         painter->setPen(Qt::black);
         painter->drawText((P1.x()+P2.x())/2 + 6,
                           (P1.y()+P2.y())/2 - 6,
-                          label_);
+                          getLabel());
     }
 
 
 
     QPen pen; // 创建一个QPen对象用于绘制
 
-    long double add=((int)hovered_)*HOVER_ADD_WIDTH;
+    Real add=((int)drawsHovered())*HOVER_ADD_WIDTH;
 
-    if(selected_){
+    if(drawsSelected() && !renderOptions.draft){
         QColor selectcolor=getColor().lighter(250);
         selectcolor.setAlpha(128);
         pen.setColor(selectcolor);
@@ -61,77 +61,77 @@ void Lineoo::draw(QPainter* painter) const {
 }
 
 // 辅助函数：计算点 p 到直线 p1p2 的距离
-long double Lineoo::distanceToLineoo(const QPointF& p, const std::pair<QPointF,QPointF>& Points) const {
-    long double x1=Points.first.x(),x2=Points.second.x(),y1=Points.first.y(),y2=Points.second.y();
-    long double X=p.x(),Y=p.y();
-    long double A = X - x1;
-    long double B = Y - y1;
-    long double C = x2 - x1;
-    long double D = y2 - y1;
-
-    // 线段长度的平方
-    long double dot = C * C + D * D;
-    // 计算投影比例 t
-    long double t = (A * C + B * D) / dot;
-
-    if (t < 0) {
-        // 点在端点1的一侧
-        return sqrt(A * A + B * B);
+Real Lineoo::distanceToLineoo(const QPointF& p) const {
+    // 沿线段方向的投影长度, 单位向量和长度在 flush 时已经算好
+    QPointF A = p - position_[0];
+    Real t = QPointF::dotProduct(A, derived_.unit);
+
+    if (t < 0 || derived_.length == 0) {
+        // 点在端点1的一侧 (或线段退化成一个点)
+        return len(A);
     }
-    if (t > 1) {
+    if (t > derived_.length) {
         // 点在端点2的一侧
-        return sqrt((X - x2) * (X - x2) + (Y - y2) * (Y - y2));
+        return len(p - position_[1]);
     }
 
     // 点在线段之间，计算点到直线距离
-    long double E = x1 + t * C;
-    long double F = y1 + t * D;
-    return sqrt((X - E) * (X - E) + (Y - F) * (Y - F));
+    return std::abs(QPointF::dotProduct(A, derived_.normal));
 }
 
 bool Lineoo::isNear(const QPointF& pos) const {
     if (!isShown()) return false; // 如果对象隐藏，则认为不在附近
     // 判断点到线段的距离是否小于容差值 (容差值考虑了线的厚度)
-    return distanceToLineoo(pos, getTwoPoints()) < (1e-2 + getSize() );
+    return distanceToLineoo(pos) < (1e-2 + getSize() );
 }
 
 QPointF Lineoo::position() const {
     return getTwoPoints().first;
 }
 
+Lineoo::Kernel Lineoo::resolveKernel(){
+    switch(generation_){
+    case -4:
+        return expectParentNum(2) ? &Lineoo::flushCentralSymmetry : &Lineoo::flushInvalid;
+    case -3:
+        return expectParentNum(2) ? &Lineoo::flushAxialSymmetry : &Lineoo::flushInvalid;
+    case 0:
+        return expectParentNum(2) ? &Lineoo::flushThroughPoints : &Lineoo::flushInvalid;
+    default:
+        reportError("lineoo的flush方法没有完成!");
+        return &Lineoo::flushInvalid;
+    }
+}
+
 GeometricObject* Lineoo::flush(){
     position_.clear();
-    legal_=true;
+    setLegal(true);
     for(auto iter:parents_){
         if(!iter->isLegal()){
-            legal_=false;
+            setLegal(false);
             position_.push_back(QPointF());
             position_.push_back(QPointF(1,1));
+            updateDerived(); // 和 flushInvalid 一样由占位的两个点算, 不留上一次合法时的结果
             return this;
         }
     }
-    switch(generation_){
-    case -4:{
-        position_.push_back(2*parents_[1]->position()-parents_[0]->getTwoPoints().first);
-        position_.push_back(2*parents_[1]->position()-parents_[0]->getTwoPoints().second);
-        return this;
-    }
-    case -3:{
-        position_.push_back(reflect(parents_[0]->getTwoPoints().first,parents_[1]->getTwoPoints()));
-        position_.push_back(reflect(parents_[0]->getTwoPoints().second,parents_[1]->getTwoPoints()));
-        return this;
+    if(!kernel_){
+        kernel_=resolveKernel();
     }
-    case 0:
-        position_.push_back(parents_[0]->position());
-        position_.push_back(parents_[1]->position());
-        return this;
-    default:
-        break;
-    }
-    QMessageBox::warning(nullptr, "警告", "lineoo的flush方法没有完成!");
+    (this->*kernel_)();
+    updateDerived();
+    return this;
+}
+
+void Lineoo::flushInvalid(){
+    setLegal(false);
     position_.push_back(QPointF());
     position_.push_back(QPointF(1,1));
-    return this;
+}
+
+void Lineoo::flushThroughPoints(){
+    position_.push_back(parents_[0]->position());
+    position_.push_back(parents_[1]->position());
 }
 
 std::pair<const QPointF,const QPointF> Lineoo::getTwoPoints() const{
@@ -157,11 +157,17 @@ std::set<GeometricObject*> LineooCreator::wait(std::vector<GeometricObject*> obj
 }
 
 
+QRectF Lineoo::boundingRect(const QRectF& viewport) const {
+    Q_UNUSED(viewport);
+    auto [P1, P2] = getTwoPoints();
+    return strokeRect(QRectF(P1, P2)).united(labelRect(QPointF((P1.x()+P2.x())/2 + 6, (P1.y()+P2.y())/2 - 6)));
+}
+
 bool Lineoo::isTouchedByRectangle(const QPointF& start, const QPointF& end) const {
     auto p = getTwoPoints();
-    long double x1 = p.first.x(), x2 = p.second.x();
-    long double y1 = p.first.y(), y2 = p.second.y();
-    long double a = y1 - y2, b = x2 - x1, c = y2*x1 - y1*x2;
+    Real x1 = p.first.x(), x2 = p.second.x();
+    Real y1 = p.first.y(), y2 = p.second.y();
+    Real a = y1 - y2, b = x2 - x1, c = y2*x1 - y1*x2;
     std::vector<QPointF> v = {start, end, QPointF(start.x(), end.y()), QPointF(end.x(), start.y())};
     std::set<int> sgn;
     for (auto point : v){
@@ -176,8 +182,8 @@ bool Lineoo::isTouchedByRectangle(const QPointF& start, const QPointF& end) cons
     if (sgn.size() < 2){
         return false;
     }
-    long double largerX = std::max(start.x(), end.x()), smallerX = std::min(start.x(), end.x());
-    long double largerY = std::max(start.y(), end.y()), smallerY = std::min(start.y(), end.y());
+    Real largerX = std::max(start.x(), end.x()), smallerX = std::min(start.x(), end.x());
+    Real largerY = std::max(start.y(), end.y()), smallerY = std::min(start.y(), end.y());
     if ((x1 > largerX and x2 > largerX) or (x1 < smallerX and x2 < smallerX) or
         (y1 > largerY and y2 > largerY) or (y1 < smallerY and y2 < smallerY)){
         return false;
@@ -11,8 +11,8 @@
 #include <QMessageBox>
 #include "calculator.h"
 // isNear 检查用的小容差值 (例如，以像素为单位)
-const long double HOVER_ADD_WIDTH =1.5;
-const long double SELECTED_WIDTH =2.5;
+const Real HOVER_ADD_WIDTH =1.5;
+const Real SELECTED_WIDTH =2.5;
 
 class Lineoo : public GeometricObject {
 public:
@@ -27,14 +27,22 @@ public:
     QPointF position() const override; // 返回 startPoint_
     std::pair<const QPointF, const QPointF> getTwoPoints() const override;
 
-    long double length() const{return len(getTwoPoints().first-getTwoPoints().second);}
+    Real length() const{return derived_.length;}
     GeometricObject* flush() override;
     virtual bool isTouchedByRectangle(const QPointF& start, const QPointF& end) const override;
+    QRectF boundingRect(const QRectF& viewport) const override;
 
 protected:
     // isNear 计算的辅助函数 (点到线段的距离)
     Qt::PenStyle getPenStyle()const;
-    long double distanceToLineoo(const QPointF& p,const std::pair<QPointF,QPointF>& Points) const;
+    Real distanceToLineoo(const QPointF& p) const;
+
+    // flush 的计算核心, 第一次 flush 时根据 generation_ 解析一次
+    typedef void (Lineoo::*Kernel)();
+    Kernel kernel_ = nullptr;
+    Kernel resolveKernel();
+    void flushInvalid();
+    void flushThroughPoints();
 };
 
 //lineoo的shape:
@@ -1,15 +1,87 @@
 #include "mainwindow.h"
+#include "batchevaluator.h"
+#include "interactionrecorder.h"
+#include "precisionbenchmark.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QFileInfo>
+#include <QThread>
+#include <cstring>
+#include <memory>
 
 int main(int argc, char *argv[])
 {
+    // 批处理和重放不需要窗口, 但 Measurement 仍然要用到字体, 所以用 offscreen 平台
+    for (int i = 1; i < argc; ++i) {
+        bool headless = std::strcmp(argv[i], "--batch") == 0 || std::strcmp(argv[i], "--replay") == 0
+                        || std::strcmp(argv[i], "--bench-precision") == 0;
+        if (headless && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+    }
     QApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption batchOption("batch", "Evaluate the given .thu files without opening a window.");
+    QCommandLineOption formatOption("format", "Batch output format: csv or json.", "format", "csv");
+    QCommandLineOption outputOption({"o", "output"}, "Write batch output to <file> instead of stdout.", "file");
+    QCommandLineOption jobsOption({"j", "jobs"}, "Number of worker processes for batch mode.", "n",
+                                  QString::number(QThread::idealThreadCount()));
+    QCommandLineOption svgOption("export-svg", "In batch mode, also export each file as SVG into <dir>, at its path relative to the working directory.", "dir");
+    QCommandLineOption pdfOption("export-pdf", "In batch mode, also export each file as PDF into <dir>, at its path relative to the working directory.", "dir");
+    QCommandLineOption sizeOption("size", "Page size of exported files.", "WxH", "1200x800");
+    QCommandLineOption recordOption("record", "Record canvas input events into <log>.", "log");
+    QCommandLineOption replayOption("replay", "Replay <log> offscreen and report per-event latency.", "log");
+    QCommandLineOption pipelineOption("pipeline", "Evaluate and render the drawing on a background thread.");
+    QCommandLineOption tilesOption("tiles", "Rasterize the drawing in tiles on a thread pool.");
+    QCommandLineOption benchPrecisionOption("bench-precision",
+                                            "Compare speed and error of the geometry kernels in float, double and "
+                                            "long double on <n> random constructions.", "n");
+    QCommandLineOption fragmentOption("fragment");
+    fragmentOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOptions({batchOption, formatOption, outputOption, jobsOption, svgOption, pdfOption, sizeOption,
+                       recordOption, replayOption, pipelineOption, tilesOption, benchPrecisionOption,
+                       fragmentOption});
+    parser.addPositionalArgument("files", "The .thu file(s) to open or evaluate.", "[files...]");
+    parser.process(a);
+
+    if (parser.isSet(batchOption)) {
+        BatchEvaluator::Options options;
+        options.format = parser.value(formatOption).toLower() == "json" ? BatchEvaluator::Json
+                                                                        : BatchEvaluator::Csv;
+        options.output = parser.value(outputOption);
+        options.jobs = std::max(1, parser.value(jobsOption).toInt());
+        options.fragment = parser.isSet(fragmentOption);
+        options.svgDir = parser.value(svgOption);
+        options.pdfDir = parser.value(pdfOption);
+        QStringList size = parser.value(sizeOption).split('x');
+        if (size.size() == 2 && size[0].toInt() > 0 && size[1].toInt() > 0) {
+            options.exportSize = QSize(size[0].toInt(), size[1].toInt());
+        }
+        return BatchEvaluator::run(parser.positionalArguments(), options);
+    }
+
+    if (parser.isSet(benchPrecisionOption)) {
+        return PrecisionBenchmark::run(parser.value(benchPrecisionOption).toInt());
+    }
+
+    if (parser.isSet(replayOption)) {
+        QStringList files = parser.positionalArguments();
+        return InteractionReplayer::run(parser.value(replayOption), files.isEmpty() ? QString() : files.first());
+    }
+
     MainWindow w;
+    if (parser.isSet(pipelineOption)) {
+        w.m_canvas->setPipelined(true);
+    }
+    if (parser.isSet(tilesOption)) {
+        w.m_canvas->setTiledRendering(true);
+    }
 
-    if (argc > 1) {
-        QString path = QString::fromLocal8Bit(argv[1]);
+    if (!parser.positionalArguments().isEmpty()) {
+        QString path = parser.positionalArguments().first();
         if (QFileInfo::exists(path)) {
             w.m_canvas->setFilePath(path);
             w.m_canvas->loadFile(true);
@@ -17,5 +89,16 @@ int main(int argc, char *argv[])
     }
 
     w.show();
-    return a.exec();
+    std::unique_ptr<InteractionRecorder> recorder;
+    if (parser.isSet(recordOption)) {
+        recorder.reset(new InteractionRecorder(parser.value(recordOption)));
+        QString document = parser.positionalArguments().isEmpty()
+                               ? QString() : QFileInfo(parser.positionalArguments().first()).absoluteFilePath();
+        if (recorder->start(w.m_canvas->size(), document)) {
+            w.m_canvas->setRecorder(recorder.get());
+        }
+    }
+    int ret = a.exec();
+    w.m_canvas->setRecorder(nullptr);
+    return ret;
 }
@@ -10,6 +10,7 @@
 #include <QScrollArea>
 #include <QButtonGroup>
 #include <QAbstractButton>
+#include <QStatusBar>
 #include <QDebug>
 
 MainWindow::MainWindow(QWidget *parent)
@@ -30,6 +31,7 @@ MainWindow::MainWindow(QWidget *parent)
                                tr("Hide"), tr("Show"), tr("Delete"), tr("Clear"), tr("Angle"),
                                tr("Distance"), tr("New Tool")};
     m_canvas->setOperationNames(names);
+    registerTools(m_canvas->loadToolLibrary()); // 工具库中保存的自定义工具
 
     // 2. 将 Canvas 设置为主窗口的中央部件
     setCentralWidget(m_canvas); // <--- 这是关键！
@@ -42,6 +44,16 @@ MainWindow::MainWindow(QWidget *parent)
     connect(m_toolButtonGroup, QOverload<QAbstractButton*>::of(&QButtonGroup::buttonClicked),
             this, &MainWindow::onToolSelected);
 
+    // 打开的文件中嵌入了新的自定义工具时刷新工具面板
+    connect(m_canvas, &Canvas::toolsRegistered, this, [this](const std::vector<RegisteredTool>& tools) {
+        registerTools(tools);
+        setupToolPanel();
+        scrollArea->setWidget(toolPanelContent);
+    });
+    connect(m_canvas, &Canvas::statusMessage, this, [this](const QString& message) {
+        statusBar()->showMessage(message);
+    });
+
     // 5. 设置工具面板 (setupToolPanel 内部会创建 toolPanelContent)
     setupToolPanel(); // 调用此函数来填充 toolPanelContent
 
@@ -167,6 +179,14 @@ QToolButton* MainWindow::createToolButton(const QString& text, const QString& ic
     return button;
 }
 
+void MainWindow::registerTools(const std::vector<RegisteredTool>& tools)
+{
+    for (const RegisteredTool& tool : tools) {
+        newTools[tool.name] = tool.index;
+        newToolIcons[tool.name] = tool.icon;
+    }
+}
+
 // 设置工具面板的函数 (保持不变，但注意 createToolButton 的父对象)
 void MainWindow::setupToolPanel()
 {
@@ -253,7 +273,9 @@ void MainWindow::setupToolPanel()
     CustomizeLayout->setContentsMargins(5,5,5,5);
     CustomizeLayout->addWidget(createToolButton(tr("New Tool"), ":/raw_icons/new_tool.png", tr("Create your own tool")));
     for (auto iter = newTools.begin(); iter != newTools.end(); ++iter) {
-        CustomizeLayout->addWidget(createToolButton(iter->first, ":/raw_icons/new_tool.png",iter->first));
+        auto icon = newToolIcons.find(iter->first);
+        QString iconPath = icon != newToolIcons.end() ? icon->second : ":/raw_icons/new_tool.png";
+        CustomizeLayout->addWidget(createToolButton(iter->first, iconPath, iter->first));
     }
     CustomizeLayout->addStretch();
     CustomizeGroup->setLayout(CustomizeLayout);
@@ -295,7 +317,7 @@ void MainWindow::onToolSelected(QAbstractButton *abstractButton)
         m_canvas->setMode(Canvas::CreatePointMode);
         qDebug() << "模式设置为: CreatePointMode";
     } else if (toolId == tr("Delete")){
-        m_canvas->deleteObjects();
+        m_canvas->runCommand(Canvas::DeleteCommand);
         if (!m_toolButtonGroup->buttons().isEmpty()) {
             QAbstractButton* firstButton = m_toolButtonGroup->buttons().first();
             if (firstButton) {
@@ -305,7 +327,7 @@ void MainWindow::onToolSelected(QAbstractButton *abstractButton)
         }
         m_canvas->setMode(Canvas::SelectionMode);
     } else if (toolId == tr("Hide")) {
-        m_canvas->hideObjects();
+        m_canvas->runCommand(Canvas::HideCommand);
         if (!m_toolButtonGroup->buttons().isEmpty()) {
             QAbstractButton* firstButton = m_toolButtonGroup->buttons().first();
             if (firstButton) {
@@ -315,7 +337,7 @@ void MainWindow::onToolSelected(QAbstractButton *abstractButton)
         }
         m_canvas->setMode(Canvas::SelectionMode);
     } else if (toolId == tr("Show")){
-        m_canvas->showObjects();
+        m_canvas->runCommand(Canvas::ShowCommand);
         if (!m_toolButtonGroup->buttons().isEmpty()) {
             QAbstractButton* firstButton = m_toolButtonGroup->buttons().first();
             if (firstButton) {
@@ -325,7 +347,7 @@ void MainWindow::onToolSelected(QAbstractButton *abstractButton)
         }
         m_canvas->setMode(Canvas::SelectionMode);
     } else if (toolId == tr("Clear")){
-        m_canvas->clearObjects();
+        m_canvas->runCommand(Canvas::ClearCommand);
         if (!m_toolButtonGroup->buttons().isEmpty()) {
             QAbstractButton* firstButton = m_toolButtonGroup->buttons().first();
             if (firstButton) {
@@ -36,6 +36,8 @@ private:
 
     QButtonGroup *m_toolButtonGroup;
     std::map<QString, int> newTools = {};
+    std::map<QString, QString> newToolIcons = {};
+    void registerTools(const std::vector<RegisteredTool>& tools);
     void closeEvent(QCloseEvent *event) override;
 };
 
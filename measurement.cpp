@@ -4,18 +4,17 @@
 #include "calculator.h"
 int NumOfMeasurements = 0;
 
-constexpr long double TextHeight = 30.0L;
+constexpr Real TextHeight = 30.0L;
 const QFont font("Arial", 16);
 constexpr int Precision = 2;
 
 Measurement::Measurement(const std::vector<GeometricObject*>& parents, const int& generation,
-                         bool isTemp, bool aux): GeometricObject(ObjectName::Measurement, aux) {
+                         bool isTemp, bool aux): GeometricObject(tableOf(parents), ObjectName::Measurement, aux) {
     for(auto iter: parents){
         addParent(iter);
     }
     generation_=generation;
     if (!isTemp and !aux){
-        GetDefaultLable[ObjectType::Lineoo]=nextLineLable(GetDefaultLable[ObjectType::Lineoo]);
         NumOfMeasurements++;
     }
     id_=NumOfMeasurements;
@@ -28,23 +27,22 @@ void Measurement::draw(QPainter* painter) const {
 
     painter->save(); // 保存当前 painter 状态
 
-    QFontMetrics fm(font);
-    QRect textRect = fm.boundingRect(text_);
+    const QRect& textRect = textRect_;
     const int x = 5;
     const int y = id_ * TextHeight;
 
     // 启用抗锯齿
-    painter->setRenderHint(QPainter::Antialiasing);
-    painter->setRenderHint(QPainter::TextAntialiasing);
+    painter->setRenderHint(QPainter::Antialiasing, !renderOptions.draft);
+    painter->setRenderHint(QPainter::TextAntialiasing, !renderOptions.draft);
     painter->setFont(font);
 
     // 绘制选中状态下的背景
-    if (isSelected()) {
+    if (drawsSelected()) {
         // 梅红色背景 (RGB: 255, 20, 147)
         QBrush backgroundBrush(QColor(255, 20, 147, 128)); // 半透明效果
-        painter->fillRect(x, y - fm.ascent(), textRect.width(), textRect.height(), backgroundBrush);
+        painter->fillRect(x, y - ascent_, textRect.width(), textRect.height(), backgroundBrush);
     }
-    if(isHovered()) {
+    if(drawsHovered()) {
         const int borderPadding = 2; // 边框与文本的间距
         QPen hoverPen(Qt::red);
         hoverPen.setWidth(1);
@@ -52,7 +50,7 @@ void Measurement::draw(QPainter* painter) const {
         painter->setBrush(Qt::NoBrush); // 不填充
         painter->drawRect(
             x - borderPadding,
-            y - fm.ascent() - borderPadding,
+            y - ascent_ - borderPadding,
             textRect.width() + 2 * borderPadding,
             textRect.height() + 2 * borderPadding
             );
@@ -76,20 +74,41 @@ QPointF Measurement::position() const{
 }
 
 std::pair<const QPointF, const QPointF> Measurement::getTwoPoints() const {
-    QFontMetrics fm(font);
-    QRect textRect = fm.boundingRect(text_);
     const int x = 5;
     const int y = id_ * TextHeight;
-    return std::make_pair(QPointF(x, y - fm.ascent()), QPointF(x + textRect.width(), y - fm.ascent() + textRect.height()));
+    return std::make_pair(QPointF(x, y - ascent_), QPointF(x + textRect_.width(), y - ascent_ + textRect_.height()));
+}
+
+bool Measurement::reflush() {
+    QString before = text_;
+    if (GeometricObject::reflush()) {
+        return true;
+    }
+    if (text_ == before) {
+        return false;
+    }
+    table_->markChanged(handle_);
+    table_->layers().touch(layer_);
+    return true;
 }
 
 GeometricObject* Measurement::flush() {
-    legal_ = true;
+    updateText();
+    // 文字只在 flush 时改变, 在这里排版一次; draw 和命中测试直接用结果
+    QFontMetrics fm(font);
+    textRect_ = fm.boundingRect(text_);
+    ascent_ = fm.ascent();
+    return this;
+}
+
+void Measurement::updateText() {
+    setLegal(true);
     for (auto iter : parents_) {
         if (!iter->isLegal()) {
-            legal_ = false;
+            setLegal(false);
             text_ = "Invalid measurement";
-            return this;
+            value_ = std::nan("");
+            return;
         }
     }
 
@@ -97,27 +116,32 @@ GeometricObject* Measurement::flush() {
     case 0: { // 长度度量
         if (parents_.size() == 1 && parents_[0]->getObjectType() == ObjectType::Lineoo) {
             Lineoo* segment = dynamic_cast<Lineoo*>(parents_[0]);
+            value_ = segment->length();
             text_.clear();
             text_+=" ";
             text_+=segment->getLabel();
             text_+=" = ";
-            text_+=QString::number(segment->length(),'f', Precision );
+            text_+=QString::number(value_,'f', Precision );
         }
         else if(parents_.size() == 2 && parents_[0]->getObjectType() == ObjectType::Point &&parents_[1]->getObjectType()==ObjectType::Point) {
+            value_ = len(parents_[0]->position()-parents_[1]->position());
             text_.clear();
             text_+=" ";
             text_+=parents_[0]->getLabel();
             text_+=parents_[1]->getLabel();
             text_+=" = ";
-            text_+=QString::number(len(parents_[0]->position()-parents_[1]->position()),'f',Precision);
+            text_+=QString::number(value_,'f',Precision);
         }
         else{
-            QMessageBox::warning(nullptr, "警告", "Measurement的长度测量parents_出错!");
+            reportError("Measurement的长度测量parents_出错!");
         }
-        return this;
+        return;
     }
     case 1: { // 角度度量
-        expectParentNum(3);
+        if(!expectParentNum(3)){ // 以前只弹对话框, 之后照样访问 parents_[2]
+            text_ = "Invalid generation type";
+            return;
+        }
         text_.clear();
         text_+=" ";
         text_+="∠";
@@ -126,23 +150,29 @@ GeometricObject* Measurement::flush() {
         text_+=parents_[2]->getLabel();
 
         text_+=" = ";
-        text_+=QString::number(
-            PI-abs(normalizeAngle(Theta(parents_[0]->position()-parents_[1]->position())-Theta(parents_[2]->position()-parents_[1]->position()))-PI) ,'f',Precision);
-        return this;
+        value_ = PI-abs(normalizeAngle(Theta(parents_[0]->position()-parents_[1]->position())-Theta(parents_[2]->position()-parents_[1]->position()))-PI);
+        text_+=QString::number(value_,'f',Precision);
+        return;
     }
     default:
-        QMessageBox::warning(nullptr, "警告", "Measurement的flush方法没有完成!");
+        reportError("Measurement的flush方法没有完成!");
         text_ = "Invalid generation type";
-        return this;
+        return;
     }
 }
 
+QRectF Measurement::boundingRect(const QRectF& viewport) const {
+    Q_UNUSED(viewport);
+    auto [topLeft, bottomRight] = getTwoPoints();
+    return QRectF(topLeft, bottomRight).adjusted(-3, -3, 3, 3); // 悬停边框在文字外 2 像素
+}
+
 bool Measurement::isTouchedByRectangle(const QPointF& start, const QPointF& end) const {
     auto p = getTwoPoints();
-    long double x1 = p.first.x(), x2 = p.second.x();
-    long double y1 = p.first.y(), y2 = p.second.y();
-    long double largerX = std::max(start.x(), end.x()), smallerX = std::min(start.x(), end.x());
-    long double largerY = std::max(start.y(), end.y()), smallerY = std::min(start.y(), end.y());
+    Real x1 = p.first.x(), x2 = p.second.x();
+    Real y1 = p.first.y(), y2 = p.second.y();
+    Real largerX = std::max(start.x(), end.x()), smallerX = std::min(start.x(), end.x());
+    Real largerY = std::max(start.y(), end.y()), smallerY = std::min(start.y(), end.y());
 
     return !((x1 > largerX && x2 > largerX) || (x1 < smallerX && x2 < smallerX) ||
              (y1 > largerY && y2 > largerY) || (y1 < smallerY && y2 < smallerY));
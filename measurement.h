@@ -30,13 +30,22 @@ public:
     std::pair<const QPointF, const QPointF> getTwoPoints() const override;//返回 左上角和右下角
 
     GeometricObject* flush() override;
+    bool reflush() override;    // 父对象动了位置不一定变, 但文字会变
     virtual bool isTouchedByRectangle(const QPointF& start, const QPointF& end) const override;
+    QRectF boundingRect(const QRectF& viewport) const override;
+    QString getText() const { return text_; }
+    double getValue() const { return value_; } // 长度或角度(弧度), 不合法时为 NaN
 
     friend class Saveloadhelper;
 
 protected:
     int id_;//这个标签的序号(决定了其显示的位置)
     QString text_;
+    double value_ = 0;
+    QRect textRect_;    // flush 时排版的结果
+    int ascent_ = 0;
+
+    void updateText();
 };
 
 //生成方式 0:长度, 1:角度
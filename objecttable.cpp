@@ -0,0 +1,58 @@
+#include "objecttable.h"
+
+ObjectHandle ObjectTable::insert(GeometricObject* obj) {
+    ObjectHandle handle;
+    if (free_.empty()) {
+        handle.slot = slots_.size();
+        slots_.push_back(Slot());
+    } else {
+        handle.slot = free_.back();
+        free_.pop_back();
+    }
+    slots_[handle.slot].object = obj;
+    handle.generation = slots_[handle.slot].generation;
+    return handle;
+}
+
+void ObjectTable::remove(ObjectHandle handle) {
+    if (!get(handle)) {
+        return;
+    }
+    Slot& slot = slots_[handle.slot];
+    slot.object = nullptr;
+    ++slot.generation;
+    free_.push_back(handle.slot);
+}
+
+void ObjectTable::markChanged(ObjectHandle handle) {
+    if (changedAll_) {
+        return;
+    }
+    if (changed_.size() >= slots_.size()) {
+        changedAll_ = true;
+        changed_.clear();
+        return;
+    }
+    changed_.push_back(handle);
+}
+
+bool ObjectTable::takeChanged(std::vector<ObjectHandle>& changed) {
+    bool all = changedAll_;
+    changedAll_ = false;
+    changed.clear();
+    changed.swap(changed_);
+    return all;
+}
+
+void ObjectTable::reportError(const QString& message) {
+    // 拖动时同一个对象每一帧都会报同样的错, 只留一条
+    if (std::find(errors_.begin(), errors_.end(), message) == errors_.end()) {
+        errors_.push_back(message);
+    }
+}
+
+std::vector<QString> ObjectTable::takeErrors() {
+    std::vector<QString> errors;
+    errors.swap(errors_);
+    return errors;
+}
@@ -0,0 +1,98 @@
+#ifndef OBJECTTABLE_H
+#define OBJECTTABLE_H
+
+#include <QString>
+#include <QtGlobal>
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "labelregistry.h"
+#include "layerset.h"
+#include "stylepalette.h"
+
+class GeometricObject;
+
+// 对象句柄: 对象表中的槽位和该槽位的代数; 对象被删除后槽位的代数加一,
+// 之前发出的句柄随之失效, 查找时返回 nullptr 而不是悬空指针
+struct ObjectHandle {
+    static const quint32 NoSlot = 0xFFFFFFFFu;
+    quint32 slot = NoSlot;
+    quint32 generation = 0;
+
+    bool isNull() const { return slot == NoSlot; }
+    bool operator==(const ObjectHandle& other) const { return slot == other.slot && generation == other.generation; }
+    bool operator!=(const ObjectHandle& other) const { return !(*this == other); }
+    bool operator<(const ObjectHandle& other) const {
+        return slot < other.slot || (slot == other.slot && generation < other.generation);
+    }
+};
+
+struct ObjectHandleHash {
+    size_t operator()(const ObjectHandle& h) const {
+        return std::hash<quint64>()(quint64(h.slot) << 32 | h.generation);
+    }
+};
+
+// 一个文档的对象表: 发放句柄, 按创建顺序给对象编号 (GeometricObject::getIndex), 保存共用的样式, 标签索引和图层
+// 对象在构造时登记到所在文档的表 (自由点由创建者指定, 其它对象跟随父对象), 析构时注销; 表不拥有对象
+// 每个 Canvas 有自己的表, 批处理每个文件用一张新表, 所以编号和句柄不会在文档之间串号;
+// 没有进程内的全局表, 同一个进程里可以同时打开多个文档
+class ObjectTable {
+public:
+    ObjectTable() = default;
+    ObjectTable(const ObjectTable&) = delete;
+    ObjectTable& operator=(const ObjectTable&) = delete;
+
+    ObjectHandle insert(GeometricObject* obj);
+    void remove(ObjectHandle handle);
+    // O(1); 句柄过期或为空时返回 nullptr
+    GeometricObject* get(ObjectHandle handle) const {
+        if (handle.slot >= slots_.size() || slots_[handle.slot].generation != handle.generation) {
+            return nullptr;
+        }
+        return slots_[handle.slot].object;
+    }
+    size_t size() const { return slots_.size() - free_.size(); }
+    size_t bytes() const { return slots_.capacity() * sizeof(Slot) + free_.capacity() * sizeof(quint32); }
+
+    // 本文档的对象共用的样式, 标签和图层
+    StylePalette& styles() { return styles_; }
+    const StylePalette& styles() const { return styles_; }
+    LabelRegistry& labels() { return labels_; }
+    const LabelRegistry& labels() const { return labels_; }
+    LayerSet& layers() { return layers_; }
+    const LayerSet& layers() const { return layers_; }
+
+    // 计算中发现的错误 (父对象的数量或类型不对, 没有实现的构造方式)
+    // 计算可能在绘制中或没有窗口的批处理里, 所以不弹对话框, 由 Canvas 或批处理取走后报告
+    void reportError(const QString& message);
+    std::vector<QString> takeErrors();
+
+    // 几何或显示状态变了的对象 (重新计算过, 隐藏/显示, 改了线宽), 命中测试据此只更新这些对象
+    // 同一个对象可能记多次; 记下的比对象总数还多时不再逐个记录, 只记住 "全部"
+    void markChanged(ObjectHandle handle);
+    // 取走记下的对象; 返回 true 表示记录已经溢出, 调用者应当整体重建
+    bool takeChanged(std::vector<ObjectHandle>& changed);
+
+    // 创建顺序的编号: 新对象取 nextIndex, 然后加一; 读文件时保证之后的编号大于文件中的所有编号
+    int takeIndex() { return nextIndex_++; }
+    void setNextIndex(int n) { nextIndex_ = n; }
+    void reserveIndex(int n) { nextIndex_ = std::max(nextIndex_, n); }
+
+private:
+    struct Slot {
+        GeometricObject* object = nullptr;
+        quint32 generation = 0;
+    };
+    std::vector<Slot> slots_;
+    std::vector<quint32> free_;     // 空闲的槽位, 后进先出
+    int nextIndex_ = 0;
+    StylePalette styles_;
+    LabelRegistry labels_;
+    LayerSet layers_;
+    std::vector<QString> errors_;
+    std::vector<ObjectHandle> changed_;
+    bool changedAll_ = false;
+};
+
+#endif // OBJECTTABLE_H
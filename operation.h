@@ -14,7 +14,7 @@ public:
     bool waitImplemented = false;
     int isValidInput(std::vector<GeometricObject*> objs) const;
     bool isWaiting(std::vector<GeometricObject*> objs) const;
-    std::string getName() { return operationName; }
+    std::string getName() const { return operationName; }
     virtual std::set<GeometricObject*> apply(std::vector<GeometricObject*> objs,
                                               QPointF position = QPointF()) const = 0;
     virtual std::set<GeometricObject*> wait(std::vector<GeometricObject*> objs) const;
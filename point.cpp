@@ -3,32 +3,36 @@
 #include "calculator.h"
 #include "circle.h"
 
-Point::Point(const QPointF& position, bool isTemp) : GeometricObject(ObjectName::Point), PointArg(position) {
+Point::Point(ObjectTable* table, const QPointF& position, bool isTemp) : GeometricObject(table, ObjectName::Point), PointArg(position) {
     generation_=0;
     if (!isTemp) {
-        GetDefaultLable[ObjectType::Point]=nextPointLable(GetDefaultLable[ObjectType::Point]);
+        takeDefaultLabel();
     }
 }
 
 Point::Point(const std::vector<GeometricObject*>& parents, const int& generation, bool aux)
-    : GeometricObject(ObjectName::Point, aux){
+    : GeometricObject(tableOf(parents), ObjectName::Point, aux){
     PointArg = QPoint(1,0);
     for(auto iter: parents){
         addParent(iter);
     }
     generation_ = generation;
     if (!aux){
-        GetDefaultLable[ObjectType::Point]=nextPointLable(GetDefaultLable[ObjectType::Point]);
+        takeDefaultLabel();
     }
 }
 
 
 Point::~Point(){
-    //GetDefaultLable[ObjectType::Point] = previousPointLable(GetDefaultLable[ObjectType::Point]);
 }
 
 
 void Point::setPosition(const QPointF& pos) {
+    markDirty();
+    // 约束点的参数要根据父对象当前的位置反算
+    for(auto iter:parents_){
+        iter->evaluate();
+    }
     switch(generation_){
     case 0:{
         expectParentNum(0);
@@ -50,7 +54,7 @@ void Point::setPosition(const QPointF& pos) {
     case 28:{
         expectParentNum(1);
         QPointF tmp=NearestPointOnCircle(pos,parents_[0]->getTwoPoints())-parents_[0]->position();
-        long double theta=Theta(tmp);
+        Real theta=Theta(tmp);
         auto [s,t]=dynamic_cast<Arc*>(parents_[0])->getAngles();
         if(thetainst(theta, s, t)){
             PointArg.rx()= AngleSubstract(theta,s)/AngleSubstract(t,s);
@@ -73,33 +77,32 @@ void Point::draw(QPainter* painter) const {
         return;
     }
 
-    if (!labelhidden_) {
+    if (!islablehidden() && renderOptions.labels) {
         painter->setPen(Qt::black);
-        painter->drawText(position().x() + 6, position().y() - 6, label_);
+        painter->drawText(position().x() + 6, position().y() - 6, getLabel());
     }
 
-    if (hovered_) {
+    if (drawsHovered()) {
         painter->setBrush(Qt::red);
         painter->setPen(Qt::black);
-        painter->drawEllipse(position(), size_ + 1,  size_ + 1);
-        if (selected_){
+        painter->drawEllipse(position(), getSize() + 1,  getSize() + 1);
+        if (drawsSelected()){
             painter->setBrush(Qt::NoBrush);
             painter->setPen(QPen(Qt::darkRed, 2));
-            painter->drawEllipse(position(), size_ + 3, size_ + 3);
+            painter->drawEllipse(position(), getSize() + 3, getSize() + 3);
         }
         return;
     }
-    qDebug()<<position_[0];
     painter->save();
-    painter->setRenderHint(QPainter::Antialiasing);    // Smooth edges
-    painter->setBrush(color_); // Fill color
+    painter->setRenderHint(QPainter::Antialiasing, !renderOptions.draft);    // Smooth edges
+    painter->setBrush(getColor()); // Fill color
     painter->setPen(Qt::black); // Border color
-    painter->drawEllipse(position(), size_, size_);
+    painter->drawEllipse(position(), getSize(), getSize());
 
-    if (selected_) {
+    if (drawsSelected()) {
         painter->setBrush(Qt::NoBrush);
         painter->setPen(QPen(Qt::darkRed, 2));
-        painter->drawEllipse(position(), size_ + 2, size_ + 2);
+        painter->drawEllipse(position(), getSize() + 2, getSize() + 2);
     }
 
     painter->restore();
@@ -109,192 +112,236 @@ bool Point::isNear(const QPointF& clickPos) const {
     if(!isShown())return false;
     qreal dx = clickPos.x() - position().x();
     qreal dy = clickPos.y() - position().y();
-    return (dx * dx + dy * dy) <= (size_ + 4) * (size_ + 4);
+    double r = getSize() + 4;
+    return (dx * dx + dy * dy) <= r * r;
+}
+
+Point::Kernel Point::resolveKernel(){
+    switch(generation_){
+    case -4:
+        return expectParentNum(2) ? &Point::flushCentralSymmetryPoint : &Point::flushInvalid;
+    case -3:
+        return expectParentNum(2) ? &Point::flushAxialSymmetryPoint : &Point::flushInvalid;
+    case 0:
+        return &Point::flushFree;
+    case 1:
+    case 2:
+    case 3:
+        return expectParentNum(1) ? &Point::flushOnLine : &Point::flushInvalid;
+    case 4:
+        return expectParentNum(1) ? &Point::flushOnCircle : &Point::flushInvalid;
+    case 5:case 6:case 7:case 8:case 9:case 10:case 11:case 12:case 13:
+        return expectParentNum(2) ? &Point::flushLineLine : &Point::flushInvalid;
+    case 14: case 15: case 16: case 17: case 18: case 19:
+        return expectParentNum(2) ? &Point::flushLineCircle : &Point::flushInvalid;
+    case 20: case 21:
+        return expectParentNum(2) ? &Point::flushCircleCircle : &Point::flushInvalid;
+    case 28:
+        return expectParentNum(1) && expectParentType(0, ObjectType::Arc) ? &Point::flushOnArc : &Point::flushInvalid;
+    case 29:
+        return expectParentNum(3) ? &Point::flushArcEnd : &Point::flushInvalid;
+    case 30:
+        if(!parents_.empty() && parents_[0]->getObjectType()==ObjectType::Point){
+            return expectParentNum(2) ? &Point::flushMidpoint : &Point::flushInvalid;
+        }
+        return expectParentNum(1) ? &Point::flushSegmentMidpoint : &Point::flushInvalid;
+    case 31:case 32:
+        return expectParentNum(2) ? &Point::flushTangentPoint : &Point::flushInvalid;
+    case 34:case 35:case 36:case 37:case 38:case 39:
+        return expectParentNum(2) && expectParentType(1, ObjectType::Arc) ? &Point::flushLineArc : &Point::flushInvalid;
+    case 40:case 41:
+        return expectParentNum(2) && expectParentType(1, ObjectType::Arc) ? &Point::flushCircleArc : &Point::flushInvalid;
+    case 42:case 43:
+        return expectParentNum(2) && expectParentType(0, ObjectType::Arc) && expectParentType(1, ObjectType::Arc)
+                   ? &Point::flushArcArc : &Point::flushInvalid;
+    default:
+        reportError("Point的flush方法没有完成!");
+        return &Point::flushInvalid;
+    };
 }
 
 GeometricObject* Point::flush(){
     position_.clear();
-    legal_=true;
+    setLegal(true);
     for(auto iter:parents_){
         if(!iter->isLegal()){
-            legal_=false;
+            setLegal(false);
             position_.push_back(QPointF());
             return this;
         }
     }
-    switch(generation_){
-    case -4:{
-        position_.push_back(2*parents_[1]->position() - parents_[0]->position());
-        return this;
+    if(!kernel_){
+        kernel_=resolveKernel();
     }
-    case -3:{
-        position_.push_back(reflect(parents_[0]->position(),parents_[1]->getTwoPoints()));
-        return this;
-    }
-    case 0:{
-        position_.push_back(PointArg);
-        return this;
-    }
-    case 1:
-    case 2:
-    case 3:{
-        expectParentNum(1);
-        auto ppp=parents_[0]->getTwoPoints();
-        position_.push_back(ppp.first+PointArg.x()*(ppp.second-ppp.first));
-        return this;
-    }
-    case 4:{
-        expectParentNum(1);
-        auto ppp=parents_[0]->getTwoPoints();
-        position_.push_back(ppp.first+PointArg*len(ppp.second-ppp.first)/len(PointArg));
-        return this;
-    }
-    case 5:case 6:case 7:case 8:case 9:case 10:case 11:case 12:case 13:{
-        expectParentNum(2);
-        int range1=(generation_-5)/3,range2=(generation_-5)%3;
-        auto res=linelineintersection(parents_[0]->getTwoPoints(),parents_[1]->getTwoPoints());
-
-        if(
-            range1==1&&res.t[0]<0 || range1==2&&(res.t[0]<0||res.t[0]>1)
-            ||  range2==1&&res.t[1]<0 || range2==2&&(res.t[1]<0||res.t[1]>1)){
-            legal_=false;
-        }
-        position_.push_back(res.p);
-        return this;
+    (this->*kernel_)();
+    return this;
+}
+
+void Point::flushInvalid(){
+    setLegal(false);
+    position_.push_back(QPointF());
+}
+
+void Point::flushCentralSymmetryPoint(){
+    position_.push_back(2*parents_[1]->position() - parents_[0]->position());
+}
+
+void Point::flushAxialSymmetryPoint(){
+    position_.push_back(reflect(parents_[0]->position(),parents_[1]->getTwoPoints()));
+}
+
+void Point::flushFree(){
+    position_.push_back(PointArg);
+}
+
+void Point::flushOnLine(){
+    auto ppp=parents_[0]->getTwoPoints();
+    position_.push_back(ppp.first+PointArg.x()*(ppp.second-ppp.first));
+}
+
+void Point::flushOnCircle(){
+    position_.push_back(parents_[0]->position()+PointArg*parents_[0]->derived().length/len(PointArg));
+}
+
+void Point::flushLineLine(){
+    int range1=(generation_-5)/3,range2=(generation_-5)%3;
+    auto [A,B]=parents_[0]->getTwoPoints();
+    auto [C,D]=parents_[1]->getTwoPoints();
+    auto res=linelineintersection({A,B},{C,D});
+
+    // 交点是否落在射线/线段上直接由四个定义点判定, 不看算出来的参数 t
+    if(!res.exist
+        || range1==1&&!intersectionOnRay(A,B,C,D) || range1==2&&!intersectionOnSegment(A,B,C,D)
+        || range2==1&&!intersectionOnRay(C,D,A,B) || range2==2&&!intersectionOnSegment(C,D,A,B)){
+        setLegal(false);
     }
-    case 14: case 15: case 16: case 17: case 18: case 19:{
-        expectParentNum(2);
-        int range=(generation_-14)/2;
-        auto res=linecircleintersection(parents_[0]->getTwoPoints(),parents_[1]->getTwoPoints());
-        if(res.exist==false || range==1&&res.t[generation_%2]<0 || range==2&&(res.t[generation_%2]<0||res.t[generation_%2]>1)){
-            legal_=false;
-        }
-        position_.push_back(res.p[generation_%2]);
-        return this;
+    position_.push_back(res.p);
+}
+
+void Point::flushLineCircle(){
+    int range=(generation_-14)/2;
+    auto [A,B]=parents_[0]->getTwoPoints();
+    auto res=linecircleintersection({A,B},parents_[1]->getTwoPoints());
+    const QPointF& p=res.p[generation_%2];
+    if(res.exist==false || range==1&&!projectsOntoRay(A,B,p) || range==2&&!projectsOntoSegment(A,B,p)){
+        setLegal(false);
     }
-    case 20: case 21:{
-        expectParentNum(2);
-        auto res=circlecircleintersection(parents_[0]->getTwoPoints(),parents_[1]->getTwoPoints());
-        if(res.exist==false){
-            legal_=false;
-        }
-        position_.push_back(res.p[generation_%2]);
-        return this;
+    position_.push_back(p);
+}
+
+void Point::flushCircleCircle(){
+    auto res=circlecircleintersection(parents_[0]->getTwoPoints(),parents_[1]->getTwoPoints());
+    if(res.exist==false){
+        setLegal(false);
     }
-    case 28:{
-        expectParentNum(1);
-        auto [s,t]=dynamic_cast<Arc*>(parents_[0])->getAngles();
-        long double theta = s+ PointArg.x()*AngleSubstract(t,s);
-        position_.push_back(parents_[0]->position() + UnitVector(theta)*len(parents_[0]->getTwoPoints()));
-        return this;
+    position_.push_back(res.p[generation_%2]);
+}
+
+void Point::flushOnArc(){
+    auto [s,t]=static_cast<Arc*>(parents_[0])->getAngles();
+    Real theta = s+ PointArg.x()*AngleSubstract(t,s);
+    position_.push_back(parents_[0]->position() + UnitVector(theta)*parents_[0]->derived().length);
+}
+
+void Point::flushArcEnd(){
+    // 圆弧的另一个端点: 沿圆心到第三个点的方向, 到圆心的距离等于半径
+    QPointF center = parents_[0]->position();
+    QPointF direction = parents_[2]->position() - center;
+    position_.push_back(center + direction * (len(parents_[1]->position() - center) / len(direction)));
+}
+
+void Point::flushMidpoint(){
+    QPointF P1=parents_[0]->position();
+    QPointF P2=parents_[1]->position();
+    position_.push_back(QPointF((P1.x() + P2.x()) / 2, (P1.y() + P2.y()) / 2));
+}
+
+void Point::flushSegmentMidpoint(){
+    auto p = parents_[0]->getTwoPoints();
+    position_.push_back(QPointF((p.first.x() + p.second.x()) / 2, (p.first.y() + p.second.y()) / 2));
+}
+
+void Point::flushTangentPoint(){
+    QPointF center = parents_[1]->position();
+    const QPointF& A =parents_[0]->position();
+    qreal radius = parents_[1]->derived().length;
+    QPointF AC = A - center;
+    qreal dist_squared = AC.x() * AC.x() + AC.y() * AC.y();
+    qreal dist = std::sqrt(dist_squared);
+
+    if (dist <= radius) {
+        setLegal(false);
+        position_.push_back(QPointF());
+        return;
     }
-    case 29:{
-        expectParentNum(3);
-        position_.push_back(parents_[0]->position() + (parents_[2]->position()-parents_[0]->position())*
-                                                        len(parents_[1]->position()-parents_[0]->position())/len(parents_[2]->position()-parents_[0]->position()));
-        return this;
+
+    qreal h = std::sqrt(dist_squared - radius * radius);
+    qreal cos_theta = radius / dist;
+    qreal sin_theta = h / dist;
+
+    if(generation_==31) {
+        position_.push_back(QPointF(
+            center.x() + (AC.x() * cos_theta - AC.y() * sin_theta) * radius / dist,
+            center.y() + (AC.x() * sin_theta + AC.y() * cos_theta) * radius / dist
+            ));
+    } else {
+        position_.push_back(QPointF(
+            center.x() + (AC.x() * cos_theta + AC.y() * sin_theta) * radius / dist,
+            center.y() + (-AC.x() * sin_theta + AC.y() * cos_theta) * radius / dist
+            ));
     }
-    case 30:{
-        QPointF P1, P2;
-        if(parents_[0]->getObjectType()==ObjectType::Point){
-            expectParentNum(2);
-            P1=parents_[0]->position();
-            P2=parents_[1]->position();
-        } else {
-            expectParentNum(1);
-            auto p = parents_[0]->getTwoPoints();
-            P1 = p.first;
-            P2 = p.second;
-        }
-        position_.push_back(QPointF((P1.x() + P2.x()) / 2, (P1.y() + P2.y()) / 2));
-        return this;
+    if(parents_[1]->getObjectType()==ObjectType::Arc and !static_cast<Arc*>(parents_[1])->containsDirection(position_[0])){
+        setLegal(false);
     }
-    case 31:case 32:{
-        auto [center, pointOnCircle] = parents_[1]->getTwoPoints();
-        const QPointF& A =parents_[0]->position();
-        qreal radius = len(center-pointOnCircle);
-        QPointF AC = A - center;
-        qreal dist_squared = AC.x() * AC.x() + AC.y() * AC.y();
-        qreal dist = std::sqrt(dist_squared);
-
-        if (dist <= radius) {
-            legal_=false;
-            position_.push_back(QPointF());
-            return this;
-        }
+}
 
-        qreal h = std::sqrt(dist_squared - radius * radius);
-        qreal cos_theta = radius / dist;
-        qreal sin_theta = h / dist;
-
-        if(generation_==31) {
-            position_.push_back(QPointF(
-                center.x() + (AC.x() * cos_theta - AC.y() * sin_theta) * radius / dist,
-                center.y() + (AC.x() * sin_theta + AC.y() * cos_theta) * radius / dist
-                ));
-        } else {
-            position_.push_back(QPointF(
-                center.x() + (AC.x() * cos_theta + AC.y() * sin_theta) * radius / dist,
-                center.y() + (-AC.x() * sin_theta + AC.y() * cos_theta) * radius / dist
-                ));
-        }
-        if(parents_[1]->getObjectType()==ObjectType::Arc and !thetainst(Theta(position_[0]-center),dynamic_cast<Arc*>(parents_[1])->getAngles())){
-            legal_=false;
-        }
-        return this;
+void Point::flushLineArc(){
+    int range=(generation_-34)/2;
+    auto [A,B]=parents_[0]->getTwoPoints();
+    auto res=linecircleintersection({A,B},parents_[1]->getTwoPoints());
+    const QPointF& p=res.p[generation_%2];
+    if( res.exist==false ||
+        range==1&&!projectsOntoRay(A,B,p) ||
+        range==2&&!projectsOntoSegment(A,B,p) ||
+        !static_cast<Arc*>(parents_[1])->containsDirection(p)){
+        setLegal(false);
     }
-    case 34:case 35:case 36:case 37:case 38:case 39:{
-        expectParentNum(2);
-        int range=(generation_-34)/2;
-        auto res=linecircleintersection(parents_[0]->getTwoPoints(),parents_[1]->getTwoPoints());
-        if( res.exist==false ||
-            range==1&&res.t[generation_%2]<0 ||
-            range==2&& (res.t[generation_%2]<0 ||res.t[generation_%2]>1) ||
-            !thetainst(Theta(res.p[generation_%2]-parents_[1]->position()),
-                        dynamic_cast<Arc*>(parents_[1])->getAngles())){
-            legal_=false;
-        }
-        position_.push_back(res.p[generation_%2]);
-        return this;
-    }
-    case 40:case 41:{
-        expectParentNum(2);
-        auto res=circlecircleintersection(parents_[0]->getTwoPoints(),parents_[1]->getTwoPoints());
-        if(res.exist==false ||
-            !thetainst(Theta(res.p[generation_%2]-parents_[1]->position()),
-                       dynamic_cast<Arc*>(parents_[1])->getAngles())){
-            legal_=false;
-        }
-        position_.push_back(res.p[generation_%2]);
-        return this;
+    position_.push_back(p);
+}
+
+void Point::flushCircleArc(){
+    auto res=circlecircleintersection(parents_[0]->getTwoPoints(),parents_[1]->getTwoPoints());
+    if(res.exist==false ||
+        !static_cast<Arc*>(parents_[1])->containsDirection(res.p[generation_%2])){
+        setLegal(false);
     }
-    case 42:case 43:{
-        expectParentNum(2);
-        auto res=circlecircleintersection(parents_[0]->getTwoPoints(),parents_[1]->getTwoPoints());
-        if(res.exist==false ||
-            !thetainst(Theta(res.p[generation_%2]-parents_[1]->position()),
-                       dynamic_cast<Arc*>(parents_[1])->getAngles()) ||
-            !thetainst(Theta(res.p[generation_%2]-parents_[0]->position()),
-                       dynamic_cast<Arc*>(parents_[0])->getAngles())){
-            legal_=false;
-        }
-        position_.push_back(res.p[generation_%2]);
-        return this;
+    position_.push_back(res.p[generation_%2]);
+}
+
+void Point::flushArcArc(){
+    auto res=circlecircleintersection(parents_[0]->getTwoPoints(),parents_[1]->getTwoPoints());
+    if(res.exist==false ||
+        !static_cast<Arc*>(parents_[1])->containsDirection(res.p[generation_%2]) ||
+        !static_cast<Arc*>(parents_[0])->containsDirection(res.p[generation_%2])){
+        setLegal(false);
     }
-    default:
-        QMessageBox::warning(nullptr, "警告", "Point的flush方法没有完成!");
-        position_.push_back(QPointF());
-        return this;
-    };
+    position_.push_back(res.p[generation_%2]);
 }
 
 QPointF Point::position() const{
     return position_[0];
 }
 
+QRectF Point::boundingRect(const QRectF& viewport) const {
+    Q_UNUSED(viewport);
+    QPointF p = position();
+    double r = getSize() + 4; // 选中时外圈半径为大小+3, 画笔宽 2
+    return QRectF(p.x() - r, p.y() - r, 2 * r, 2 * r).united(labelRect(QPointF(p.x() + 6, p.y() - 6)));
+}
+
 bool Point::isTouchedByRectangle(const QPointF& start, const QPointF& end) const{
-    long double x = position().x(), y = position().y();
-    long double xStart = start.x(), yStart = start.y();
-    long double xEnd = end.x(), yEnd = end.y();
+    Real x = position().x(), y = position().y();
+    Real xStart = start.x(), yStart = start.y();
+    Real xEnd = end.x(), yEnd = end.y();
     return (x-xStart) * (x-xEnd) <= 0 and (y-yStart) * (y-yEnd) <= 0;
 }
@@ -11,7 +11,7 @@ class Saveloadhelper;
 class Point : public GeometricObject {
 public:
 
-    explicit Point(const QPointF& position, bool isTemp = false);
+    explicit Point(ObjectTable* table, const QPointF& position, bool isTemp = false);
     explicit Point(const std::vector<GeometricObject*>& parents, const int& generation, bool aux = false);
 
     ObjectType getObjectType() const override { return ObjectType::Point; }
@@ -21,13 +21,37 @@ public:
 
     void setPosition(const QPointF& pos = QPointF());
     GeometricObject* flush() override;
+    QPointF constraint() const override { return PointArg; }
     virtual bool isTouchedByRectangle(const QPointF& start, const QPointF& end) const override;
+    QRectF boundingRect(const QRectF& viewport) const override;
     ~Point();
 
     friend class Saveloadhelper;
 
 private:
     QPointF PointArg;//如果是1,2,3 返回一个比例常数放在x(), 如果是4, 则为所在半径的方向向量
+
+    // flush 的计算核心: 第一次 flush 时根据 generation_ 解析一次, 父对象个数和类型也只在这时检查
+    typedef void (Point::*Kernel)();
+    Kernel kernel_ = nullptr;
+    Kernel resolveKernel();
+    void flushInvalid();
+    void flushCentralSymmetryPoint();
+    void flushAxialSymmetryPoint();
+    void flushFree();
+    void flushOnLine();
+    void flushOnCircle();
+    void flushLineLine();
+    void flushLineCircle();
+    void flushCircleCircle();
+    void flushOnArc();
+    void flushArcEnd();
+    void flushMidpoint();
+    void flushSegmentMidpoint();
+    void flushTangentPoint();
+    void flushLineArc();
+    void flushCircleArc();
+    void flushArcArc();
 };
 
 //point的生成方式:
@@ -0,0 +1,133 @@
+#include "precisionbenchmark.h"
+#include "calculator.h"
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <limits>
+
+namespace {
+
+typedef std::pair<QPointF, QPointF> Pair;
+// 结果按最高精度保存, 各精度的误差都和 long double 的参考值在 long double 下比较
+typedef PointT<long double> Wide;
+
+template <typename P>
+Wide widen(const P& p) {
+    return Wide(p.x(), p.y());
+}
+
+// 一组输入: 两条直线/两个圆 (每个由两个点定义), 再加一个点
+struct Input {
+    Pair a, b;
+    QPointF c;
+};
+
+const char* Names[] = {"line-line", "line-circle", "circle-circle", "circumcenter", "point-on-circle"};
+const int KindCount = sizeof(Names) / sizeof(Names[0]);
+
+// 按精度 T 计算一种构造, 结果写到 out, 返回结果的个数 (不存在时为 0)
+template <typename T>
+int compute(int kind, const Input& in, Wide* out) {
+    switch (kind) {
+    case 0: {
+        auto r = linelineintersection<T>(in.a, in.b);
+        out[0] = widen(r.p);
+        return r.exist ? 1 : 0;
+    }
+    case 1: {
+        auto r = linecircleintersection<T>(in.a, in.b);
+        out[0] = widen(r.p[0]), out[1] = widen(r.p[1]);
+        return r.exist ? 2 : 0;
+    }
+    case 2: {
+        auto r = circlecircleintersection<T>(in.a, in.b);
+        out[0] = widen(r.p[0]), out[1] = widen(r.p[1]);
+        return r.exist ? 2 : 0;
+    }
+    case 3:
+        out[0] = widen(calculateCircleCenter<T>(in.a.first, in.a.second, in.c));
+        return 1;
+    default: {
+        // 圆 a 上和 c 同方向的点: Theta 求角度, 再用 UnitVector 转回来
+        T theta = Theta<T>(in.c - in.a.first);
+        T radius = len<T>(in.a.second - in.a.first);
+        PointOf<T> u = UnitVector<T>(theta);
+        out[0] = widen(PointT<T>(T(in.a.first.x()) + radius * u.x(), T(in.a.first.y()) + radius * u.y()));
+        return 1;
+    }
+    }
+}
+
+struct Result {
+    std::vector<Wide> points;       // 每组输入 2 个位置
+    std::vector<int> counts;
+    double seconds = 0;
+};
+
+template <typename T>
+Result measure(int kind, const std::vector<Input>& inputs) {
+    Result ret;
+    ret.points.resize(inputs.size() * 2);
+    ret.counts.resize(inputs.size());
+    QElapsedTimer timer;
+    timer.start();
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        ret.counts[i] = compute<T>(kind, inputs[i], &ret.points[2 * i]);
+    }
+    ret.seconds = timer.nsecsElapsed() / 1e9;
+    return ret;
+}
+
+} // namespace
+
+int PrecisionBenchmark::run(int count) {
+    // 画布大小范围内的随机坐标, 固定种子, 每次运行的输入相同
+    std::mt19937 rng(20240601);
+    std::uniform_real_distribution<double> x(0, 1200), y(0, 800);
+    auto point = [&]() { return QPointF(x(rng), y(rng)); };
+    std::vector<Input> inputs(std::max(count, 1));
+    for (Input& in : inputs) {
+        in.a = {point(), point()};
+        in.b = {point(), point()};
+        in.c = point();
+    }
+
+    QTextStream out(stdout);
+    out << "construction    precision      Mops/s  mean err(px)   max err(px)  mismatches\n";
+    for (int kind = 0; kind < KindCount; ++kind) {
+        Result reference = measure<long double>(kind, inputs);
+        Result results[] = {measure<float>(kind, inputs), measure<double>(kind, inputs), reference};
+        const char* precisions[] = {"float", "double", "long double"};
+        for (int p = 0; p < 3; ++p) {
+            const Result& r = results[p];
+            double sum = 0, max = 0;
+            int compared = 0, mismatches = 0;
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                // 是否存在交点的判断不同, 记为不一致, 不计入误差
+                if (r.counts[i] != reference.counts[i]) {
+                    ++mismatches;
+                    continue;
+                }
+                for (int j = 0; j < r.counts[i]; ++j) {
+                    const Wide& a = r.points[2 * i + j];
+                    const Wide& b = reference.points[2 * i + j];
+                    long double dx = a.x() - b.x(), dy = a.y() - b.y();
+                    double err = double(std::sqrt(dx * dx + dy * dy));
+                    sum += err;
+                    max = std::max(max, err);
+                    ++compared;
+                }
+            }
+            out << QString(Names[kind]).leftJustified(16) << QString(precisions[p]).leftJustified(12)
+                << QString::number(inputs.size() / r.seconds / 1e6, 'f', 2).rightJustified(10)
+                << QString::number(compared ? sum / compared : 0, 'e', 2).rightJustified(14)
+                << QString::number(max, 'e', 2).rightJustified(14)
+                << QString::number(mismatches).rightJustified(12) << "\n";
+        }
+    }
+    out << "Real = " << (sizeof(Real) == sizeof(double) ? "double" : "long double")
+        << ", long double has " << std::numeric_limits<long double>::digits << " mantissa bits\n";
+    return 0;
+}
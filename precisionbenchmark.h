@@ -0,0 +1,13 @@
+#ifndef PRECISIONBENCHMARK_H
+#define PRECISIONBENCHMARK_H
+
+// 用 float, double, long double 分别实例化 calculator.h 中的计算核心, 在同一批随机构造上比较
+// 速度 (每秒多少次) 和误差 (相对 long double 结果的距离, 单位像素)
+// long double 和 double 一样长的平台 (例如 MSVC) 上, 参考值本身就只有 double 精度
+class PrecisionBenchmark {
+public:
+    // count: 每种构造随机生成多少组输入
+    static int run(int count);
+};
+
+#endif // PRECISIONBENCHMARK_H
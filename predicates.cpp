@@ -0,0 +1,156 @@
+#include "predicates.h"
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const double Eps = std::numeric_limits<double>::epsilon() / 2; // 舍入误差上界 2^-53
+const double Splitter = 134217729.0;                          // 2^27 + 1, 把 double 拆成两个 26 位的半
+// 两个乘积之和的误差上界 (Shewchuk 的 ccwerrboundA), 相对于 |左边的乘积| + |右边的乘积|
+const double ErrorBound = (3.0 + 16.0 * Eps) * Eps;
+
+// 以下都是无误差变换: 结果 x 是浮点运算的结果, y 是它的舍入误差, x + y 精确等于真实值
+
+void twoSum(double a, double b, double& x, double& y) {
+    x = a + b;
+    double bv = x - a;
+    double av = x - bv;
+    y = (a - av) + (b - bv);
+}
+
+void twoDiff(double a, double b, double& x, double& y) {
+    x = a - b;
+    double bv = a - x;
+    double av = x + bv;
+    y = (a - av) + (bv - b);
+}
+
+void split(double a, double& hi, double& lo) {
+    double c = Splitter * a;
+    double big = c - a;
+    hi = c - big;
+    lo = a - hi;
+}
+
+void twoProduct(double a, double b, double& x, double& y) {
+    x = a * b;
+    double ahi, alo, bhi, blo;
+    split(a, ahi, alo);
+    split(b, bhi, blo);
+    double err1 = x - ahi * bhi;
+    double err2 = err1 - alo * bhi;
+    double err3 = err2 - ahi * blo;
+    y = alo * blo - err3;
+}
+
+// 若干 double 的精确和, 表示为互不重叠, 按绝对值从小到大排列的各项 (去掉了 0),
+// 和的符号就是最大一项的符号
+struct Expansion {
+    double terms[20];
+    int size = 0;
+
+    void add(double b) {
+        double q = b;
+        int n = 0;
+        for (int i = 0; i < size; ++i) {
+            double h;
+            twoSum(q, terms[i], q, h);
+            if (h != 0) {
+                terms[n++] = h;
+            }
+        }
+        if (q != 0) {
+            terms[n++] = q;
+        }
+        size = n;
+    }
+
+    int sign() const {
+        return size == 0 ? 0 : (terms[size - 1] > 0 ? 1 : -1);
+    }
+};
+
+int exactSumOfProductsSign(double a, double b, double c, double d, double e, double f, double g, double h) {
+    // 四个差各是两项的精确和, 每个乘积展开成 4 个两项乘积, 一共 16 项
+    double x[2], y[2], u[2], v[2];
+    twoDiff(a, b, x[0], x[1]);
+    twoDiff(c, d, y[0], y[1]);
+    twoDiff(e, f, u[0], u[1]);
+    twoDiff(g, h, v[0], v[1]);
+    Expansion sum;
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            double p, q;
+            twoProduct(x[i], y[j], p, q);
+            sum.add(q);
+            sum.add(p);
+            twoProduct(u[i], v[j], p, q);
+            sum.add(q);
+            sum.add(p);
+        }
+    }
+    return sum.sign();
+}
+
+// 数学方向 (y 轴向上) 的叉积符号, 和屏幕坐标下的相反
+int ccw(const QPointF& u, const QPointF& v) {
+    return -crossSign(u, v);
+}
+
+} // namespace
+
+int sumOfProductsSign(double a, double b, double c, double d, double e, double f, double g, double h) {
+    double left = (a - b) * (c - d);
+    double right = (e - f) * (g - h);
+    double sum = left + right;
+    double bound = ErrorBound * (std::fabs(left) + std::fabs(right));
+    if (sum > bound) {
+        return 1;
+    }
+    if (-sum > bound) {
+        return -1;
+    }
+    return exactSumOfProductsSign(a, b, c, d, e, f, g, h);
+}
+
+namespace {
+
+// t = num / den, 其中 den = (b - a) × (d - c), num = (c - a) × (d - c), num - den = (c - b) × (d - c)
+int denominatorSign(const QPointF& a, const QPointF& b, const QPointF& c, const QPointF& d) {
+    return sumOfProductsSign(b.x(), a.x(), d.y(), c.y(), a.y(), b.y(), d.x(), c.x());
+}
+
+int numeratorSign(const QPointF& from, const QPointF& c, const QPointF& d) {
+    return sumOfProductsSign(c.x(), from.x(), d.y(), c.y(), from.y(), c.y(), d.x(), c.x());
+}
+
+} // namespace
+
+bool intersectionOnRay(const QPointF& a, const QPointF& b, const QPointF& c, const QPointF& d) {
+    int den = denominatorSign(a, b, c, d);
+    return den != 0 && numeratorSign(a, c, d) * den >= 0;
+}
+
+bool intersectionOnSegment(const QPointF& a, const QPointF& b, const QPointF& c, const QPointF& d) {
+    int den = denominatorSign(a, b, c, d);
+    return den != 0 && numeratorSign(a, c, d) * den >= 0 && numeratorSign(b, c, d) * den <= 0;
+}
+
+bool withinArc(const QPointF& center, const QPointF& from, const QPointF& to, const QPointF& p) {
+    // p - center 的两个分量由四个原始坐标精确参与运算, 不先做减法
+    auto side = [&](const QPointF& u) { // u × (p - center), 数学方向
+        return -sumOfProductsSign(u.x(), 0, p.y(), center.y(), 0, u.y(), p.x(), center.x());
+    };
+    int span = ccw(from, to);
+    if (span > 0 || (span == 0 && dotSign(from, to) < 0)) {
+        // 跨度不超过 π: 在 from 的逆时针一侧, 同时在 to 的顺时针一侧
+        return side(from) >= 0 && side(to) <= 0;
+    }
+    if (span < 0) {
+        // 跨度超过 π: 不在两个半平面的交集 (圆弧的补集) 里就行
+        return side(from) >= 0 || side(to) <= 0;
+    }
+    // from 和 to 同向, 跨度为 0, 只有这一个方向
+    QPointF v = p - center;
+    return side(from) == 0 && dotSign(from, v) > 0;
+}
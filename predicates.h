@@ -0,0 +1,48 @@
+#ifndef PREDICATES_H
+#define PREDICATES_H
+
+#include <QPointF>
+
+// 合法性判定用的几何谓词: 在线段上, 在射线上, 在圆弧的角度范围内
+// 只用乘法和加减, 不求角度 (没有 atan2/sin/cos), 也没有固定的 Epsilon;
+// 先用 double 计算, 只有结果太接近 0, 舍入误差可能改变符号时, 才改用精确的展开式算术 (Shewchuk),
+// 所以在任何缩放比例下对同一组输入都给出同样的结论
+
+// (a - b)(c - d) + (e - f)(g - h) 的精确符号: 1, 0 或 -1
+int sumOfProductsSign(double a, double b, double c, double d, double e, double f, double g, double h);
+
+// 叉积 u × v 的符号 (屏幕坐标, y 轴向下)
+inline int crossSign(const QPointF& u, const QPointF& v) {
+    return sumOfProductsSign(u.x(), 0, v.y(), 0, 0, u.y(), v.x(), 0);
+}
+
+inline int dotSign(const QPointF& u, const QPointF& v) {
+    return sumOfProductsSign(u.x(), 0, v.x(), 0, u.y(), 0, v.y(), 0);
+}
+
+// (b - a) × (c - a) 的符号
+inline int orientation(const QPointF& a, const QPointF& b, const QPointF& c) {
+    return sumOfProductsSign(b.x(), a.x(), c.y(), a.y(), a.y(), b.y(), c.x(), a.x());
+}
+
+// p 在直线 ab 上的投影参数 t (投影 = a + t(b - a)) 满足 t >= 0
+inline bool projectsOntoRay(const QPointF& a, const QPointF& b, const QPointF& p) {
+    return sumOfProductsSign(p.x(), a.x(), b.x(), a.x(), p.y(), a.y(), b.y(), a.y()) >= 0;
+}
+
+// 投影参数满足 0 <= t <= 1
+inline bool projectsOntoSegment(const QPointF& a, const QPointF& b, const QPointF& p) {
+    return projectsOntoRay(a, b, p) && projectsOntoRay(b, a, p);
+}
+
+// 直线 ab 和 cd 的交点在 ab 上的参数 t (交点 = a + t(b - a)), 直接由四个定义点判定,
+// 不经过算出来的交点; 两直线平行时返回 false
+bool intersectionOnRay(const QPointF& a, const QPointF& b, const QPointF& c, const QPointF& d);      // t >= 0
+bool intersectionOnSegment(const QPointF& a, const QPointF& b, const QPointF& c, const QPointF& d);  // 0 <= t <= 1
+
+// p - center 的方向是否在从 from 逆时针 (数学方向, y 轴向上) 转到 to 的范围内, 包括两端;
+// from 和 to 是圆心指向圆弧起点和终点的向量, 不必是单位向量
+// 和 thetainst(Theta(p - center), s, t) 的含义相同
+bool withinArc(const QPointF& center, const QPointF& from, const QPointF& to, const QPointF& p);
+
+#endif // PREDICATES_H
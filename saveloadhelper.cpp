@@ -6,13 +6,31 @@
 #include "lineoo.h"
 #include "circle.h"
 #include "measurement.h"
+#include <QDebug>
+#include <QIODevice>
+#include <QtEndian>
+#include <unordered_map>
+
+namespace {
+const quint32 ToolSectionTag = 0x544F4F4C; // "TOOL"
+const quint32 LayerSectionTag = 0x4C415952; // "LAYR"
+
+// 接下来是不是以 tag 开头的分段; 只看不读, 这样每个分段都可以缺省
+bool atSection(QDataStream& in, quint32 tag) {
+    if (!in.device() || in.status() != QDataStream::Ok) {
+        return false;
+    }
+    QByteArray bytes = in.device()->peek(sizeof(tag));
+    return bytes.size() == int(sizeof(tag)) && qFromBigEndian<quint32>(bytes.constData()) == tag;
+}
+}
 
 Saveloadhelper::Saveloadhelper() {}
 
 void Saveloadhelper::save(GeometricObject* object, QDataStream& out) {
-    out << object->legal_ << object->hidden_ << object->labelhidden_
-        << object->label_ << object->color_ << object->size_ << object->shape_
-        << object->generation_ << object->name_ << object->index_ << object->aux_;
+    out << object->isLegal() << object->isHidden() << object->islablehidden()
+        << object->getLabel() << object->getColor() << object->getSize() << object->getShape()
+        << object->generation_ << object->name_ << object->index_ << object->isAux();
     if (object->name_ == ObjectName::Point) {
         Point* p = dynamic_cast<Point*>(object);
         out << p->PointArg;
@@ -27,7 +45,7 @@ void Saveloadhelper::save(GeometricObject* object, QDataStream& out) {
     out << indices;
 }
 
-GeometricObject* Saveloadhelper::load(QDataStream& in) {
+GeometricObject* Saveloadhelper::load(ObjectTable& table, QDataStream& in) {
     ObjectName name;
     bool legal, hidden, labelhidden, aux;
     QString label;
@@ -38,56 +56,185 @@ GeometricObject* Saveloadhelper::load(QDataStream& in) {
     GeometricObject* object = nullptr;
     in >> legal >> hidden >> labelhidden >> label >> color >> size
         >> shape >> generation >> name >> index >> aux;
-    switch (name) {
-    case (ObjectType::Point):
+    if (name == ObjectType::Point) {
         in >> position;
-        object = new Point(position);
-        break;
-    case (ObjectType::Line):
-        object = new Line({}, 0);
-        break;
-    case (ObjectType::Lineo):
-        object = new Lineo({}, 0);
-        break;
-    case (ObjectType::Lineoo):
-        object = new Lineoo({}, 0);
-        break;
-    case (ObjectType::Circle):
-        object = new Circle({}, 0);
-        break;
-    case (ObjectType::Arc):
-        object = new Arc({}, 0);
-        break;
-    case (ObjectType::Measurement):
+    } else if (name == ObjectType::Measurement) {
         in >> mID;
-        object = new Measurement({}, 0);
-        dynamic_cast<Measurement*>(object)->id_ = mID;
-    default:
-        break;
     }
-    allObjects.push_back(object);
-    object->selected_ = false;
-    object->hovered_ = false;
-    object->legal_ = legal;
-    object->hidden_ = hidden;
-    object->labelhidden_ = labelhidden;
-    object->label_ = label;
-    object->color_ = color;
-    object->size_ = size;
-    object->shape_ = shape;
-    object->generation_ = generation;
-    object->name_ = name;
-    object->index_ = index;
-    object->aux_ = aux;
+    // 先读父对象: 除自由点外, 对象构造时跟随父对象登记到同一张对象表
     QVector<int> indices = {};
     in >> indices;
+    std::vector<GeometricObject*> parents;
     for (int index : indices) {
         for (auto obj : allObjects) {
             if (obj->index_ == index) {
-                object->addParent(obj);
+                parents.push_back(obj);
             }
         }
     }
-    GeometricObject::counter = std::max(GeometricObject::counter, index + 1);
+    if (name == ObjectType::Point && parents.empty()) {
+        object = new Point(&table, position);
+    } else if (parents.empty()) {
+        qDebug() << "Saveloadhelper: object" << index << "has no parents";
+        return nullptr;
+    } else {
+        switch (name) {
+        case (ObjectType::Point):
+            object = new Point(parents, 0, aux);
+            dynamic_cast<Point*>(object)->PointArg = position; // 约束点的参数
+            break;
+        case (ObjectType::Line):
+            object = new Line(parents, 0, false, aux);
+            break;
+        case (ObjectType::Lineo):
+            object = new Lineo(parents, 0, false, aux);
+            break;
+        case (ObjectType::Lineoo):
+            object = new Lineoo(parents, 0, false, aux);
+            break;
+        case (ObjectType::Circle):
+            object = new Circle(parents, 0, false, aux);
+            break;
+        case (ObjectType::Arc):
+            object = new Arc(parents, 0, false, aux);
+            break;
+        case (ObjectType::Measurement):
+            object = new Measurement(parents, 0, false, aux);
+            dynamic_cast<Measurement*>(object)->id_ = mID;
+            break;
+        default:
+            break;
+        }
+    }
+    if (!object) {
+        qDebug() << "Saveloadhelper: unknown object type" << static_cast<int>(name);
+        return nullptr;
+    }
+    allObjects.push_back(object);
+    object->setSelected(false);
+    object->setHovered(false);
+    object->setLegal(legal);
+    object->setHidden(hidden);
+    object->setlabelhidden(labelhidden);
+    object->setFlag(GeometricObject::Aux, aux);  // 在 setLabel 之前: 辅助对象的标签不登记
+    object->setLabel(label);
+    object->setStyle(color, size, shape);
+    object->generation_ = generation;
+    object->name_ = name;
+    object->index_ = index;
+    table.reserveIndex(index + 1);
     return object->flush();
 }
+
+std::vector<GeometricObject*> Saveloadhelper::loadObjects(ObjectTable& table, QDataStream& in) {
+    int n, m;
+    in >> n >> m;
+    std::vector<GeometricObject*> objects;
+    for (int i = 0; i < n && in.status() == QDataStream::Ok; ++i) {
+        GeometricObject* obj = load(table, in);
+        if (obj) {
+            objects.push_back(obj);
+        }
+    }
+    NumOfMeasurements = m;
+    return objects;
+}
+
+void Saveloadhelper::saveTools(const std::vector<CustomizedOperation*>& tools, QDataStream& out) {
+    if (tools.empty()) {
+        return;
+    }
+    out << ToolSectionTag << qint32(tools.size());
+    for (auto oper : tools) {
+        QVector<qint32> signature;
+        for (ObjectType t : oper->getSignature()) {
+            signature.push_back(static_cast<qint32>(t));
+        }
+        out << QString::fromStdString(oper->getName()) << signature;
+        oper->writePlan(out);
+    }
+}
+
+std::vector<CustomizedOperation*> Saveloadhelper::loadTools(QDataStream& in) {
+    std::vector<CustomizedOperation*> tools;
+    if (!atSection(in, ToolSectionTag)) { // 没有嵌入工具, 或者接下来是别的分段
+        return tools;
+    }
+    quint32 tag;
+    qint32 n;
+    in >> tag >> n;
+    for (int i = 0; i < n && in.status() == QDataStream::Ok; ++i) {
+        QString name;
+        QVector<qint32> signature;
+        in >> name >> signature;
+        std::vector<ObjectType> types;
+        for (qint32 t : signature) {
+            types.push_back(static_cast<ObjectType>(t));
+        }
+        CustomizedOperation* oper = new CustomizedOperation(name, types, nullptr, -1);
+        if (!oper->readPlan(in)) {
+            delete oper;
+            break;
+        }
+        tools.push_back(oper);
+    }
+    return tools;
+}
+
+void Saveloadhelper::saveLayers(const LayerSet& layers, const std::vector<GeometricObject*>& objects,
+                                QDataStream& out) {
+    if (layers.size() == 1 && layers.isVisible(0)) {
+        return;
+    }
+    out << LayerSectionTag << qint32(layers.size());
+    for (int i = 0; i < layers.size(); ++i) {
+        out << layers.name(i) << layers.isVisible(i);
+    }
+    QVector<qint32> indices, ids;
+    for (auto object : objects) {
+        if (object->getLayer() != 0) {
+            indices.push_back(object->index_);
+            ids.push_back(object->getLayer());
+        }
+    }
+    out << qint32(layers.current()) << indices << ids;
+}
+
+void Saveloadhelper::loadLayers(LayerSet& layers, const std::vector<GeometricObject*>& objects, QDataStream& in) {
+    layers.reset();
+    if (!atSection(in, LayerSectionTag)) {
+        if (!in.atEnd()) {
+            qDebug() << "Saveloadhelper: unknown section after objects";
+        }
+        return;
+    }
+    quint32 tag;
+    qint32 n, current;
+    in >> tag >> n;
+    for (int i = 0; i < n && in.status() == QDataStream::Ok; ++i) {
+        QString name;
+        bool visible;
+        in >> name >> visible;
+        int layer = i == 0 ? 0 : layers.add(name);
+        if (layer < 0) {
+            continue;
+        }
+        layers.setName(layer, name);
+        layers.setVisible(layer, visible);
+    }
+    QVector<qint32> indices, ids;
+    in >> current >> indices >> ids;
+    std::unordered_map<int, GeometricObject*> byIndex;
+    for (auto object : objects) {
+        byIndex[object->index_] = object;
+    }
+    for (int i = 0; i < indices.size() && i < ids.size(); ++i) {
+        auto it = byIndex.find(indices[i]);
+        if (it != byIndex.end() && ids[i] >= 0 && ids[i] < layers.size()) {
+            it->second->setLayer(ids[i]);
+        }
+    }
+    if (current >= 0 && current < layers.size()) {
+        layers.setCurrent(current);
+    }
+}
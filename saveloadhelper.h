@@ -2,13 +2,23 @@
 #define SAVELOADHELPER_H
 
 #include "geometricobject.h"
+#include "customizedoperation.h"
 
 class Saveloadhelper
 {
 public:
     Saveloadhelper();
     void save(GeometricObject* object, QDataStream& out);
-    GeometricObject* load(QDataStream& in);
+    // 读入的对象登记到 table
+    GeometricObject* load(ObjectTable& table, QDataStream& in);
+    // 读入文件开头的全部对象 (按 index 顺序), 同时恢复 NumOfMeasurements
+    std::vector<GeometricObject*> loadObjects(ObjectTable& table, QDataStream& in);
+    // 对象之后的可选分段, 以标签开头; 旧文件到这里已经结束
+    void saveTools(const std::vector<CustomizedOperation*>& tools, QDataStream& out);
+    std::vector<CustomizedOperation*> loadTools(QDataStream& in);
+    // 图层: 名字, 是否显示, 当前图层, 以及不在第一个图层里的对象 (按 index); 只有默认图层时不写
+    void saveLayers(const LayerSet& layers, const std::vector<GeometricObject*>& objects, QDataStream& out);
+    void loadLayers(LayerSet& layers, const std::vector<GeometricObject*>& objects, QDataStream& in);
 
 private:
     std::vector<GeometricObject*> allObjects = {};
@@ -0,0 +1,14 @@
+#ifndef SCALAR_H
+#define SCALAR_H
+
+// 几何计算使用的浮点类型
+// 默认是 double: 和 QPointF 的 qreal 一致, 在 x86-64 上走 SSE, 不用在 x87 和 double 之间来回转换
+// 用 cmake -DGEOTHU_LONG_DOUBLE=ON 构建时是 long double, 作为校验用的高精度参考
+// calculator.h 中的计算核心都是以标量类型为参数的模板, 默认参数就是 Real; 见 PrecisionBenchmark
+#ifdef GEOTHU_LONG_DOUBLE
+typedef long double Real;
+#else
+typedef double Real;
+#endif
+
+#endif // SCALAR_H
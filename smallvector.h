@@ -0,0 +1,109 @@
+#ifndef SMALLVECTOR_H
+#define SMALLVECTOR_H
+
+#include <QtGlobal>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+
+// 前 N 个元素直接存在对象内部的 vector, 超过时才在堆上分配
+// 几何对象的父对象, 子对象和定义点通常只有两三个, 这样大多数对象没有额外的堆分配, 数据也和对象挨在一起
+// 只用于指针, QPointF 这类可以按字节复制的类型, 接口是 std::vector 的一个子集
+template <typename T, unsigned N>
+class SmallVector {
+    static_assert(std::is_trivially_copyable<T>::value, "SmallVector only holds trivially copyable types");
+
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    SmallVector() = default;
+    SmallVector(std::initializer_list<T> list) { assign(list.begin(), list.end()); }
+    template <typename It>
+    SmallVector(It first, It last) { assign(first, last); }
+    SmallVector(const SmallVector& other) { assign(other.begin(), other.end()); }
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            assign(other.begin(), other.end());
+        }
+        return *this;
+    }
+    ~SmallVector() {
+        if (data_ != inlineData()) {
+            std::free(data_);
+        }
+    }
+
+    template <typename It>
+    void assign(It first, It last) {
+        size_ = 0;
+        for (; first != last; ++first) {
+            push_back(*first);
+        }
+    }
+
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+    iterator begin() { return data_; }
+    iterator end() { return data_ + size_; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return size_ == 0; }
+    T& operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+    T& front() { return data_[0]; }
+    T& back() { return data_[size_ - 1]; }
+    const T& front() const { return data_[0]; }
+    const T& back() const { return data_[size_ - 1]; }
+
+    void push_back(const T& value) {
+        if (size_ == capacity_) {
+            T copy = value; // value 可能就在要被释放的旧缓冲区里
+            grow(capacity_ * 2);
+            data_[size_++] = copy;
+            return;
+        }
+        data_[size_++] = value;
+    }
+    iterator erase(const_iterator pos) {
+        T* p = data_ + (pos - data_);
+        std::memmove(p, p + 1, (end() - p - 1) * sizeof(T));
+        --size_;
+        return p;
+    }
+    void clear() { size_ = 0; }
+
+    bool operator==(const SmallVector& other) const {
+        return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+    }
+    bool operator!=(const SmallVector& other) const { return !(*this == other); }
+
+private:
+    T* inlineData() { return reinterpret_cast<T*>(inline_); }
+
+    void grow(quint32 capacity) {
+        T* data = static_cast<T*>(std::malloc(capacity * sizeof(T)));
+        if (!data) {
+            throw std::bad_alloc();
+        }
+        std::memcpy(data, data_, size_ * sizeof(T));
+        if (data_ != inlineData()) {
+            std::free(data_);
+        }
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    alignas(T) unsigned char inline_[N * sizeof(T)];
+    T* data_ = inlineData();
+    quint32 size_ = 0;
+    quint32 capacity_ = N;
+};
+
+#endif // SMALLVECTOR_H
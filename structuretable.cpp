@@ -0,0 +1,102 @@
+#include "structuretable.h"
+#include <algorithm>
+#include <functional>
+
+size_t StructureTable::KeyHash::operator()(const Key& key) const {
+    size_t h = std::hash<int>()(int(key.type)) * 31 + std::hash<int>()(key.generation);
+    for (GeometricObject* parent : key.parents) {
+        h = h * 1000003 ^ std::hash<GeometricObject*>()(parent);
+    }
+    h = h * 1000003 ^ std::hash<double>()(key.x);
+    h = h * 1000003 ^ std::hash<double>()(key.y);
+    return h;
+}
+
+bool StructureTable::keyOf(const GeometricObject* obj, Key& key) {
+    if (obj->getParents().empty() || obj->getObjectType() == ObjectType::Measurement) {
+        return false;
+    }
+    QPointF arg = obj->constraint();
+    key = {obj->getObjectType(), obj->getGeneration(), obj->getParents(), arg.x(), arg.y()};
+    return true;
+}
+
+void StructureTable::insert(GeometricObject* obj) {
+    Key key;
+    if (!keyOf(obj, key)) {
+        return;
+    }
+    auto it = table_.find(key);
+    if (it == table_.end()) {
+        it = table_.emplace(std::move(key), obj).first;
+    } else if (it->second->isAux() && !obj->isAux()) {
+        keys_.erase(it->second);
+        it->second = obj;
+    } else {
+        return;
+    }
+    keys_[obj] = &it->first;
+}
+
+void StructureTable::remove(const GeometricObject* obj) {
+    auto it = keys_.find(obj);
+    if (it == keys_.end()) {
+        return;
+    }
+    table_.erase(*it->second);
+    keys_.erase(it);
+}
+
+GeometricObject* StructureTable::find(const Key& key) const {
+    auto it = table_.find(key);
+    if (it == table_.end()) {
+        return nullptr;
+    }
+    Key current;
+    return keyOf(it->second, current) && current == key ? it->second : nullptr;
+}
+
+GeometricObject* StructureTable::find(const GeometricObject* obj) const {
+    Key key;
+    return keyOf(obj, key) ? find(key) : nullptr;
+}
+
+std::vector<GeometricObject*> StructureTable::intern(std::vector<GeometricObject*> created) {
+    std::sort(created.begin(), created.end(), [](GeometricObject* a, GeometricObject* b) {
+        return a->getIndex() < b->getIndex();
+    });
+    StructureTable batch;
+    std::vector<GeometricObject*> kept;
+    kept.reserve(created.size());
+    for (GeometricObject* obj : created) {
+        // 父对象已经处理过, 如果它被合并了, obj 的父对象此时已经换成了留下的对象
+        Key key;
+        GeometricObject* existing = nullptr;
+        if (keyOf(obj, key)) {
+            existing = batch.find(key);
+            if (existing && existing->isAux() != obj->isAux()) {
+                existing = nullptr;
+            }
+            if (!existing && obj->isAux()) {
+                existing = find(key);
+                if (existing && !existing->isAux()) {
+                    existing = nullptr;
+                }
+            }
+        }
+        if (existing) {
+            ObjectList children = obj->getChildren();
+            for (GeometricObject* child : children) {
+                child->replaceParent(obj, existing);
+            }
+            delete obj;
+            continue;
+        }
+        batch.insert(obj);
+        kept.push_back(obj);
+    }
+    for (GeometricObject* obj : kept) {
+        insert(obj);
+    }
+    return kept;
+}
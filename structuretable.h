@@ -0,0 +1,50 @@
+#ifndef STRUCTURETABLE_H
+#define STRUCTURETABLE_H
+
+#include "geometricobject.h"
+#include <unordered_map>
+#include <vector>
+
+// 按结构查找对象: 类型, generation, 父对象 (按顺序) 和约束参数都相同的两个对象, 计算结果必然相同
+// 自由点 (没有父对象) 和度量不参与: 同一位置的两个自由点是用户有意放的, 度量只是显示
+// Canvas 为当前文档 (画布上的对象和辅助对象) 保存一张表, 在增加, 删除, 撤销和重做时更新
+class StructureTable {
+public:
+    void clear() { table_.clear(); keys_.clear(); }
+    // 已有结构相同的对象时保留原来的, 除非原来的是辅助对象而 obj 不是
+    void insert(GeometricObject* obj);
+    // obj 离开文档时调用; 按插入时的键删除, 约束参数之后变了也能找到
+    void remove(const GeometricObject* obj);
+    // 和 obj 结构相同的对象; 表中对象的约束参数在插入后变了 (拖动约束点) 时不算相同
+    GeometricObject* find(const GeometricObject* obj) const;
+
+    // 依次 (按 index, 父对象在子对象之前) 处理刚构造出来的对象, 结构相同的把子对象改接到留下的对象上, 然后删除:
+    // 辅助对象只合并进辅助对象 (表中的或同一批里更早的): 合并进用户能看到的对象的话, 用户删除那个对象时
+    // 会连带删掉依赖它的工具输出; 可见对象只和同一批里更早的可见对象合并, 不会合并进用户已有的对象
+    // 可见对象不会合并进辅助对象, 因为已有对象可能在撤销缓存里, 不能改变它的辅助属性
+    // 返回没有被删除的对象并把它们加入表中, 按 index 排序
+    std::vector<GeometricObject*> intern(std::vector<GeometricObject*> created);
+
+private:
+    struct Key {
+        ObjectType type;
+        int generation;
+        ObjectList parents;
+        double x, y;
+        bool operator==(const Key& other) const {
+            return type == other.type && generation == other.generation && x == other.x && y == other.y &&
+                   parents == other.parents;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    static bool keyOf(const GeometricObject* obj, Key& key);
+    GeometricObject* find(const Key& key) const;
+
+    std::unordered_map<Key, GeometricObject*, KeyHash> table_;
+    // 表中对象插入时的键; unordered_map 重新散列时元素的地址不变
+    std::unordered_map<const GeometricObject*, const Key*> keys_;
+};
+
+#endif // STRUCTURETABLE_H
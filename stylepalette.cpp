@@ -0,0 +1,48 @@
+#include "stylepalette.h"
+#include "geometricobject.h"
+#include <QDebug>
+#include <cmath>
+
+unsigned StylePalette::defaultsRevision = 1;
+
+StylePalette::StylePalette() {
+    intern(QColor(), 0, 0);
+}
+
+quint16 StylePalette::intern(const QColor& color, double size, int shape) {
+    Key key = {color.rgba(), size, shape};
+    auto it = index_.constFind(key);
+    if (it != index_.constEnd()) {
+        return it.value();
+    }
+    if (styles_.size() > 0xFFFF) {
+        qWarning() << "Style palette is full";
+        quint16 best = 0;
+        double bestDistance = INFINITY;
+        for (size_t i = 0; i < styles_.size(); ++i) {
+            const Style& s = styles_[i];
+            double d = std::abs(s.size - size) + (s.shape != shape) +
+                       (s.color.rgba() != color.rgba());
+            if (d < bestDistance) {
+                bestDistance = d;
+                best = quint16(i);
+            }
+        }
+        return best;
+    }
+    quint16 index = quint16(styles_.size());
+    styles_.push_back({color, size, shape});
+    index_.insert(key, index);
+    return index;
+}
+
+quint16 StylePalette::defaultStyle(ObjectType type) {
+    size_t i = static_cast<size_t>(type);
+    if (i >= defaults_.size()) {
+        defaults_.resize(i + 1, {0u, quint16(0)});
+    }
+    if (defaults_[i].first != defaultsRevision) {
+        defaults_[i] = {defaultsRevision, intern(GetDefaultColor[type], GetDefaultSize[type], GetDefaultShape[type])};
+    }
+    return defaults_[i].second;
+}
@@ -0,0 +1,50 @@
+#ifndef STYLEPALETTE_H
+#define STYLEPALETTE_H
+
+#include <QColor>
+#include <QHash>
+#include <deque>
+#include <vector>
+#include "objecttype.h"
+
+// 一个文档里不同的样式 (颜色, 线宽/点的大小, 线型) 只有几十种, 对象只存 16 位的编号
+struct Style {
+    QColor color;
+    double size;
+    int shape;
+};
+
+class StylePalette {
+public:
+    StylePalette();
+    // 相同的样式返回同一个编号; 超过 65536 种时返回最接近的已有样式 (实际不会发生)
+    quint16 intern(const QColor& color, double size, int shape);
+    // 返回的引用在之后 intern 新样式时仍然有效
+    const Style& operator[](quint16 index) const { return styles_[index]; }
+    size_t size() const { return styles_.size(); }
+
+    // 该类型新对象的样式, 即 GetDefaultColor/Size/Shape 中的值; 默认值改变前不再查找这几张表
+    quint16 defaultStyle(ObjectType type);
+    // GetDefaultColor/Size/Shape 被修改后调用, 所有文档的缓存都会失效
+    static void defaultsChanged() { ++defaultsRevision; }
+
+private:
+    struct Key {
+        QRgb rgba;
+        double size;
+        int shape;
+        bool operator==(const Key& other) const {
+            return rgba == other.rgba && size == other.size && shape == other.shape;
+        }
+    };
+    friend size_t qHash(const Key& key, size_t seed) {
+        return qHashMulti(seed, key.rgba, key.size, key.shape);
+    }
+
+    std::deque<Style> styles_;      // deque 追加时不移动已有元素, 对象拿到的 const Style& 不会悬空
+    QHash<Key, quint16> index_;
+    std::vector<std::pair<unsigned, quint16>> defaults_;    // 按 ObjectType 下标: (缓存时的 revision, 编号)
+    static unsigned defaultsRevision;
+};
+
+#endif // STYLEPALETTE_H
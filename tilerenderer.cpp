@@ -0,0 +1,51 @@
+#include "tilerenderer.h"
+#include <QImage>
+
+TileRenderer::TileRenderer(int tileSize) : tileSize_(tileSize) {}
+
+void TileRenderer::render(QPainter* painter, const std::vector<Item>& items, const QRect& viewport,
+                          const QRect& dirty) {
+    const QRect area = dirty.isNull() ? viewport : dirty & viewport;
+    if (area.isEmpty()) {
+        return;
+    }
+    // 块按 viewport 原点对齐, 局部重绘时只取和 area 相交的部分
+    std::vector<QRect> tiles;
+    int left = viewport.left() + (area.left() - viewport.left()) / tileSize_ * tileSize_;
+    int top = viewport.top() + (area.top() - viewport.top()) / tileSize_ * tileSize_;
+    for (int y = top; y <= area.bottom(); y += tileSize_) {
+        for (int x = left; x <= area.right(); x += tileSize_) {
+            QRect tile = QRect(x, y, tileSize_, tileSize_) & area;
+            if (!tile.isEmpty()) {
+                tiles.push_back(tile);
+            }
+        }
+    }
+
+    const qreal ratio = painter->device()->devicePixelRatioF();
+    std::vector<QImage> images(tiles.size());
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        pool_.start([&, i]() {
+            const QRect& tile = tiles[i];
+            QImage image(tile.size() * ratio, QImage::Format_ARGB32_Premultiplied);
+            image.setDevicePixelRatio(ratio);
+            image.fill(Qt::transparent);
+            QPainter tilePainter(&image);
+            tilePainter.setRenderHint(QPainter::Antialiasing, !renderOptions.draft);
+            tilePainter.translate(-tile.topLeft());
+            tilePainter.setClipRect(tile); // 直线和射线按裁剪区域截断, 见 paintableRect
+            for (const Item& item : items) {
+                if (item.bounds.intersects(tile)) {
+                    item.object->draw(&tilePainter);
+                }
+            }
+            tilePainter.end();
+            images[i] = std::move(image);
+        });
+    }
+    pool_.waitForDone();
+
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        painter->drawImage(tiles[i].topLeft(), images[i]);
+    }
+}
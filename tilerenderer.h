@@ -0,0 +1,29 @@
+#ifndef TILERENDERER_H
+#define TILERENDERER_H
+
+#include <QPainter>
+#include <QRect>
+#include <QThreadPool>
+#include <vector>
+#include "geometricobject.h"
+
+// 把要重画的区域分成固定大小的块, 每块在线程池里用自己的 QPainter 画到一张 QImage 上, 再贴回目标 painter
+// 调用前对象必须已经计算好 (flush 会修改对象, 不能并发); 各线程只调用 const 的 draw()
+class TileRenderer {
+public:
+    struct Item {
+        const GeometricObject* object;
+        QRectF bounds;      // boundingRect(viewport), 用于剔除和块不相交的对象
+    };
+
+    explicit TileRenderer(int tileSize = 256);
+
+    // items 按绘制顺序排列; dirty 为空时重画整个 viewport
+    void render(QPainter* painter, const std::vector<Item>& items, const QRect& viewport, const QRect& dirty);
+
+private:
+    int tileSize_;
+    QThreadPool pool_;
+};
+
+#endif // TILERENDERER_H
@@ -0,0 +1,167 @@
+#include "toollibrary.h"
+#include "customizedoperation.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+const quint32 LibraryMagic = 0x54484C42; // "THLB"
+const quint16 LibraryVersion = 1;
+const qint64 HeaderSize = 6;             // quint32 + quint16
+const qint64 TrailerSize = 12;           // qint64 + quint32
+}
+
+ToolLibrary::ToolLibrary(const QString& path) : path_(path) {}
+
+QString ToolLibrary::defaultPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/tools.thl";
+}
+
+bool ToolLibrary::open() {
+    entries_.clear();
+    indexOffset_ = HeaderSize;
+    opened_ = true;
+    broken_ = true;
+    QFile file(path_);
+    if (!file.exists() || file.size() == 0) {
+        broken_ = false;
+        return true;
+    }
+    if (!file.open(QIODevice::ReadOnly) || file.size() < HeaderSize + TrailerSize) {
+        qDebug() << "ToolLibrary: cannot read" << path_;
+        return false;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic;
+    quint16 version;
+    in >> magic >> version;
+    if (magic != LibraryMagic || version != LibraryVersion) {
+        qDebug() << "ToolLibrary: unknown format" << path_;
+        return false;
+    }
+    file.seek(file.size() - TrailerSize);
+    qint64 indexOffset;
+    in >> indexOffset >> magic;
+    if (magic != LibraryMagic || indexOffset < HeaderSize || indexOffset > file.size() - TrailerSize) {
+        qDebug() << "ToolLibrary: broken trailer" << path_;
+        return false;
+    }
+    file.seek(indexOffset);
+    qint32 n;
+    in >> n;
+    for (int i = 0; i < n && in.status() == QDataStream::Ok; ++i) {
+        Entry e;
+        QVector<qint32> signature;
+        in >> e.name >> e.icon >> signature >> e.offset;
+        for (qint32 t : signature) {
+            e.signature.push_back(static_cast<ObjectType>(t));
+        }
+        entries_.push_back(e);
+    }
+    if (in.status() != QDataStream::Ok) {
+        entries_.clear();
+        return false;
+    }
+    indexOffset_ = indexOffset;
+    broken_ = false;
+    return true;
+}
+
+bool ToolLibrary::contains(const QString& name) const {
+    for (const Entry& e : entries_) {
+        if (e.name == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+CustomizedOperation* ToolLibrary::createLazy(int i) const {
+    return new CustomizedOperation(entries_[i].name, entries_[i].signature, this, i);
+}
+
+bool ToolLibrary::loadPlan(int i, CustomizedOperation* oper) const {
+    QFile file(path_);
+    if (i < 0 || i >= size() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    file.seek(entries_[i].offset);
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    return oper->readPlan(in);
+}
+
+bool ToolLibrary::append(const CustomizedOperation* oper, const QString& icon) {
+    QDir().mkpath(QFileInfo(path_).absolutePath());
+    if (!opened_) {
+        open();
+    }
+    if (broken_) {
+        // 读不出来的库可能是更新版本写的或只坏了一部分, 截断会丢掉其中所有工具
+        qDebug() << "ToolLibrary: refusing to overwrite unreadable" << path_;
+        return false;
+    }
+    // 新文件写在临时文件里, 全部写完才替换旧文件: 中途崩溃或磁盘满时旧的库原样保留
+    // 旧的执行计划原样复制过去, 偏移不变; 新的执行计划放在旧索引的位置, 之后是新的索引和 trailer
+    QFile old(path_);
+    bool fresh = !old.exists() || old.size() == 0;
+    if (!fresh && !old.open(QIODevice::ReadOnly)) {
+        qDebug() << "ToolLibrary: cannot read" << path_;
+        return false;
+    }
+    QSaveFile file(path_);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "ToolLibrary: cannot write" << path_;
+        return false;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    qint64 planOffset = HeaderSize;
+    if (fresh) {
+        out << LibraryMagic << LibraryVersion;
+    } else {
+        planOffset = indexOffset_;
+        for (qint64 copied = 0; copied < planOffset;) {
+            QByteArray chunk = old.read(std::min<qint64>(planOffset - copied, 1 << 20));
+            if (chunk.isEmpty() || file.write(chunk) != chunk.size()) {
+                file.cancelWriting();
+                qDebug() << "ToolLibrary: cannot copy" << path_;
+                return false;
+            }
+            copied += chunk.size();
+        }
+        old.close();
+    }
+    std::vector<Entry> entries = entries_;
+    Entry e;
+    e.name = QString::fromStdString(oper->getName());
+    e.icon = icon;
+    e.signature = oper->getSignature();
+    e.offset = planOffset;
+    oper->writePlan(out);
+    entries.push_back(e);
+
+    qint64 indexOffset = file.pos();
+    out << qint32(entries.size());
+    for (const Entry& entry : entries) {
+        QVector<qint32> signature;
+        for (ObjectType t : entry.signature) {
+            signature.push_back(static_cast<qint32>(t));
+        }
+        out << entry.name << entry.icon << signature << entry.offset;
+    }
+    out << indexOffset << LibraryMagic;
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        qDebug() << "ToolLibrary: cannot write" << path_;
+        return false;
+    }
+    entries_ = std::move(entries);
+    indexOffset_ = indexOffset;
+    return true;
+}
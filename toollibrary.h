@@ -0,0 +1,51 @@
+#ifndef TOOLLIBRARY_H
+#define TOOLLIBRARY_H
+
+#include <QString>
+#include <vector>
+#include "objecttype.h"
+
+class CustomizedOperation;
+
+struct RegisteredTool {
+    QString name;
+    int index;      // 在 Canvas::operations 中的下标
+    QString icon;
+};
+
+// 自定义工具库文件:
+// [header: magic, version] [plan 0] [plan 1] ... [index] [trailer: indexOffset, magic]
+// 启动时只读取 trailer 和索引 (名字, 图标, 输入类型), 执行计划在第一次使用时才反序列化
+class ToolLibrary {
+public:
+    explicit ToolLibrary(const QString& path = defaultPath());
+    static QString defaultPath();
+
+    // 文件存在但读不出来 (损坏, 版本更新) 时返回 false, 之后 append 不会覆盖它
+    bool open();
+    int size() const { return int(entries_.size()); }
+    QString name(int i) const { return entries_[i].name; }
+    QString icon(int i) const { return entries_[i].icon; }
+    bool contains(const QString& name) const;
+
+    // 返回一个尚未加载执行计划的工具, 计划由 loadPlan 按需读入
+    CustomizedOperation* createLazy(int i) const;
+    bool loadPlan(int i, CustomizedOperation* oper) const;
+    // 追加一个工具并重写索引, 整个文件写完才替换旧文件; 库文件读不出来时拒绝写入并返回 false
+    bool append(const CustomizedOperation* oper, const QString& icon = ":/raw_icons/new_tool.png");
+
+private:
+    struct Entry {
+        QString name;
+        QString icon;
+        std::vector<ObjectType> signature;
+        qint64 offset;
+    };
+    QString path_;
+    std::vector<Entry> entries_;
+    qint64 indexOffset_ = 0;
+    bool opened_ = false;
+    bool broken_ = false;
+};
+
+#endif // TOOLLIBRARY_H
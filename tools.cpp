@@ -108,8 +108,8 @@ std::set<GeometricObject*> TangentLineCreator::apply(std::vector<GeometricObject
     if(objs[1]->getObjectType()==ObjectType::Circle){
         Circle* circle = dynamic_cast<Circle*>(objs[1]);
         QPointF p1 = objs[0]->position(), p2 = circle->position();
-        long double radius = circle->getRadius();
-        long double dist = std::sqrt(std::pow(p1.x() - p2.x(), 2) + std::pow(p1.y() - p2.y(), 2));
+        Real radius = circle->getRadius();
+        Real dist = std::sqrt(std::pow(p1.x() - p2.x(), 2) + std::pow(p1.y() - p2.y(), 2));
         if (radius > dist + 1e-6) {
             return std::set<GeometricObject*>();
         } else if (abs(radius - dist) <= 1e-6) {
@@ -121,8 +121,8 @@ std::set<GeometricObject*> TangentLineCreator::apply(std::vector<GeometricObject
     else{
         Arc* arc = dynamic_cast<Arc*>(objs[1]);
         QPointF p1 = objs[0]->position(), p2 = arc->position();
-        long double radius = arc->getRadius();
-        long double dist = std::sqrt(std::pow(p1.x() - p2.x(), 2) + std::pow(p1.y() - p2.y(), 2));
+        Real radius = arc->getRadius();
+        Real dist = std::sqrt(std::pow(p1.x() - p2.x(), 2) + std::pow(p1.y() - p2.y(), 2));
         if (radius > dist + 1e-6) {
             return std::set<GeometricObject*>();
         } else if (abs(radius - dist) <= 1e-6) {
@@ -186,7 +186,7 @@ std::set<GeometricObject*> AxialSymmetry::apply(std::vector<GeometricObject*> ob
         break;
     }
     default:{
-        QMessageBox::warning(nullptr, "警告", "尝试对Any/None对象进行几何变换!");
+        objs[0]->getTable()->reportError("尝试对Any/None对象进行几何变换!");
         return std::set<GeometricObject*>();
     }
     }
@@ -232,7 +232,7 @@ std::set<GeometricObject*> CentralSymmetry::apply(std::vector<GeometricObject*>
         break;
     }
     default:{
-        QMessageBox::warning(nullptr, "警告", "尝试对Any/None对象进行几何变换!");
+        objs[0]->getTable()->reportError("尝试对Any/None对象进行几何变换!");
         return std::set<GeometricObject*>();
     }
     }